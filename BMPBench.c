@@ -0,0 +1,500 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// BMPBench.c
+//
+// Benchmark of the processing stages on synthetic BMP files, built as
+// bmpbench with make.
+//
+// Results are written as JSON, one result per line in a fixed order, so two
+// runs can be compared with a plain diff.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "BMPHandler.h"
+#include "Image.h"
+#include "FilterChain.h"
+#include "PixelKernels.h"
+#include "ThreadPool.h"
+#include "Resample.h"
+
+// Default number of timed and warm-up repetitions of every stage
+#define BENCH_REPETITIONS 5
+#define BENCH_WARMUP 1
+
+// Maximum number of image sizes in one run
+#define BENCH_MAX_SIZES 32
+
+// Stages that enlarge the image are skipped above this many source pixels
+#define BENCH_MAX_UPSCALE_PIXELS (64 * 1024 * 1024)
+
+// Default sizes; odd widths exercise the row padding
+static const int default_sizes[][2] = {
+    {64, 64}, {257, 255}, {1021, 767}, {1920, 1080}, {4095, 3071}
+};
+
+// Sizes added by -L
+static const int large_sizes[][2] = {
+    {8191, 8191}, {16384, 16384}
+};
+
+// State shared by the stages of one image size
+struct BenchContext {
+    int width;
+    int height;
+    char input_path[4096];   // Synthetic BMP file
+    char output_path[4096];  // Output file of the write stages
+    Image* master;           // Pixels of the synthetic file
+    Image* work;             // Image the stages run on, in the layout being measured
+};
+
+// A benchmarked stage: setup is not timed, run is
+struct BenchStage {
+    const char* name;
+    void (*setup)(struct BenchContext* ctx);
+    int (*run)(struct BenchContext* ctx);
+    int upscales;            // 1 if the stage enlarges the image
+    int packed_only;         // 1 if the stage only handles packed BGR images
+};
+
+// Function to get the current time in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to fill an image with a deterministic pattern: gradients plus
+// xorshift noise seeded by the row, so every size gives the same pixels
+// on every run
+static void fill_synthetic(Image* img) {
+    for(int i = 0; i < img->height; i++){
+        struct Pixel* row = image_get_row(img, i);
+        unsigned int state = 2654435761u * (unsigned int)(i + 1) ^ (unsigned int)img->width;
+        for(int j = 0; j < img->width; j++){
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[j].blue = (unsigned char)((j * 255 / img->width + (state & 31)) & 0xFF);
+            row[j].green = (unsigned char)((i * 255 / img->height + ((state >> 8) & 31)) & 0xFF);
+            row[j].red = (unsigned char)(((i + j) + ((state >> 16) & 63)) & 0xFF);
+        }
+    }
+}
+
+// Function to copy the master pixels into the work image, converting them
+// to its layout
+static void reset_work(struct BenchContext* ctx) {
+    if(!image_reshape(ctx->work, ctx->width, ctx->height)){
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < ctx->height; i++){
+        image_load_row(ctx->work, i, (const unsigned char*)image_get_row(ctx->master, i), 24);
+    }
+}
+
+// Setup that only gives the work image the source size
+static void setup_shape(struct BenchContext* ctx) {
+    if(!image_reshape(ctx->work, ctx->width, ctx->height)){
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Stage: read with the FILE based readPixelsBMP
+static int run_read_fread(struct BenchContext* ctx) {
+    FILE* file = fopen(ctx->input_path, "rb");
+    if(file == NULL) return 0;
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+    readBMPHeader(file, &bmp_header);
+    readDIBHeader(file, &dib_header);
+    readPixelsBMP(file, image_get_pixels(ctx->work), ctx->width, ctx->height, bmp_header.bfOffBits);
+    fclose(file);
+    return 1;
+}
+
+// Stage: read through a mapped source
+static int run_read_mmap(struct BenchContext* ctx) {
+    struct BMP_Source source;
+    if(!openBMPSource(ctx->input_path, &source)) return 0;
+    copyPixelsBMP(&source, ctx->work);
+    closeBMPSource(&source);
+    return 1;
+}
+
+// Stage: grayscale
+static int run_grayscale(struct BenchContext* ctx) {
+    image_apply_bw(ctx->work);
+    return 1;
+}
+
+// Stage: color shift
+static int run_colorshift(struct BenchContext* ctx) {
+    image_apply_colorshift(ctx->work, 40, -20, 10);
+    return 1;
+}
+
+// Stage: nearest neighbor resize to half size
+static int run_resize_half(struct BenchContext* ctx) {
+    return image_apply_resize(ctx->work, 0.5f);
+}
+
+// Stage: nearest neighbor resize to double size
+static int run_resize_double(struct BenchContext* ctx) {
+    return image_apply_resize(ctx->work, 2.0f);
+}
+
+// Stage: bilinear resample to half size
+static int run_bilinear_half(struct BenchContext* ctx) {
+    return resample_image(ctx->work, ctx->width / 2 > 0 ? ctx->width / 2 : 1,
+                          ctx->height / 2 > 0 ? ctx->height / 2 : 1, RESAMPLE_BILINEAR, NULL, NULL);
+}
+
+// Stage: Lanczos resample to half size
+static int run_lanczos_half(struct BenchContext* ctx) {
+    return resample_image(ctx->work, ctx->width / 2 > 0 ? ctx->width / 2 : 1,
+                          ctx->height / 2 > 0 ? ctx->height / 2 : 1, RESAMPLE_LANCZOS, NULL, NULL);
+}
+
+// Stage: Gaussian blur with a sigma of 2 pixels
+static int run_gaussian_blur(struct BenchContext* ctx) {
+    struct ConvolveKernel kernel;
+    return convolve_kernel_gaussian(&kernel, 2.0, CONVOLVE_BORDER_CLAMP) && convolve_image(ctx->work, &kernel, NULL);
+}
+
+// Stage: box blur over 17 x 17 pixels
+static int run_box_blur(struct BenchContext* ctx) {
+    struct ConvolveKernel kernel;
+    return convolve_kernel_box(&kernel, 8, CONVOLVE_BORDER_CLAMP) && convolve_image(ctx->work, &kernel, NULL);
+}
+
+// Stage: unsharp mask
+static int run_sharpen(struct BenchContext* ctx) {
+    struct ConvolveKernel kernel;
+    return convolve_kernel_sharpen(&kernel, 1.0, CONVOLVE_BORDER_CLAMP) && convolve_image(ctx->work, &kernel, NULL);
+}
+
+// Stage: per-channel and luma histograms
+static int run_histogram(struct BenchContext* ctx) {
+    struct Histogram hist;
+    return histogram_compute(ctx->work, &hist);
+}
+
+// Stage: rotate a quarter turn clockwise
+static int run_rotate90(struct BenchContext* ctx) {
+    return image_apply_rotate(ctx->work, 90);
+}
+
+// Stage: rotate half a turn in place
+static int run_rotate180(struct BenchContext* ctx) {
+    return image_apply_rotate(ctx->work, 180);
+}
+
+// Stage: mirror the columns in place
+static int run_flip_horizontal(struct BenchContext* ctx) {
+    return image_apply_flip(ctx->work, 1);
+}
+
+// Stage: grayscale, color shift and half size resize as one fused chain
+static int run_chain(struct BenchContext* ctx) {
+    FilterChain chain;
+    filter_chain_init(&chain);
+    filter_chain_add_grayscale(&chain);
+    filter_chain_add_colorshift(&chain, 40, -20, 10);
+    filter_chain_add_resize(&chain, 0.5f);
+    return filter_chain_apply(&chain, ctx->work);
+}
+
+// Stage: write with the FILE based writePixelsBMP
+static int run_write_fwrite(struct BenchContext* ctx) {
+    FILE* file = fopen(ctx->output_path, "wb");
+    if(file == NULL) return 0;
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+    makeBMPHeader(&bmp_header, ctx->width, ctx->height);
+    makeDIBHeader(&dib_header, ctx->width, ctx->height);
+    writeBMPHeader(file, &bmp_header);
+    writeDIBHeader(file, &dib_header);
+    writePixelsBMP(file, image_get_pixels(ctx->work), ctx->width, ctx->height);
+    return fclose(file) == 0;
+}
+
+// Stage: write with writeImageBMP
+static int run_write_writev(struct BenchContext* ctx) {
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+    makeBMPHeader(&bmp_header, ctx->width, ctx->height);
+    makeDIBHeader(&dib_header, ctx->width, ctx->height);
+    return writeImageBMP(ctx->output_path, &bmp_header, &dib_header, ctx->work, BMP_WRITE_DEFAULT);
+}
+
+// All stages, in the order they are run and reported
+static const struct BenchStage stages[] = {
+    {"read_fread", setup_shape, run_read_fread, 0, 1},
+    {"read_mmap", setup_shape, run_read_mmap, 0, 0},
+    {"grayscale", reset_work, run_grayscale, 0, 0},
+    {"colorshift", reset_work, run_colorshift, 0, 0},
+    {"resize_half", reset_work, run_resize_half, 0, 0},
+    {"resize_double", reset_work, run_resize_double, 1, 0},
+    {"bilinear_half", reset_work, run_bilinear_half, 0, 0},
+    {"lanczos_half", reset_work, run_lanczos_half, 0, 0},
+    {"gaussian_blur", reset_work, run_gaussian_blur, 0, 0},
+    {"box_blur", reset_work, run_box_blur, 0, 0},
+    {"sharpen", reset_work, run_sharpen, 0, 0},
+    {"histogram", reset_work, run_histogram, 0, 0},
+    {"rotate90", reset_work, run_rotate90, 0, 0},
+    {"rotate180", reset_work, run_rotate180, 0, 0},
+    {"flip_horizontal", reset_work, run_flip_horizontal, 0, 0},
+    {"chain_fused", reset_work, run_chain, 0, 0},
+    {"write_fwrite", reset_work, run_write_fwrite, 0, 1},
+    {"write_writev", reset_work, run_write_writev, 0, 0},
+};
+
+// Helper function to sort timings
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to display usage
+static void print_usage(const char* program_name) {
+    fprintf(stderr, "Usage: %s [options]\n", program_name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -s WxH[,WxH...]         Image sizes (default: 64x64 up to 4095x3071).\n");
+    fprintf(stderr, "  -L                      Also run 8191x8191 and 16384x16384.\n");
+    fprintf(stderr, "  -n <count>              Timed repetitions of every stage (default: %d).\n", BENCH_REPETITIONS);
+    fprintf(stderr, "  -w <count>              Warm-up repetitions of every stage (default: %d).\n", BENCH_WARMUP);
+    fprintf(stderr, "  -j <threads>            Number of threads (default: number of CPUs).\n");
+    fprintf(stderr, "  -k <kernels>            Kernel set: scalar, sse2, ssse3 or avx2 (default: best).\n");
+    fprintf(stderr, "  -l <layout>             Pixel layout of the work image: bgr (default), bgrx or planar.\n");
+    fprintf(stderr, "  -V                      Verify the kernel sets against the scalar ones first.\n");
+    fprintf(stderr, "  -d <directory>          Directory for the synthetic files (default: $TMPDIR or /tmp).\n");
+    fprintf(stderr, "  -o results.json         Write the results to a file instead of stdout.\n");
+}
+
+// Function to parse a list of sizes such as 64x64,1021x767
+static int parse_sizes(const char* text, int sizes[][2], int* count) {
+    *count = 0;
+    while(*text != '\0'){
+        int width, height, used;
+        if(*count == BENCH_MAX_SIZES || sscanf(text, "%dx%d%n", &width, &height, &used) != 2 ||
+           width <= 0 || height <= 0){
+            return 0;
+        }
+        sizes[*count][0] = width;
+        sizes[*count][1] = height;
+        (*count)++;
+        text += used;
+        if(*text == ',') text++;
+        else if(*text != '\0') return 0;
+    }
+    return *count > 0;
+}
+
+// Function to benchmark all stages on one image size and print their results
+static int bench_size(FILE* out, int width, int height, enum ImageLayout layout, const char* dir,
+                      int repetitions, int warmup, int* first) {
+    struct BenchContext ctx;
+    ctx.width = width;
+    ctx.height = height;
+    snprintf(ctx.input_path, sizeof(ctx.input_path), "%s/bmpbench_%dx%d_%d.bmp", dir, width, height, (int)getpid());
+    snprintf(ctx.output_path, sizeof(ctx.output_path), "%s/bmpbench_%dx%d_%d_out.bmp", dir, width, height, (int)getpid());
+    ctx.master = image_create(width, height);
+    ctx.work = image_create_layout(width, height, layout, IMAGE_ALLOC_DEFAULT);
+    if(ctx.master == NULL || ctx.work == NULL){
+        image_destroy(&ctx.master);
+        image_destroy(&ctx.work);
+        return 0;
+    }
+
+    // Write the synthetic input file
+    fill_synthetic(ctx.master);
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+    makeBMPHeader(&bmp_header, width, height);
+    makeDIBHeader(&dib_header, width, height);
+    if(!writeImageBMP(ctx.input_path, &bmp_header, &dib_header, ctx.master, BMP_WRITE_DEFAULT)){
+        image_destroy(&ctx.master);
+        image_destroy(&ctx.work);
+        return 0;
+    }
+
+    double* times = (double*)malloc(repetitions * sizeof(double));
+    int ok = times != NULL;
+    double pixels = (double)width * height;
+    for(size_t s = 0; ok && s < sizeof(stages) / sizeof(stages[0]); s++){
+        const struct BenchStage* stage = &stages[s];
+        if(stage->upscales && pixels > BENCH_MAX_UPSCALE_PIXELS) continue;
+        if(stage->packed_only && layout != IMAGE_LAYOUT_BGR) continue;
+
+        for(int r = 0; ok && r < warmup + repetitions; r++){
+            stage->setup(&ctx);
+            double start = now_seconds();
+            ok = stage->run(&ctx);
+            double elapsed = now_seconds() - start;
+            if(r >= warmup) times[r - warmup] = elapsed;
+        }
+        if(!ok){
+            fprintf(stderr, "Stage %s failed on %dx%d.\n", stage->name, width, height);
+            break;
+        }
+
+        // Rates are relative to the source pixels and their 3 bytes each
+        qsort(times, repetitions, sizeof(double), compare_doubles);
+        double median = repetitions % 2 ? times[repetitions / 2] :
+                        (times[repetitions / 2 - 1] + times[repetitions / 2]) / 2;
+        fprintf(out, "%s    {\"stage\": \"%s\", \"width\": %d, \"height\": %d, "
+                "\"median_ms\": %.3f, \"min_ms\": %.3f, \"mpixels_per_s\": %.1f, \"gbytes_per_s\": %.3f}",
+                *first ? "" : ",\n", stage->name, width, height, median * 1e3, times[0] * 1e3,
+                pixels / median / 1e6, pixels * sizeof(struct Pixel) / median / 1e9);
+        *first = 0;
+        fflush(out);
+    }
+
+    free(times);
+    remove(ctx.input_path);
+    remove(ctx.output_path);
+    image_destroy(&ctx.master);
+    image_destroy(&ctx.work);
+    return ok;
+}
+
+// Main function
+int main(int argc, char *argv[]) {
+    int sizes[BENCH_MAX_SIZES][2];
+    int size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+    int large = 0;
+    int repetitions = BENCH_REPETITIONS;
+    int warmup = BENCH_WARMUP;
+    int threads = 0;
+    int verify = 0;
+    enum ImageLayout layout = IMAGE_LAYOUT_BGR;
+    const char* kernel_name = NULL;
+    const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    const char* output_filename = NULL;
+
+    int opt;
+    opterr = 0;
+    while((opt = getopt(argc, argv, "s:Ln:w:j:k:l:Vd:o:")) != -1){
+        switch(opt){
+            case 's':
+                if(!parse_sizes(optarg, sizes, &size_count)){
+                    fprintf(stderr, "Invalid value for -s: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'L':
+                large = 1;
+                break;
+            case 'n':
+                repetitions = atoi(optarg);
+                if(repetitions <= 0){
+                    fprintf(stderr, "Invalid value for -n: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'w':
+                warmup = atoi(optarg);
+                if(warmup < 0){
+                    fprintf(stderr, "Invalid value for -w: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'k':
+                kernel_name = optarg;
+                break;
+            case 'l':
+                if(!image_layout_from_name(optarg, &layout)){
+                    fprintf(stderr, "Invalid value for -l: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(large){
+        for(size_t i = 0; i < sizeof(large_sizes) / sizeof(large_sizes[0]) && size_count < BENCH_MAX_SIZES; i++){
+            sizes[size_count][0] = large_sizes[i][0];
+            sizes[size_count][1] = large_sizes[i][1];
+            size_count++;
+        }
+    }
+
+    // Pick the kernel set by name
+    if(kernel_name != NULL){
+        int found = 0;
+        for(int level = 0; level < KERNEL_LEVEL_COUNT && !found; level++){
+            const struct PixelKernels* k = pixel_kernels_for((enum KernelLevel)level);
+            if(k != NULL && strcmp(k->name, kernel_name) == 0){
+                found = pixel_kernels_select((enum KernelLevel)level);
+            }
+        }
+        if(!found){
+            fprintf(stderr, "Kernel set %s is unknown or not supported by this CPU.\n", kernel_name);
+            return EXIT_FAILURE;
+        }
+    }
+    int verified = verify ? pixel_kernels_verify() : -1;
+    if(verified == 0){
+        fprintf(stderr, "Kernel verification failed.\n");
+    }
+
+    FILE* out = stdout;
+    if(output_filename != NULL){
+        out = fopen(output_filename, "w");
+        if(out == NULL){
+            perror("Error opening output file");
+            return EXIT_FAILURE;
+        }
+    }
+
+    ThreadPool* pool = threadpool_create(threads);
+    threadpool_set_default(pool);
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"kernels\": \"%s\",\n", pixel_kernels()->name);
+    fprintf(out, "  \"kernels_verified\": %s,\n", verified < 0 ? "null" : verified ? "true" : "false");
+    fprintf(out, "  \"layout\": \"%s\",\n", image_layout_name(layout));
+    fprintf(out, "  \"threads\": %d,\n", threadpool_get_threads(pool));
+    fprintf(out, "  \"repetitions\": %d,\n", repetitions);
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"results\": [\n");
+    int ok = 1;
+    int first = 1;
+    for(int i = 0; i < size_count && ok; i++){
+        ok = bench_size(out, sizes[i][0], sizes[i][1], layout, dir, repetitions, warmup, &first);
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    threadpool_destroy(&pool);
+    if(out != stdout){
+        fclose(out);
+    }
+    return ok && verified != 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -9,25 +9,134 @@
 
 // BMPHandler.c
 
+#define _GNU_SOURCE
+
 #include "BMPHandler.h"
+#include "Stats.h"
+#include "BufferPool.h"
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <stdint.h>
+
+// Chunk size used when a source has to be read with buffered reads
+#define BMP_READ_CHUNK (1 << 20)
+
+// Alignment required for O_DIRECT buffers and transfer sizes
+#define BMP_DIRECT_ALIGN 4096
+
+// Number of iovecs handed to a single writev call
+#ifdef IOV_MAX
+#define BMP_IOV_BATCH IOV_MAX
+#else
+#define BMP_IOV_BATCH 1024
+#endif
+
+// Helper functions to decode little endian fields
+static unsigned short get_u16(const unsigned char* p) {
+    return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static unsigned int get_u32(const unsigned char* p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void put_u16(unsigned char* p, unsigned short v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+// Function to open an input file, standard input for BMP_STDIO_NAME
+static int open_input(const char* filename) {
+    if(strcmp(filename, BMP_STDIO_NAME) == 0) return STDIN_FILENO;
+    return open(filename, O_RDONLY);
+}
+
+// Function to open an output file, standard output for BMP_STDIO_NAME
+static int open_output(const char* filename, int flags) {
+    if(strcmp(filename, BMP_STDIO_NAME) == 0) return STDOUT_FILENO;
+    return open(filename, O_WRONLY | O_CREAT | O_TRUNC | flags, 0644);
+}
+
+// Function to close a file, leaving standard input and output open
+static int close_file(int fd) {
+    if(fd == STDIN_FILENO || fd == STDOUT_FILENO) return 0;
+    return close(fd);
+}
+
+// Function to parse BMP Header from raw bytes
+void parseBMPHeader(const unsigned char* buffer, struct BMP_Header* header) {
+    header->bfType = get_u16(buffer);
+    header->bfSize = get_u32(buffer + 2);
+    header->bfReserved1 = get_u16(buffer + 6);
+    header->bfReserved2 = get_u16(buffer + 8);
+    header->bfOffBits = get_u32(buffer + 10);
+}
+
+// Function to parse DIB Header from raw bytes
+void parseDIBHeader(const unsigned char* buffer, struct DIB_Header* header) {
+    header->biSize = get_u32(buffer);
+    header->biWidth = (int)get_u32(buffer + 4);
+    header->biHeight = (int)get_u32(buffer + 8);
+    header->biPlanes = get_u16(buffer + 12);
+    header->biBitCount = get_u16(buffer + 14);
+    header->biCompression = get_u32(buffer + 16);
+    header->biSizeImage = get_u32(buffer + 20);
+    header->biXPelsPerMeter = (int)get_u32(buffer + 24);
+    header->biYPelsPerMeter = (int)get_u32(buffer + 28);
+    header->biClrUsed = get_u32(buffer + 32);
+    header->biClrImportant = get_u32(buffer + 36);
+}
+
+// Function to serialize BMP Header into raw bytes
+void serializeBMPHeader(unsigned char* buffer, const struct BMP_Header* header) {
+    put_u16(buffer, header->bfType);
+    put_u32(buffer + 2, header->bfSize);
+    put_u16(buffer + 6, header->bfReserved1);
+    put_u16(buffer + 8, header->bfReserved2);
+    put_u32(buffer + 10, header->bfOffBits);
+}
+
+// Function to serialize DIB Header into raw bytes
+void serializeDIBHeader(unsigned char* buffer, const struct DIB_Header* header) {
+    put_u32(buffer, header->biSize);
+    put_u32(buffer + 4, (unsigned int)header->biWidth);
+    put_u32(buffer + 8, (unsigned int)header->biHeight);
+    put_u16(buffer + 12, header->biPlanes);
+    put_u16(buffer + 14, header->biBitCount);
+    put_u32(buffer + 16, header->biCompression);
+    put_u32(buffer + 20, header->biSizeImage);
+    put_u32(buffer + 24, (unsigned int)header->biXPelsPerMeter);
+    put_u32(buffer + 28, (unsigned int)header->biYPelsPerMeter);
+    put_u32(buffer + 32, header->biClrUsed);
+    put_u32(buffer + 36, header->biClrImportant);
+}
 
 // Function to read BMP Header from a file
 void readBMPHeader(FILE* file, struct BMP_Header* header) {
-    fread(&header->bfType, sizeof(unsigned short), 1, file);
-    fread(&header->bfSize, sizeof(unsigned int), 1, file);
-    fread(&header->bfReserved1, sizeof(unsigned short), 1, file);
-    fread(&header->bfReserved2, sizeof(unsigned short), 1, file);
-    fread(&header->bfOffBits, sizeof(unsigned int), 1, file);
+    unsigned char buffer[BMP_HEADER_SIZE] = {0};
+    fread(buffer, 1, BMP_HEADER_SIZE, file);
+    parseBMPHeader(buffer, header);
 }
 
 // Function to write BMP Header to a file
 void writeBMPHeader(FILE* file, struct BMP_Header* header) {
-    fwrite(&header->bfType, sizeof(unsigned short), 1, file);
-    fwrite(&header->bfSize, sizeof(unsigned int), 1, file);
-    fwrite(&header->bfReserved1, sizeof(unsigned short), 1, file);
-    fwrite(&header->bfReserved2, sizeof(unsigned short), 1, file);
-    fwrite(&header->bfOffBits, sizeof(unsigned int), 1, file);
+    unsigned char buffer[BMP_HEADER_SIZE];
+    serializeBMPHeader(buffer, header);
+    fwrite(buffer, 1, BMP_HEADER_SIZE, file);
 }
 
 // Function to create BMP Header based on width and height
@@ -43,32 +152,16 @@ void makeBMPHeader(struct BMP_Header* header, int width, int height) {
 
 // Function to read DIB Header from a file
 void readDIBHeader(FILE* file, struct DIB_Header* header) {
-    fread(&header->biSize, sizeof(unsigned int), 1, file);
-    fread(&header->biWidth, sizeof(int), 1, file);
-    fread(&header->biHeight, sizeof(int), 1, file);
-    fread(&header->biPlanes, sizeof(unsigned short), 1, file);
-    fread(&header->biBitCount, sizeof(unsigned short), 1, file);
-    fread(&header->biCompression, sizeof(unsigned int), 1, file);
-    fread(&header->biSizeImage, sizeof(unsigned int), 1, file);
-    fread(&header->biXPelsPerMeter, sizeof(int), 1, file);
-    fread(&header->biYPelsPerMeter, sizeof(int), 1, file);
-    fread(&header->biClrUsed, sizeof(unsigned int), 1, file);
-    fread(&header->biClrImportant, sizeof(unsigned int), 1, file);
+    unsigned char buffer[DIB_HEADER_SIZE] = {0};
+    fread(buffer, 1, DIB_HEADER_SIZE, file);
+    parseDIBHeader(buffer, header);
 }
 
 // Function to write DIB Header to a file
 void writeDIBHeader(FILE* file, struct DIB_Header* header) {
-    fwrite(&header->biSize, sizeof(unsigned int), 1, file);
-    fwrite(&header->biWidth, sizeof(int), 1, file);
-    fwrite(&header->biHeight, sizeof(int), 1, file);
-    fwrite(&header->biPlanes, sizeof(unsigned short), 1, file);
-    fwrite(&header->biBitCount, sizeof(unsigned short), 1, file);
-    fwrite(&header->biCompression, sizeof(unsigned int), 1, file);
-    fwrite(&header->biSizeImage, sizeof(unsigned int), 1, file);
-    fwrite(&header->biXPelsPerMeter, sizeof(int), 1, file);
-    fwrite(&header->biYPelsPerMeter, sizeof(int), 1, file);
-    fwrite(&header->biClrUsed, sizeof(unsigned int), 1, file);
-    fwrite(&header->biClrImportant, sizeof(unsigned int), 1, file);
+    unsigned char buffer[DIB_HEADER_SIZE];
+    serializeDIBHeader(buffer, header);
+    fwrite(buffer, 1, DIB_HEADER_SIZE, file);
 }
 
 // Function to create DIB Header based on width and height
@@ -89,24 +182,906 @@ void makeDIBHeader(struct DIB_Header* header, int width, int height) {
 }
 
 // Function to read pixel data from BMP file
-void readPixelsBMP(FILE* file, struct Pixel** pArr, int width, int height) {
-    // Move to pixel array
-    fseek(file, 14 + 40, SEEK_SET);
+void readPixelsBMP(FILE* file, struct Pixel** pArr, int width, int height, unsigned int offset) {
+    // Move forward to pixel array, reading past anything between the headers and it
+    unsigned char skip[256];
+    for(unsigned int pos = BMP_HEADER_SIZE + DIB_HEADER_SIZE; pos < offset; ){
+        size_t n = offset - pos < sizeof(skip) ? offset - pos : sizeof(skip);
+        if(fread(skip, 1, n, file) != n) return;
+        pos += n;
+    }
     int padding = (4 - (width * 3) % 4) % 4;
     for(int i = height -1; i >=0 ; i--){
         fread(pArr[i], sizeof(struct Pixel), width, file);
-        fseek(file, padding, SEEK_CUR);
+        fread(skip, 1, padding, file);
+    }
+}
+
+// Function to read a whole stream into a pooled buffer of *capacity bytes
+static unsigned char* read_all(int fd, size_t hint, size_t* length, size_t* capacity) {
+    size_t size = buffer_pool_class_size(hint > 0 ? hint : BMP_READ_CHUNK);
+    size_t used = 0;
+    unsigned char* buffer = (unsigned char*)buffer_pool_alloc(size);
+    if(buffer == NULL){
+        perror("Failed to allocate memory for input buffer");
+        return NULL;
+    }
+    for(;;){
+        if(used == size){
+            size_t grown_size = buffer_pool_class_size(size * 2);
+            unsigned char* grown = (unsigned char*)buffer_pool_alloc(grown_size);
+            if(grown == NULL){
+                perror("Failed to allocate memory for input buffer");
+                buffer_pool_free(buffer, size);
+                return NULL;
+            }
+            memcpy(grown, buffer, used);
+            buffer_pool_free(buffer, size);
+            buffer = grown;
+            size = grown_size;
+        }
+        ssize_t n = read(fd, buffer + used, size - used);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            perror("Error reading input file");
+            buffer_pool_free(buffer, size);
+            return NULL;
+        }
+        if(n == 0) break;
+        used += n;
+        stats_add_read(n);
+    }
+    *length = used;
+    *capacity = size;
+    return buffer;
+}
+
+// Function to tell whether a bit count is that of an indexed BMP file
+static int isIndexedBitCount(unsigned short bits) {
+    return bits == 1 || bits == 4 || bits == 8;
+}
+
+// Function to validate headers against the length of the file and compute
+// the row stride; length is SIZE_MAX when the length is not known. Indexed
+// and 32-bit files are only accepted when they are read whole. A 32-bit file
+// may use BI_BITFIELDS, whose masks the caller checks.
+static int validateHeadersBMP(const struct BMP_Header* bmp_header, const struct DIB_Header* dib_header,
+                              size_t length, size_t* stride, int whole) {
+    if(bmp_header->bfType != 0x4D42){
+        fprintf(stderr, "Input file is not a valid BMP file.\n");
+        return 0;
+    }
+    unsigned short bits = dib_header->biBitCount;
+    int uncompressed = dib_header->biCompression == 0 ||
+                       (bits == 32 && dib_header->biCompression == BMP_BITFIELDS);
+    if((bits != 24 && bits != 32 && !isIndexedBitCount(bits)) || !uncompressed){
+        fprintf(stderr, "Unsupported BMP format. Only 24 and 32-bit and 1, 4 or 8-bit indexed uncompressed BMP files are supported.\n");
+        return 0;
+    }
+    if(bits != 24 && !whole){
+        fprintf(stderr, "Indexed and 32-bit BMP files cannot be streamed, they must be read whole from a file.\n");
+        return 0;
+    }
+    *stride = (((size_t)dib_header->biWidth * dib_header->biBitCount + 31) / 32) * 4;
+    if(dib_header->biWidth <= 0 || dib_header->biHeight <= 0 ||
+       bmp_header->bfOffBits > length ||
+       (length - bmp_header->bfOffBits) / *stride < (size_t)dib_header->biHeight){
+        fprintf(stderr, "Input file is truncated or has invalid dimensions.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Function to parse and validate the headers of a source and locate its pixels
+static int parseSourceBMP(struct BMP_Source* source) {
+    if(source->length < BMP_HEADER_SIZE + DIB_HEADER_SIZE){
+        fprintf(stderr, "Input file is not a valid BMP file.\n");
+        closeBMPSource(source);
+        return 0;
+    }
+    parseBMPHeader(source->base, &source->bmp_header);
+    parseDIBHeader(source->base + BMP_HEADER_SIZE, &source->dib_header);
+    if(!validateHeadersBMP(&source->bmp_header, &source->dib_header, source->length, &source->stride, 1)){
+        closeBMPSource(source);
+        return 0;
+    }
+    source->width = source->dib_header.biWidth;
+    source->height = source->dib_header.biHeight;
+    source->pixels = source->base + source->bmp_header.bfOffBits;
+    source->bits = source->dib_header.biBitCount;
+
+    // Bit fields right after a 40 byte header, or inside a larger one, must
+    // be the plain blue, green, red byte order
+    if(source->dib_header.biCompression == BMP_BITFIELDS){
+        const unsigned char* masks = source->base + BMP_HEADER_SIZE + DIB_HEADER_SIZE;
+        if(source->bmp_header.bfOffBits < BMP_HEADER_SIZE + DIB_HEADER_SIZE + 12 ||
+           get_u32(masks) != 0x00FF0000 || get_u32(masks + 4) != 0x0000FF00 || get_u32(masks + 8) != 0x000000FF){
+            fprintf(stderr, "Unsupported BMP format. Only standard 32-bit bit fields are supported.\n");
+            closeBMPSource(source);
+            return 0;
+        }
+    }
+
+    // The palette follows the DIB header and ends before the pixel array
+    if(isIndexedBitCount(source->bits)){
+        size_t start = (size_t)BMP_HEADER_SIZE + source->dib_header.biSize;
+        size_t colors = source->dib_header.biClrUsed ? source->dib_header.biClrUsed : (size_t)1 << source->bits;
+        if(colors > ((size_t)1 << source->bits)) colors = (size_t)1 << source->bits;
+        if(start <= source->bmp_header.bfOffBits && colors > (source->bmp_header.bfOffBits - start) / 4){
+            colors = (source->bmp_header.bfOffBits - start) / 4;
+        }
+        if(start > source->bmp_header.bfOffBits || colors == 0){
+            fprintf(stderr, "Input file has no valid color table.\n");
+            closeBMPSource(source);
+            return 0;
+        }
+        source->palette = source->base + start;
+        source->colors = (int)colors;
+    }
+    return 1;
+}
+
+// Function to open a BMP file as a mapped source
+int openBMPSource(const char* filename, struct BMP_Source* source) {
+    memset(source, 0, sizeof(*source));
+
+    int fd = open_input(filename);
+    if(fd < 0){
+        perror("Error opening input file");
+        return 0;
+    }
+
+    // Map regular files, fall back to buffered reads for pipes; standard
+    // input redirected from a file is only mapped when nothing was read yet
+    struct stat st;
+    int regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+    if(regular && lseek(fd, 0, SEEK_CUR) == 0){
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED){
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            madvise(p, st.st_size, MADV_WILLNEED);
+            source->base = (unsigned char*)p;
+            source->length = st.st_size;
+            source->mapped = 1;
+            stats_add_read(source->length);
+        }
+    }
+    if(source->base == NULL){
+        size_t hint = regular ? (size_t)st.st_size + 1 : 0;
+        source->base = read_all(fd, hint, &source->length, &source->capacity);
+        if(source->base == NULL){
+            close_file(fd);
+            return 0;
+        }
+    }
+    close_file(fd);
+    return parseSourceBMP(source);
+}
+
+// Function to open a BMP file held in memory as a source
+int openBMPBuffer(const unsigned char* data, size_t length, struct BMP_Source* source) {
+    memset(source, 0, sizeof(*source));
+    source->base = (unsigned char*)data;
+    source->length = length;
+    source->borrowed = 1;
+    return parseSourceBMP(source);
+}
+
+// Function to close a source
+void closeBMPSource(struct BMP_Source* source) {
+    if(source->base != NULL && !source->borrowed){
+        if(source->mapped) munmap(source->base, source->length);
+        else buffer_pool_free(source->base, source->capacity);
+    }
+    source->base = NULL;
+    source->pixels = NULL;
+}
+
+// Function to copy the palette and indices of an indexed source into an
+// image. Rows are taken top-down, or in their bottom-up file order if flip
+// is set, which mirrors the image vertically.
+static void copy_indexed(const struct BMP_Source* source, Image* img, int flip) {
+    struct Pixel* palette = image_get_palette(img);
+    for(int k = 0; k < source->colors; k++){
+        palette[k].blue = source->palette[4 * k];
+        palette[k].green = source->palette[4 * k + 1];
+        palette[k].red = source->palette[4 * k + 2];
+    }
+
+    // 1 and 4-bit indices are packed high bits first
+    int width = source->width;
+    for(int i = 0; i < source->height; i++){
+        int file_row = flip ? i : source->height - 1 - i;
+        const unsigned char* src = source->pixels + (size_t)file_row * source->stride;
+        unsigned char* dst = image_get_index_row(img, i);
+        switch(source->bits){
+            case 8:
+                memcpy(dst, src, width);
+                break;
+            case 4:
+                for(int j = 0; j < width; j++){
+                    dst[j] = (j & 1) ? src[j >> 1] & 0x0F : src[j >> 1] >> 4;
+                }
+                break;
+            default:
+                for(int j = 0; j < width; j++){
+                    dst[j] = (src[j >> 3] >> (7 - (j & 7))) & 1;
+                }
+                break;
+        }
+    }
+}
+
+// Function to copy the palette and indices of an indexed source into an image
+void copyIndexedBMP(const struct BMP_Source* source, Image* img) {
+    copy_indexed(source, img, 0);
+}
+
+// Function to get a row of a source in place
+const struct Pixel* getSourceRowBMP(const struct BMP_Source* source, int row) {
+    return (const struct Pixel*)(source->pixels + (size_t)(source->height - 1 - row) * source->stride);
+}
+
+// Function to copy the pixels of a source into an image, rows top-down or
+// in their bottom-up file order if flip is set
+static void copy_pixels(const struct BMP_Source* source, Image* img, int flip) {
+    int height = source->height;
+    if(source->bits != 24 || image_get_layout(img) != IMAGE_LAYOUT_BGR){
+        // Converted to the layout of the image on the way
+        for(int i = 0; i < height; i++){
+            image_load_row(img, i, (const unsigned char*)getSourceRowBMP(source, flip ? height - 1 - i : i),
+                           source->bits);
+        }
+        return;
+    }
+    size_t row_bytes = (size_t)source->width * sizeof(struct Pixel);
+    for(int i = 0; i < height; i++){
+        memcpy(image_get_row(img, i), getSourceRowBMP(source, flip ? height - 1 - i : i), row_bytes);
     }
 }
 
-// Function to write pixel data to BMP file
+// Function to copy the pixels of a source into an image
+void copyPixelsBMP(const struct BMP_Source* source, Image* img) {
+    copy_pixels(source, img, 0);
+}
+
+// Function to copy a source into an image mirrored vertically
+void copyFlippedBMP(const struct BMP_Source* source, Image* img) {
+    if(isIndexedBitCount(source->bits)) copy_indexed(source, img, 1);
+    else copy_pixels(source, img, 1);
+}
+
+// Function to write pixel data to BMP file, right after its headers
 void writePixelsBMP(FILE* file, struct Pixel** pArr, int width, int height) {
-    // Move to pixel array position
-    fseek(file, 14 + 40, SEEK_SET);
-    int padding = (4 - (width * 3) % 4) % 4;
-    unsigned char pad[3] = {0, 0, 0};
+    size_t row_bytes = (size_t)width * sizeof(struct Pixel);
+    size_t row_size = (row_bytes + 3) & ~(size_t)3;
+    unsigned char* row = (unsigned char*)calloc(row_size, 1);
+    if(row == NULL){
+        perror("Failed to allocate memory for output row");
+        return;
+    }
+    // Padding is part of the row buffer, so each row is a single fwrite
     for(int i = height -1; i >=0 ; i--){
-        fwrite(pArr[i], sizeof(struct Pixel), width, file);
-        fwrite(pad, sizeof(unsigned char), padding, file);
+        memcpy(row, pArr[i], row_bytes);
+        fwrite(row, 1, row_size, file);
+    }
+    free(row);
+}
+
+// Function to write a whole iovec list, resuming after partial writes
+static int write_iovecs(int fd, struct iovec* iov, int count) {
+    while(count > 0){
+        int batch = count < BMP_IOV_BATCH ? count : BMP_IOV_BATCH;
+        ssize_t n = writev(fd, iov, batch);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return 0;
+        }
+        stats_add_written(n);
+        // Skip fully written entries and advance into a partial one
+        while(count > 0 && (size_t)n >= iov->iov_len){
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if(count > 0){
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 1;
+}
+
+// Function to write a buffer completely
+static int write_all(int fd, const unsigned char* buffer, size_t length) {
+    while(length > 0){
+        ssize_t n = write(fd, buffer, length);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return 0;
+        }
+        stats_add_written(n);
+        buffer += n;
+        length -= n;
+    }
+    return 1;
+}
+
+// Function to get the bit count an image is written with: 32 if the DIB
+// header asks for it, 24 otherwise
+static int outputBitCountBMP(const struct DIB_Header* dib_header) {
+    return dib_header->biBitCount == 32 ? 32 : 24;
+}
+
+// Function to lay out a whole BMP file in a buffer: headers, then padded rows
+// bottom row first, converted from the layout of the image to bits per pixel
+static void layoutFileBMP(unsigned char* buffer, const unsigned char* headers, Image* img, size_t row_size, int bits) {
+    size_t row_bytes = (size_t)img->width * (bits / 8);
+    int convert = bits != 24 || image_get_layout(img) != IMAGE_LAYOUT_BGR;
+    memcpy(buffer, headers, BMP_HEADER_SIZE + DIB_HEADER_SIZE);
+    unsigned char* out = buffer + BMP_HEADER_SIZE + DIB_HEADER_SIZE;
+    for(int i = img->height - 1; i >= 0; i--){
+        if(convert) image_store_row(img, i, out, bits);
+        else memcpy(out, image_get_row(img, i), row_bytes);
+        memset(out + row_bytes, 0, row_size - row_bytes);
+        out += row_size;
+    }
+}
+
+// Function to write a BMP file through one O_DIRECT write of an assembled buffer
+static int write_direct(int fd, const unsigned char* headers, Image* img, size_t row_size, size_t file_size, int bits) {
+    size_t aligned_size = (file_size + BMP_DIRECT_ALIGN - 1) & ~(size_t)(BMP_DIRECT_ALIGN - 1);
+    void* p = NULL;
+    if(posix_memalign(&p, BMP_DIRECT_ALIGN, aligned_size) != 0){
+        fprintf(stderr, "Failed to allocate memory for output buffer.\n");
+        return 0;
+    }
+    unsigned char* buffer = (unsigned char*)p;
+    stats_add_allocation(aligned_size);
+    layoutFileBMP(buffer, headers, img, row_size, bits);
+    memset(buffer + file_size, 0, aligned_size - file_size);
+
+    // Write whole blocks, then trim the file to its real size
+    int ok = write_all(fd, buffer, aligned_size) && ftruncate(fd, file_size) == 0;
+    free(buffer);
+    return ok;
+}
+
+// Function to lay out a complete indexed BMP file for an image in a new heap
+// buffer. The bit count of dib_header is kept when the palette fits in it,
+// otherwise the smallest one that holds the palette is used.
+static unsigned char* layoutIndexedBMP(Image* img, const struct DIB_Header* dib_header, size_t* length) {
+    struct DIB_Header dib;
+    if(dib_header != NULL) dib = *dib_header;
+    else makeDIBHeader(&dib, img->width, img->height);
+    int colors = image_get_colors(img);
+    int bits = dib.biBitCount;
+    if(!isIndexedBitCount(bits) || colors > (1 << bits)){
+        bits = colors <= 2 ? 1 : (colors <= 16 ? 4 : 8);
+    }
+
+    size_t row_size = (((size_t)img->width * bits + 31) / 32) * 4;
+    size_t offset = BMP_HEADER_SIZE + DIB_HEADER_SIZE + 4 * (size_t)colors;
+    size_t file_size = offset + row_size * img->height;
+    dib.biSize = DIB_HEADER_SIZE;
+    dib.biWidth = img->width;
+    dib.biHeight = img->height;
+    dib.biPlanes = 1;
+    dib.biBitCount = bits;
+    dib.biCompression = 0;
+    dib.biSizeImage = row_size * img->height;
+    dib.biClrUsed = colors;
+    dib.biClrImportant = 0;
+    struct BMP_Header bmp;
+    bmp.bfType = 0x4D42;
+    bmp.bfSize = file_size;
+    bmp.bfReserved1 = 0;
+    bmp.bfReserved2 = 0;
+    bmp.bfOffBits = offset;
+
+    unsigned char* buffer = (unsigned char*)buffer_pool_alloc(file_size);
+    if(buffer == NULL){
+        perror("Failed to allocate memory for output buffer");
+        return NULL;
+    }
+    serializeBMPHeader(buffer, &bmp);
+    serializeDIBHeader(buffer + BMP_HEADER_SIZE, &dib);
+
+    // Palette entries are stored as blue, green, red and a reserved byte
+    const struct Pixel* palette = image_get_palette(img);
+    unsigned char* out = buffer + BMP_HEADER_SIZE + DIB_HEADER_SIZE;
+    for(int k = 0; k < colors; k++){
+        out[4 * k] = palette[k].blue;
+        out[4 * k + 1] = palette[k].green;
+        out[4 * k + 2] = palette[k].red;
+        out[4 * k + 3] = 0;
+    }
+
+    // Rows bottom-up, 1 and 4-bit indices packed high bits first
+    out = buffer + offset;
+    for(int i = img->height - 1; i >= 0; i--){
+        const unsigned char* src = image_get_index_row(img, i);
+        memset(out, 0, row_size);
+        switch(bits){
+            case 8:
+                memcpy(out, src, img->width);
+                break;
+            case 4:
+                for(int j = 0; j < img->width; j++){
+                    out[j >> 1] |= (j & 1) ? (src[j] & 0x0F) : (unsigned char)(src[j] << 4);
+                }
+                break;
+            default:
+                for(int j = 0; j < img->width; j++){
+                    out[j >> 3] |= (unsigned char)((src[j] & 1) << (7 - (j & 7)));
+                }
+                break;
+        }
+        out += row_size;
+    }
+    *length = file_size;
+    return buffer;
+}
+
+// Function to write a complete indexed BMP file for an image with one write
+static int writeIndexedBMP(const char* filename, const struct DIB_Header* dib_header, Image* img) {
+    size_t file_size;
+    unsigned char* buffer = layoutIndexedBMP(img, dib_header, &file_size);
+    if(buffer == NULL){
+        return 0;
+    }
+    int fd = open_output(filename, 0);
+    if(fd < 0){
+        perror("Error opening output file");
+        bmp_buffer_free(buffer, file_size);
+        return 0;
+    }
+    int ok = write_all(fd, buffer, file_size);
+    if(!ok){
+        perror("Error writing output file");
+    }
+    if(close_file(fd) != 0 && ok){
+        perror("Error closing output file");
+        ok = 0;
+    }
+    bmp_buffer_free(buffer, file_size);
+    return ok;
+}
+
+// Function to write a complete BMP file for an image
+int writeImageBMP(const char* filename, const struct BMP_Header* bmp_header,
+                  const struct DIB_Header* dib_header, Image* img, int flags) {
+    if(image_is_indexed(img)){
+        // Indexed files are small, so they are always laid out and written at once
+        return writeIndexedBMP(filename, dib_header, img);
+    }
+    int bits = outputBitCountBMP(dib_header);
+    size_t row_bytes = (size_t)img->width * (bits / 8);
+    size_t row_size = (row_bytes + 3) & ~(size_t)3;
+    size_t file_size = BMP_HEADER_SIZE + DIB_HEADER_SIZE + row_size * img->height;
+
+    unsigned char headers[BMP_HEADER_SIZE + DIB_HEADER_SIZE];
+    serializeBMPHeader(headers, bmp_header);
+    serializeDIBHeader(headers + BMP_HEADER_SIZE, dib_header);
+
+    // Standard output cannot be reopened with O_DIRECT nor trimmed afterwards
+    int fd = -1;
+    int direct = 0;
+    if((flags & BMP_WRITE_DIRECT) && strcmp(filename, BMP_STDIO_NAME) != 0){
+        fd = open_output(filename, O_DIRECT);
+        direct = fd >= 0;
+    }
+    if(fd < 0){
+        fd = open_output(filename, 0);
+    }
+    if(fd < 0){
+        perror("Error opening output file");
+        return 0;
+    }
+
+    if(flags & BMP_WRITE_FALLOCATE){
+        // Failure only means the file system cannot preallocate
+        posix_fallocate(fd, 0, file_size);
+    }
+
+    int ok;
+    if(direct){
+        ok = write_direct(fd, headers, img, row_size, file_size, bits);
+    }
+    else if(bits != 24 || image_get_layout(img) != IMAGE_LAYOUT_BGR){
+        // Rows need converting, so the file is assembled and written at once
+        unsigned char* buffer = (unsigned char*)buffer_pool_alloc(file_size);
+        if(buffer == NULL){
+            fprintf(stderr, "Failed to allocate memory for output buffer.\n");
+            close_file(fd);
+            return 0;
+        }
+        layoutFileBMP(buffer, headers, img, row_size, bits);
+        ok = write_all(fd, buffer, file_size);
+        buffer_pool_free(buffer, file_size);
+    }
+    else{
+        // One iovec for the headers, then each row followed by its padding
+        size_t padding = row_size - row_bytes;
+        int count = 1 + img->height * (padding ? 2 : 1);
+        struct iovec* iov = (struct iovec*)buffer_pool_alloc(count * sizeof(struct iovec));
+        if(iov == NULL){
+            perror("Failed to allocate memory for output iovecs");
+            close_file(fd);
+            return 0;
+        }
+        static unsigned char pad[3] = {0, 0, 0};
+        int k = 0;
+        iov[k].iov_base = headers;
+        iov[k++].iov_len = sizeof(headers);
+        for(int i = img->height - 1; i >= 0; i--){
+            iov[k].iov_base = image_get_row(img, i);
+            iov[k++].iov_len = row_bytes;
+            if(padding){
+                iov[k].iov_base = pad;
+                iov[k++].iov_len = padding;
+            }
+        }
+        ok = write_iovecs(fd, iov, count);
+        buffer_pool_free(iov, count * sizeof(struct iovec));
+    }
+
+    if(!ok){
+        perror("Error writing output file");
+    }
+    if(close_file(fd) != 0 && ok){
+        perror("Error closing output file");
+        ok = 0;
+    }
+    return ok;
+}
+
+// Function to decode a BMP file held in memory into an image
+Image* bmp_decode_from_buffer(unsigned char* data, size_t length, struct BMP_Header* bmp_header,
+                              struct DIB_Header* dib_header, int flags) {
+    struct BMP_Source source;
+    if(!openBMPBuffer(data, length, &source)){
+        return NULL;
+    }
+
+    Image* img;
+    int flip = (flags & BMP_DECODE_FLIP) != 0;
+    if(isIndexedBitCount(source.bits)){
+        // Packed indices have to be unpacked into an image of their own
+        img = image_create_indexed(source.width, source.height, source.colors);
+        if(img != NULL){
+            copy_indexed(&source, img, flip);
+        }
+    }
+    else if(source.bits == 32){
+        img = image_create_layout(source.width, source.height, IMAGE_LAYOUT_BGRX, IMAGE_ALLOC_DEFAULT);
+        if(img != NULL){
+            copy_pixels(&source, img, flip);
+        }
+    }
+    else if(flags & BMP_DECODE_COPY){
+        img = image_create(source.width, source.height);
+        if(img != NULL){
+            copy_pixels(&source, img, flip);
+        }
+    }
+    else if(flip){
+        // Taken in file order the rows are mirrored, for free
+        img = image_wrap((unsigned char*)source.pixels, source.width, source.height, (ptrdiff_t)source.stride);
+    }
+    else{
+        // Rows are stored bottom-up, so the top row is the last one in the buffer
+        img = image_wrap((unsigned char*)getSourceRowBMP(&source, 0), source.width, source.height,
+                         -(ptrdiff_t)source.stride);
+    }
+    if(img != NULL){
+        if(bmp_header != NULL) *bmp_header = source.bmp_header;
+        if(dib_header != NULL) *dib_header = source.dib_header;
+    }
+    closeBMPSource(&source);
+    return img;
+}
+
+// Function to encode an image as a BMP file in a pooled buffer
+unsigned char* bmp_encode_to_buffer(Image* img, const struct BMP_Header* bmp_header,
+                                    const struct DIB_Header* dib_header, size_t* length) {
+    if(image_is_indexed(img)){
+        return layoutIndexedBMP(img, dib_header, length);
+    }
+    struct BMP_Header bmp;
+    struct DIB_Header dib;
+    if(bmp_header != NULL && dib_header != NULL &&
+       dib_header->biWidth == img->width && dib_header->biHeight == img->height){
+        bmp = *bmp_header;
+        dib = *dib_header;
+        normalizeHeadersBMP(&bmp, &dib);
+    }
+    else{
+        makeBMPHeader(&bmp, img->width, img->height);
+        makeDIBHeader(&dib, img->width, img->height);
+        if(image_get_layout(img) == IMAGE_LAYOUT_BGRX) setBitCountBMP(&bmp, &dib, 32);
+    }
+
+    int bits = outputBitCountBMP(&dib);
+    size_t row_size = ((size_t)img->width * (bits / 8) + 3) & ~(size_t)3;
+    size_t file_size = BMP_HEADER_SIZE + DIB_HEADER_SIZE + row_size * img->height;
+    unsigned char* buffer = (unsigned char*)buffer_pool_alloc(file_size);
+    if(buffer == NULL){
+        perror("Failed to allocate memory for output buffer");
+        return NULL;
+    }
+
+    unsigned char headers[BMP_HEADER_SIZE + DIB_HEADER_SIZE];
+    serializeBMPHeader(headers, &bmp);
+    serializeDIBHeader(headers + BMP_HEADER_SIZE, &dib);
+    layoutFileBMP(buffer, headers, img, row_size, bits);
+    *length = file_size;
+    return buffer;
+}
+
+// Function to release a buffer returned by bmp_encode_to_buffer
+void bmp_buffer_free(unsigned char* buffer, size_t length) {
+    buffer_pool_free(buffer, length);
+}
+
+// Function to normalize headers for an output file
+void normalizeHeadersBMP(struct BMP_Header* bmp_header, struct DIB_Header* dib_header) {
+    if(bmp_header->bfOffBits != BMP_HEADER_SIZE + DIB_HEADER_SIZE || dib_header->biSize != DIB_HEADER_SIZE ||
+       dib_header->biCompression != 0){
+        size_t stride = ((size_t)dib_header->biWidth * (outputBitCountBMP(dib_header) / 8) + 3) & ~(size_t)3;
+        bmp_header->bfOffBits = BMP_HEADER_SIZE + DIB_HEADER_SIZE;
+        bmp_header->bfSize = bmp_header->bfOffBits + stride * dib_header->biHeight;
+        dib_header->biSize = DIB_HEADER_SIZE;
+        dib_header->biCompression = 0;
+    }
+}
+
+// Function to switch headers to another bit count
+void setBitCountBMP(struct BMP_Header* bmp_header, struct DIB_Header* dib_header, int bits) {
+    size_t stride = ((size_t)dib_header->biWidth * (bits / 8) + 3) & ~(size_t)3;
+    dib_header->biBitCount = bits;
+    dib_header->biCompression = 0;
+    dib_header->biSizeImage = stride * dib_header->biHeight;
+    bmp_header->bfSize = bmp_header->bfOffBits + dib_header->biSizeImage;
+}
+
+// Function to fill a whole iovec list, resuming after partial reads; returns
+// 0 with errno 0 at the end of the file
+static int read_iovecs(int fd, struct iovec* iov, int count) {
+    while(count > 0){
+        int batch = count < BMP_IOV_BATCH ? count : BMP_IOV_BATCH;
+        ssize_t n = readv(fd, iov, batch);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return 0;
+        }
+        if(n == 0){
+            errno = 0;
+            return 0;
+        }
+        stats_add_read(n);
+        // Skip fully read entries and advance into a partial one
+        while(count > 0 && (size_t)n >= iov->iov_len){
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if(count > 0){
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 1;
+}
+
+// Function to read a buffer completely
+static int read_full(int fd, void* buffer, size_t length) {
+    struct iovec iov = {buffer, length};
+    return read_iovecs(fd, &iov, 1);
+}
+
+// Function to report a failed read of an input file
+static void report_read_error(void) {
+    if(errno != 0){
+        perror("Error reading input file");
+    }
+    else{
+        fprintf(stderr, "Input file is truncated or has invalid dimensions.\n");
+    }
+}
+
+// Function to discard bytes of an input that cannot seek
+static int discard_bytes(int fd, size_t length) {
+    unsigned char buffer[4096];
+    while(length > 0){
+        size_t n = length < sizeof(buffer) ? length : sizeof(buffer);
+        if(!read_full(fd, buffer, n)) return 0;
+        length -= n;
+    }
+    return 1;
+}
+
+// Function to open a BMP file for reading row by row
+int openBMPReader(const char* filename, struct BMP_Reader* reader) {
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = open_input(filename);
+    if(reader->fd < 0){
+        perror("Error opening input file");
+        return 0;
+    }
+
+    // The length is only known for regular files
+    struct stat st;
+    size_t length = SIZE_MAX;
+    if(fstat(reader->fd, &st) == 0 && S_ISREG(st.st_mode)){
+        length = st.st_size;
+        posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    unsigned char headers[BMP_HEADER_SIZE + DIB_HEADER_SIZE];
+    if(!read_full(reader->fd, headers, sizeof(headers))){
+        if(errno != 0) perror("Error reading input file");
+        else fprintf(stderr, "Input file is not a valid BMP file.\n");
+        closeBMPReader(reader);
+        return 0;
+    }
+    parseBMPHeader(headers, &reader->bmp_header);
+    parseDIBHeader(headers + BMP_HEADER_SIZE, &reader->dib_header);
+    if(!validateHeadersBMP(&reader->bmp_header, &reader->dib_header, length, &reader->stride, 0)){
+        closeBMPReader(reader);
+        return 0;
+    }
+    reader->width = reader->dib_header.biWidth;
+    reader->height = reader->dib_header.biHeight;
+
+    // Move forward to the pixel array, discarding the bytes on a pipe
+    unsigned int offset = reader->bmp_header.bfOffBits;
+    if(offset < sizeof(headers)){
+        fprintf(stderr, "Input file is not a valid BMP file.\n");
+        closeBMPReader(reader);
+        return 0;
+    }
+    size_t skip = offset - sizeof(headers);
+    if(skip > 0 && lseek(reader->fd, skip, SEEK_CUR) < 0 && !discard_bytes(reader->fd, skip)){
+        report_read_error();
+        closeBMPReader(reader);
+        return 0;
+    }
+    return 1;
+}
+
+// Function to read the next rows of a reader
+int readRowsBMP(struct BMP_Reader* reader, struct Pixel** rows, int count) {
+    size_t row_bytes = (size_t)reader->width * sizeof(struct Pixel);
+    size_t padding = reader->stride - row_bytes;
+    struct iovec* iov = (struct iovec*)buffer_pool_alloc(count * 2 * sizeof(struct iovec));
+    if(iov == NULL){
+        perror("Failed to allocate memory for input iovecs");
+        return 0;
+    }
+    unsigned char pad[3];
+    int k = 0;
+    for(int i = 0; i < count; i++){
+        iov[k].iov_base = rows[i];
+        iov[k++].iov_len = row_bytes;
+        if(padding){
+            iov[k].iov_base = pad;
+            iov[k++].iov_len = padding;
+        }
+    }
+    int ok = read_iovecs(reader->fd, iov, k);
+    if(!ok){
+        report_read_error();
+    }
+    buffer_pool_free(iov, count * 2 * sizeof(struct iovec));
+    return ok;
+}
+
+// Function to read all remaining rows of a reader into an image, in file
+// order if flip is set
+static int read_image(struct BMP_Reader* reader, Image* img, int flip) {
+    struct Pixel** rows = (struct Pixel**)buffer_pool_alloc(reader->height * sizeof(struct Pixel*));
+    if(rows == NULL){
+        perror("Failed to allocate memory for input rows");
+        return 0;
+    }
+    for(int i = 0; i < reader->height; i++){
+        rows[i] = image_get_row(img, flip ? i : reader->height - 1 - i);
+    }
+    int ok = readRowsBMP(reader, rows, reader->height);
+    buffer_pool_free(rows, reader->height * sizeof(struct Pixel*));
+    return ok;
+}
+
+// Function to read all remaining rows of a reader into an image
+int readImageBMP(struct BMP_Reader* reader, Image* img) {
+    return read_image(reader, img, 0);
+}
+
+// Function to read all remaining rows of a reader into an image mirrored vertically
+int readFlippedImageBMP(struct BMP_Reader* reader, Image* img) {
+    return read_image(reader, img, 1);
+}
+
+// Function to skip the next rows of a reader
+int skipRowsBMP(struct BMP_Reader* reader, int count) {
+    size_t length = reader->stride * count;
+    if(lseek(reader->fd, length, SEEK_CUR) >= 0){
+        return 1;
+    }
+    if(!discard_bytes(reader->fd, length)){
+        report_read_error();
+        return 0;
+    }
+    return 1;
+}
+
+// Function to close a reader
+void closeBMPReader(struct BMP_Reader* reader) {
+    if(reader->fd >= 0) close_file(reader->fd);
+    reader->fd = -1;
+}
+
+// Function to create a BMP file for writing row by row
+int openBMPWriter(const char* filename, const struct BMP_Header* bmp_header,
+                  const struct DIB_Header* dib_header, struct BMP_Writer* writer, int flags) {
+    writer->row_bytes = (size_t)dib_header->biWidth * sizeof(struct Pixel);
+    writer->padding = ((writer->row_bytes + 3) & ~(size_t)3) - writer->row_bytes;
+    writer->fd = open_output(filename, 0);
+    if(writer->fd < 0){
+        perror("Error opening output file");
+        return 0;
+    }
+
+    if(flags & BMP_WRITE_FALLOCATE){
+        // Failure only means the file system cannot preallocate
+        posix_fallocate(writer->fd, 0, bmp_header->bfSize);
+    }
+
+    unsigned char headers[BMP_HEADER_SIZE + DIB_HEADER_SIZE];
+    serializeBMPHeader(headers, bmp_header);
+    serializeDIBHeader(headers + BMP_HEADER_SIZE, dib_header);
+    if(!write_all(writer->fd, headers, sizeof(headers))){
+        perror("Error writing output file");
+        close_file(writer->fd);
+        writer->fd = -1;
+        return 0;
+    }
+    return 1;
+}
+
+// Function to write the next rows of a writer
+int writeRowsBMP(struct BMP_Writer* writer, struct Pixel** rows, int count) {
+    struct iovec* iov = (struct iovec*)buffer_pool_alloc(count * 2 * sizeof(struct iovec));
+    if(iov == NULL){
+        perror("Failed to allocate memory for output iovecs");
+        return 0;
+    }
+    static unsigned char pad[3] = {0, 0, 0};
+    int k = 0;
+    for(int i = 0; i < count; i++){
+        iov[k].iov_base = rows[i];
+        iov[k++].iov_len = writer->row_bytes;
+        if(writer->padding){
+            iov[k].iov_base = pad;
+            iov[k++].iov_len = writer->padding;
+        }
+    }
+    int ok = write_iovecs(writer->fd, iov, k);
+    if(!ok){
+        perror("Error writing output file");
+    }
+    buffer_pool_free(iov, count * 2 * sizeof(struct iovec));
+    return ok;
+}
+
+// Function to close a writer
+int closeBMPWriter(struct BMP_Writer* writer) {
+    int ok = 1;
+    if(writer->fd >= 0 && close_file(writer->fd) != 0){
+        perror("Error closing output file");
+        ok = 0;
     }
+    writer->fd = -1;
+    return ok;
 }
@@ -39,13 +39,95 @@ struct DIB_Header {
     unsigned int biClrImportant;  // Number of important colors used
 };
 
-// Structure for a single 24-bit Pixel
-struct Pixel {
-    unsigned char blue;
-    unsigned char green;
-    unsigned char red;
+// Size of the BMP and DIB headers as stored in a file
+#define BMP_HEADER_SIZE 14
+#define DIB_HEADER_SIZE 40
+
+// biCompression of a 32-bit file whose channel masks follow the DIB header
+#define BMP_BITFIELDS 3
+
+// File name standing for standard input when reading and standard output
+// when writing, which are never closed
+#define BMP_STDIO_NAME "-"
+
+// Flags for writeImageBMP and openBMPWriter
+#define BMP_WRITE_DEFAULT   0
+#define BMP_WRITE_FALLOCATE 1 // Preallocate the whole output file with posix_fallocate
+#define BMP_WRITE_DIRECT    2 // Write with O_DIRECT, bypassing the page cache
+
+// Flags for bmp_decode_from_buffer
+#define BMP_DECODE_DEFAULT 0 // Wrap the pixels in the caller's buffer when the layout allows
+#define BMP_DECODE_COPY    1 // Always copy the pixels into an image of their own
+#define BMP_DECODE_FLIP    2 // Mirror the image vertically by taking the rows in file order
+
+// A BMP file whose contents are mapped (or read) into memory
+struct BMP_Source {
+    unsigned char* base;         // Start of the file contents
+    size_t length;               // Length of the file contents in bytes
+    const unsigned char* pixels; // Start of the pixel array (base + bfOffBits)
+    size_t stride;               // Padded size of one pixel row in the file
+    int width;
+    int height;
+    int mapped;                  // 1 if base is an mmap of the file, 0 if it was read into a pooled buffer
+    size_t capacity;             // Size of the pooled buffer base, if it was read
+    int borrowed;                // 1 if base belongs to the caller, see openBMPBuffer
+    int bits;                    // Bits per pixel: 24 or 32, or 1, 4 or 8 for an indexed file
+    const unsigned char* palette; // Color table of an indexed file, 4 bytes per color
+    int colors;                  // Number of colors in the color table
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+};
+
+// A BMP file read a few rows at a time, bottom row first, so the pixel array
+// never has to be held in memory as a whole
+struct BMP_Reader {
+    int fd;
+    size_t stride;               // Padded size of one pixel row in the file
+    int width;
+    int height;
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+};
+
+// A BMP file written a few rows at a time, bottom row first
+struct BMP_Writer {
+    int fd;
+    size_t row_bytes;            // Size of the pixels of one row
+    size_t padding;              // Bytes of padding after every row
 };
 
+/**
+ * Parse BMP header from the first 14 bytes of a BMP file.
+ *
+ * @param  buffer: Pointer to the raw header bytes
+ * @param  header: Pointer to the destination BMP header
+ */
+void parseBMPHeader(const unsigned char* buffer, struct BMP_Header* header);
+
+/**
+ * Parse DIB header from the 40 bytes following the BMP header.
+ *
+ * @param  buffer: Pointer to the raw header bytes
+ * @param  header: Pointer to the destination DIB header
+ */
+void parseDIBHeader(const unsigned char* buffer, struct DIB_Header* header);
+
+/**
+ * Serialize BMP header into the 14 bytes it occupies in a file.
+ *
+ * @param  buffer: Destination for the raw header bytes
+ * @param  header: The header to serialize
+ */
+void serializeBMPHeader(unsigned char* buffer, const struct BMP_Header* header);
+
+/**
+ * Serialize DIB header into the 40 bytes it occupies in a file.
+ *
+ * @param  buffer: Destination for the raw header bytes
+ * @param  header: The header to serialize
+ */
+void serializeDIBHeader(unsigned char* buffer, const struct DIB_Header* header);
+
 /**
  * Read BMP header of a BMP file.
  *
@@ -97,17 +179,93 @@ void makeBMPHeader(struct BMP_Header* header, int width, int height);
 void makeDIBHeader(struct DIB_Header* header, int width, int height);
 
 /**
- * Read Pixels from BMP file based on width and height.
+ * Read Pixels from BMP file based on width and height. The file is only read
+ * forward, so it may be a pipe: it must be positioned right after the
+ * headers, and the bytes up to bfOffBits are skipped.
  *
  * @param  file: A pointer to the file being read
  * @param  pArr: Pixel array to store the pixels being read
  * @param  width: Width of the pixel array of this image
  * @param  height: Height of the pixel array of this image
+ * @param  offset: Offset of the pixel array in the file (bfOffBits)
+ */
+void readPixelsBMP(FILE* file, struct Pixel** pArr, int width, int height, unsigned int offset);
+
+/**
+ * Open a 24 or 32-bit or 1, 4 or 8-bit indexed uncompressed BMP file as a
+ * source. A 32-bit file may use BI_BITFIELDS with the standard masks. Regular
+ * files are mapped with mmap so the padded pixel rows can be read in place;
+ * pipes and other files that cannot be mapped are read into a pooled buffer
+ * instead. The headers are parsed and validated, and the pixel array and
+ * color table are located.
+ *
+ * @param  filename: Name of the file to open, BMP_STDIO_NAME for standard input
+ * @param  source: Pointer to the source to fill in
+ * @return 1 on success, 0 on failure.
+ */
+int openBMPSource(const char* filename, struct BMP_Source* source);
+
+/**
+ * Open a BMP file held in memory as a source, without copying it. The
+ * headers are parsed and validated like openBMPSource does.
+ *
+ * @param  data: The contents of the file, which must outlive the source
+ * @param  length: Length of the contents in bytes
+ * @param  source: Pointer to the source to fill in
+ * @return 1 on success, 0 on failure.
  */
-void readPixelsBMP(FILE* file, struct Pixel** pArr, int width, int height);
+int openBMPBuffer(const unsigned char* data, size_t length, struct BMP_Source* source);
 
 /**
- * Write Pixels from BMP file based on width and height.
+ * Close a source opened with openBMPSource and release its memory.
+ *
+ * @param  source: Pointer to the source to close
+ */
+void closeBMPSource(struct BMP_Source* source);
+
+/**
+ * Returns a pointer to a pixel row of a 24-bit source, in place, or to the
+ * start of a row of 4-byte pixels of a 32-bit source. The rows
+ * are stored bottom-up in the file; row 0 is the top row of the image.
+ *
+ * @param  source: Pointer to the source
+ * @param  row: Row index, 0 being the top row
+ */
+const struct Pixel* getSourceRowBMP(const struct BMP_Source* source, int row);
+
+/**
+ * Copy all pixels of a 24 or 32-bit source into an image of the same size in
+ * one pass, converting them to the layout of the image (see image_load_row).
+ *
+ * @param  source: Pointer to the source
+ * @param  img: Destination image
+ */
+void copyPixelsBMP(const struct BMP_Source* source, Image* img);
+
+/**
+ * Copy the color table and the indices of an indexed source into an indexed
+ * image of the same size and number of colors (see image_create_indexed),
+ * unpacking 1 and 4-bit indices to one byte each.
+ *
+ * @param  source: Pointer to an indexed source
+ * @param  img: Destination indexed image
+ */
+void copyIndexedBMP(const struct BMP_Source* source, Image* img);
+
+/**
+ * Copy a source into an image like copyPixelsBMP or copyIndexedBMP, but with
+ * the rows in their bottom-up file order, which mirrors the image vertically
+ * at no extra cost.
+ *
+ * @param  source: Pointer to the source
+ * @param  img: Destination image, indexed for an indexed source
+ */
+void copyFlippedBMP(const struct BMP_Source* source, Image* img);
+
+/**
+ * Write Pixels from BMP file based on width and height. The rows are written
+ * sequentially, so the file may be a pipe, and must directly follow the
+ * headers.
  *
  * @param  file: A pointer to the file being read or written
  * @param  pArr: Pixel array of the image to write to the file
@@ -116,4 +274,183 @@ void readPixelsBMP(FILE* file, struct Pixel** pArr, int width, int height);
  */
 void writePixelsBMP(FILE* file, struct Pixel** pArr, int width, int height);
 
+/**
+ * Write a complete BMP file (headers and padded pixel rows) for an image. The
+ * file is written with a few writev calls that gather the headers, the image
+ * rows and their padding, or with a single write of one assembled buffer when
+ * BMP_WRITE_DIRECT is requested. Standard output may be a pipe, as the file
+ * is always written sequentially. The file has 32-bit pixels if dib_header
+ * says so and 24-bit ones otherwise; rows that need converting from the
+ * layout of the image are assembled in one buffer and written at once. An
+ * indexed image is written as an indexed file with one write, keeping the bit
+ * count of dib_header if its palette fits and the smallest one that fits
+ * otherwise; bmp_header and the flags are then not used.
+ *
+ * @param  filename: Name of the file to write, BMP_STDIO_NAME for standard output
+ * @param  bmp_header: BMP header to write
+ * @param  dib_header: DIB header to write
+ * @param  img: The image whose pixels are written
+ * @param  flags: Combination of BMP_WRITE_FALLOCATE and BMP_WRITE_DIRECT
+ * @return 1 on success, 0 on failure.
+ */
+int writeImageBMP(const char* filename, const struct BMP_Header* bmp_header,
+                  const struct DIB_Header* dib_header, Image* img, int flags);
+
+/**
+ * Decode a BMP file held in memory into an image. By default the image wraps
+ * the pixel rows in the buffer in place (see image_wrap), which any 24-bit
+ * file allows as its rows are whole pixels at a fixed stride; filters then
+ * write into the buffer. With BMP_DECODE_COPY the pixels are copied into a
+ * new aligned image and the buffer is only read. An indexed file always
+ * decodes into a new indexed image, see image_create_indexed, and a 32-bit
+ * file into a new BGRX image. BMP_DECODE_FLIP mirrors the image vertically
+ * by taking the rows in file order, which costs nothing.
+ *
+ * @param  data: The contents of the file, which must outlive a wrapping image
+ * @param  length: Length of the contents in bytes
+ * @param  bmp_header: Receives the BMP header, may be NULL
+ * @param  dib_header: Receives the DIB header, may be NULL
+ * @param  flags: BMP_DECODE_DEFAULT, or BMP_DECODE_COPY and BMP_DECODE_FLIP combined
+ * @return A pointer to a new image, NULL on failure.
+ */
+Image* bmp_decode_from_buffer(unsigned char* data, size_t length, struct BMP_Header* bmp_header,
+                              struct DIB_Header* dib_header, int flags);
+
+/**
+ * Encode an image as a complete BMP file in a pooled buffer. The headers
+ * are normalized like normalizeHeadersBMP does; missing headers, or headers
+ * for another size than the image, are replaced by new ones, 32-bit for a
+ * BGRX image and 24-bit otherwise. An indexed image is encoded as an
+ * indexed file, like writeImageBMP does.
+ *
+ * @param  img: The image to encode
+ * @param  bmp_header: BMP header to keep the fields of, may be NULL
+ * @param  dib_header: DIB header to keep the fields of, may be NULL
+ * @param  length: Receives the length of the buffer
+ * @return The buffer, to be released with bmp_buffer_free, or NULL on failure.
+ */
+unsigned char* bmp_encode_to_buffer(Image* img, const struct BMP_Header* bmp_header,
+                                    const struct DIB_Header* dib_header, size_t* length);
+
+/**
+ * Release a buffer returned by bmp_encode_to_buffer to the buffer pool, so
+ * the next encode of a similar size reuses it.
+ *
+ * @param  buffer: The buffer, may be NULL
+ * @param  length: The length returned with it
+ */
+void bmp_buffer_free(unsigned char* buffer, size_t length);
+
+/**
+ * Normalize headers for an output file, whose pixel array always follows a
+ * 40 byte DIB header directly and is never stored with bit fields.
+ *
+ * @param  bmp_header: BMP header to update
+ * @param  dib_header: DIB header to update
+ */
+void normalizeHeadersBMP(struct BMP_Header* bmp_header, struct DIB_Header* dib_header);
+
+/**
+ * Switch headers made by makeBMPHeader and makeDIBHeader, or normalized, to
+ * another bit count, updating the sizes.
+ *
+ * @param  bmp_header: BMP header to update
+ * @param  dib_header: DIB header to update
+ * @param  bits: 24 or 32
+ */
+void setBitCountBMP(struct BMP_Header* bmp_header, struct DIB_Header* dib_header, int bits);
+
+/**
+ * Open a 24-bit uncompressed BMP file for reading row by row. The headers
+ * are read and validated like openBMPSource does, and the file is left
+ * positioned at the pixel array. Pipes work too, as rows are only ever
+ * read forward and the bytes up to bfOffBits are skipped rather than sought.
+ *
+ * @param  filename: Name of the file to open, BMP_STDIO_NAME for standard input
+ * @param  reader: Pointer to the reader to fill in
+ * @return 1 on success, 0 on failure.
+ */
+int openBMPReader(const char* filename, struct BMP_Reader* reader);
+
+/**
+ * Read the next rows of a reader in file order, that is bottom-up, with
+ * one readv call per batch of rows.
+ *
+ * @param  reader: Pointer to the reader
+ * @param  rows: Destination of every row, in file order
+ * @param  count: Number of rows to read
+ * @return 1 on success, 0 on failure.
+ */
+int readRowsBMP(struct BMP_Reader* reader, struct Pixel** rows, int count);
+
+/**
+ * Read all remaining rows of a reader into an image of the same size, with
+ * no intermediate copy of the file. Useful for loading a pipe, which cannot
+ * be mapped.
+ *
+ * @param  reader: Pointer to a reader positioned at the pixel array
+ * @param  img: Destination image
+ * @return 1 on success, 0 on failure.
+ */
+int readImageBMP(struct BMP_Reader* reader, Image* img);
+
+/**
+ * Read all remaining rows of a reader into an image like readImageBMP, but
+ * in their bottom-up file order, which mirrors the image vertically.
+ *
+ * @param  reader: Pointer to a reader positioned at the pixel array
+ * @param  img: Destination image
+ * @return 1 on success, 0 on failure.
+ */
+int readFlippedImageBMP(struct BMP_Reader* reader, Image* img);
+
+/**
+ * Skip the next rows of a reader without storing them.
+ *
+ * @param  reader: Pointer to the reader
+ * @param  count: Number of rows to skip
+ * @return 1 on success, 0 on failure.
+ */
+int skipRowsBMP(struct BMP_Reader* reader, int count);
+
+/**
+ * Close a reader opened with openBMPReader.
+ *
+ * @param  reader: Pointer to the reader to close
+ */
+void closeBMPReader(struct BMP_Reader* reader);
+
+/**
+ * Create a BMP file and write its headers, for writing the rows with
+ * writeRowsBMP afterwards.
+ *
+ * @param  filename: Name of the file to write, BMP_STDIO_NAME for standard output
+ * @param  bmp_header: BMP header to write
+ * @param  dib_header: DIB header to write
+ * @param  writer: Pointer to the writer to fill in
+ * @param  flags: BMP_WRITE_FALLOCATE or BMP_WRITE_DEFAULT
+ * @return 1 on success, 0 on failure.
+ */
+int openBMPWriter(const char* filename, const struct BMP_Header* bmp_header,
+                  const struct DIB_Header* dib_header, struct BMP_Writer* writer, int flags);
+
+/**
+ * Write the next rows of a writer in file order, that is bottom-up, with
+ * their padding, gathered into writev calls.
+ *
+ * @param  writer: Pointer to the writer
+ * @param  rows: Every row to write, in file order
+ * @param  count: Number of rows to write
+ * @return 1 on success, 0 on failure.
+ */
+int writeRowsBMP(struct BMP_Writer* writer, struct Pixel** rows, int count);
+
+/**
+ * Close a writer opened with openBMPWriter.
+ *
+ * @param  writer: Pointer to the writer to close
+ * @return 1 on success, 0 if the file could not be closed.
+ */
+int closeBMPWriter(struct BMP_Writer* writer);
+
 #endif // BMPHANDLER_H
\ No newline at end of file
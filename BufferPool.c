@@ -0,0 +1,206 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// BufferPool.c
+
+#define _GNU_SOURCE
+
+#include "BufferPool.h"
+#include "Stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+// Size classes: 64 bytes, then four classes per power of two (1, 1.25, 1.5
+// and 1.75 times it), up to 2^46 bytes. Larger buffers are never retained.
+#define BUFFER_POOL_MIN_CLASS 64
+#define BUFFER_POOL_CLASSES 164
+
+// Retained buffers of one size class, linked through their first bytes
+struct PoolClass {
+    void* head;
+    int count;
+};
+
+// Header at the start of every arena block, padded to keep the data aligned
+struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;        // Size of the block including this header
+    size_t used;        // Bytes in use including this header
+    char pad[BUFFER_POOL_ALIGN - sizeof(void*) - 2 * sizeof(size_t)];
+};
+
+// The pool, shared by all threads
+static struct PoolClass classes[BUFFER_POOL_CLASSES];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t max_bytes = BUFFER_POOL_DEFAULT_MAX_BYTES;
+static int max_per_class = BUFFER_POOL_DEFAULT_PER_CLASS;
+static struct BufferPoolStats counters;
+
+// Function to get the size class of a request, BUFFER_POOL_CLASSES if it is too large
+static int class_index(size_t size) {
+    if(size <= BUFFER_POOL_MIN_CLASS) return 0;
+    // 2^e < size <= 2^(e + 1), and size is rounded up to a quarter of 2^e
+    int e = 63 - __builtin_clzll((unsigned long long)(size - 1));
+    size_t quarter = (size_t)1 << (e - 2);
+    int q = (int)((size - ((size_t)1 << e) + quarter - 1) / quarter);
+    int index = q == 4 ? 4 * (e - 5) : 4 * (e - 6) + q;
+    return index < BUFFER_POOL_CLASSES ? index : BUFFER_POOL_CLASSES;
+}
+
+// Function to get the size of a size class
+static size_t class_bytes(int index) {
+    return (size_t)(4 + index % 4) << (index / 4 + 4);
+}
+
+// Function to get the size a request is rounded up to
+size_t buffer_pool_class_size(size_t size) {
+    int index = class_index(size);
+    return index < BUFFER_POOL_CLASSES ? class_bytes(index) : size;
+}
+
+// Function to allocate a buffer of a size class, or of the exact size if it has none
+static void* allocate(size_t bytes) {
+    void* p = NULL;
+    if(posix_memalign(&p, BUFFER_POOL_ALIGN, bytes) != 0){
+        return NULL;
+    }
+    stats_add_allocation(bytes);
+    return p;
+}
+
+// Function to allocate a buffer, reusing a retained one if possible
+void* buffer_pool_alloc(size_t size) {
+    int index = class_index(size);
+    if(index < BUFFER_POOL_CLASSES){
+        pthread_mutex_lock(&pool_lock);
+        struct PoolClass* pc = &classes[index];
+        void* p = pc->head;
+        if(p != NULL){
+            pc->head = *(void**)p;
+            pc->count--;
+            counters.hits++;
+            counters.retained_bytes -= class_bytes(index);
+            counters.retained_buffers--;
+            pthread_mutex_unlock(&pool_lock);
+            return p;
+        }
+        counters.misses++;
+        pthread_mutex_unlock(&pool_lock);
+        return allocate(class_bytes(index));
+    }
+    pthread_mutex_lock(&pool_lock);
+    counters.misses++;
+    pthread_mutex_unlock(&pool_lock);
+    return allocate(size);
+}
+
+// Function to give a buffer back to the pool
+void buffer_pool_free(void* buffer, size_t size) {
+    if(buffer == NULL) return;
+    int index = class_index(size);
+    if(index < BUFFER_POOL_CLASSES){
+        size_t bytes = class_bytes(index);
+        pthread_mutex_lock(&pool_lock);
+        struct PoolClass* pc = &classes[index];
+        if(pc->count < max_per_class && counters.retained_bytes + bytes <= max_bytes){
+            *(void**)buffer = pc->head;
+            pc->head = buffer;
+            pc->count++;
+            counters.retained_bytes += bytes;
+            counters.retained_buffers++;
+            pthread_mutex_unlock(&pool_lock);
+            return;
+        }
+        counters.evictions++;
+        pthread_mutex_unlock(&pool_lock);
+    }
+    free(buffer);
+}
+
+// Function to free retained buffers until the limits hold; called with the lock held
+static void enforce_limits(void) {
+    // Larger classes go first, they free the most memory per buffer
+    for(int i = BUFFER_POOL_CLASSES - 1; i >= 0; i--){
+        struct PoolClass* pc = &classes[i];
+        while(pc->head != NULL && (pc->count > max_per_class || counters.retained_bytes > max_bytes)){
+            void* p = pc->head;
+            pc->head = *(void**)p;
+            pc->count--;
+            counters.retained_bytes -= class_bytes(i);
+            counters.retained_buffers--;
+            counters.evictions++;
+            free(p);
+        }
+    }
+}
+
+// Function to set the retention limits
+void buffer_pool_set_limits(size_t bytes, int per_class) {
+    pthread_mutex_lock(&pool_lock);
+    max_bytes = bytes;
+    max_per_class = per_class < 0 ? 0 : per_class;
+    enforce_limits();
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Function to free every retained buffer
+void buffer_pool_trim(void) {
+    pthread_mutex_lock(&pool_lock);
+    size_t bytes = max_bytes;
+    max_bytes = 0;
+    enforce_limits();
+    max_bytes = bytes;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Function to read the counters
+void buffer_pool_get_stats(struct BufferPoolStats* stats) {
+    pthread_mutex_lock(&pool_lock);
+    *stats = counters;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Function to initialize an empty arena
+void arena_init(struct Arena* arena, size_t block_size) {
+    arena->blocks = NULL;
+    arena->block_size = block_size;
+}
+
+// Function to allocate scratch memory from an arena
+void* arena_alloc(struct Arena* arena, size_t size) {
+    size = (size + BUFFER_POOL_ALIGN - 1) & ~((size_t)BUFFER_POOL_ALIGN - 1);
+    struct ArenaBlock* block = arena->blocks;
+    if(block == NULL || block->size - block->used < size){
+        size_t bytes = sizeof(struct ArenaBlock) + size;
+        if(bytes < arena->block_size) bytes = arena->block_size;
+        bytes = buffer_pool_class_size(bytes);
+        block = (struct ArenaBlock*)buffer_pool_alloc(bytes);
+        if(block == NULL){
+            perror("Failed to allocate memory for arena block");
+            return NULL;
+        }
+        block->next = arena->blocks;
+        block->size = bytes;
+        block->used = sizeof(struct ArenaBlock);
+        arena->blocks = block;
+    }
+    void* p = (unsigned char*)block + block->used;
+    block->used += size;
+    return p;
+}
+
+// Function to give all blocks of an arena back to the pool
+void arena_release(struct Arena* arena) {
+    while(arena->blocks != NULL){
+        struct ArenaBlock* block = arena->blocks;
+        arena->blocks = block->next;
+        buffer_pool_free(block, block->size);
+    }
+}
@@ -0,0 +1,105 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// BufferPool.h
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <stddef.h>
+
+// Alignment in bytes of every buffer handed out by the pool
+#define BUFFER_POOL_ALIGN 64
+
+// Default retention limits, see buffer_pool_set_limits
+#define BUFFER_POOL_DEFAULT_MAX_BYTES ((size_t)512 * 1024 * 1024)
+#define BUFFER_POOL_DEFAULT_PER_CLASS 16
+
+// Counters of the buffer pool
+struct BufferPoolStats {
+    unsigned long long hits;      // Requests served by a retained buffer
+    unsigned long long misses;    // Requests that had to allocate
+    unsigned long long evictions; // Released buffers freed instead of retained
+    size_t retained_bytes;        // Bytes held by retained buffers
+    size_t retained_buffers;      // Number of retained buffers
+};
+
+// A per-job scratch arena. Allocations are carved out of blocks drawn from
+// the buffer pool and all returned at once by arena_release.
+struct Arena {
+    struct ArenaBlock* blocks;    // Most recent block first
+    size_t block_size;            // Minimum size of a new block
+};
+
+/* Allocates a buffer aligned to BUFFER_POOL_ALIGN. The size is rounded up to
+ * a size class, four per power of two, and a buffer of that class released
+ * earlier is reused when one is retained; otherwise a new one is allocated.
+ * Safe to call from any thread.
+ *
+ * @param  size: size of the buffer in bytes.
+ * @return The buffer, NULL on failure.
+*/
+void* buffer_pool_alloc(size_t size);
+
+/* Gives a buffer back to the pool. It is retained for reuse within the
+ * limits of buffer_pool_set_limits and freed otherwise.
+ *
+ * @param  buffer: the buffer, may be NULL.
+ * @param  size: the size it was allocated with.
+*/
+void buffer_pool_free(void* buffer, size_t size);
+
+/* Returns the size a request is rounded up to.
+ *
+ * @param  size: size of the request in bytes.
+*/
+size_t buffer_pool_class_size(size_t size);
+
+/* Sets how many released buffers the pool retains. Retained buffers beyond
+ * the new limits are freed right away.
+ *
+ * @param  max_bytes: total size of the retained buffers, 0 to retain none.
+ * @param  max_per_class: number of retained buffers of any one size class.
+*/
+void buffer_pool_set_limits(size_t max_bytes, int max_per_class);
+
+/* Frees every retained buffer.
+*/
+void buffer_pool_trim(void);
+
+/* Reads the counters of the pool.
+ *
+ * @param  stats: receives the counters.
+*/
+void buffer_pool_get_stats(struct BufferPoolStats* stats);
+
+/* Initializes an empty arena.
+ *
+ * @param  arena: the arena.
+ * @param  block_size: minimum size of the blocks it draws from the pool.
+*/
+void arena_init(struct Arena* arena, size_t block_size);
+
+/* Allocates scratch memory from an arena, aligned to BUFFER_POOL_ALIGN. An
+ * arena belongs to one thread at a time.
+ *
+ * @param  arena: the arena.
+ * @param  size: size in bytes.
+ * @return The memory, NULL on failure.
+*/
+void* arena_alloc(struct Arena* arena, size_t size);
+
+/* Gives all blocks of an arena back to the pool, invalidating everything
+ * allocated from it. The arena can be used again afterwards.
+ *
+ * @param  arena: the arena.
+*/
+void arena_release(struct Arena* arena);
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,393 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Convolve.c
+
+#include "Convolve.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+// Fixed point weights
+#define WEIGHT_ONE (1 << CONVOLVE_WEIGHT_BITS)
+
+// The vertical pass keeps this many fractional bits in its intermediate row,
+// which holds up to 255 << ROW_BITS in 16 bits
+#define ROW_BITS 8
+#define VERTICAL_SHIFT (CONVOLVE_WEIGHT_BITS - ROW_BITS)
+#define HORIZONTAL_SHIFT (CONVOLVE_WEIGHT_BITS + ROW_BITS)
+
+// Names of the border handlings, indexed by enum ConvolveBorder
+static const char* border_names[CONVOLVE_BORDER_COUNT] = {"clamp", "mirror", "wrap", "zero"};
+
+// Function to look up a border handling by name
+int convolve_border_from_name(const char* name, enum ConvolveBorder* border) {
+    for(int i = 0; i < CONVOLVE_BORDER_COUNT; i++){
+        if(strcmp(name, border_names[i]) == 0){
+            *border = (enum ConvolveBorder)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to fill in the weights of a Gaussian, with the rounding error
+// given to the center so that the kernel stays symmetric
+static void gaussian_weights(struct ConvolveKernel* kernel, double sigma) {
+    int radius = kernel->radius;
+    double w[CONVOLVE_MAX_RADIUS + 1];
+    double sum = 0.0;
+    for(int t = 0; t <= radius; t++){
+        w[t] = exp(-(double)(t * t) / (2.0 * sigma * sigma));
+        sum += t == 0 ? w[t] : 2.0 * w[t];
+    }
+    int total = 0;
+    for(int t = 1; t <= radius; t++){
+        int q = (int)lround(w[t] / sum * WEIGHT_ONE);
+        kernel->weights[radius + t] = q;
+        kernel->weights[radius - t] = q;
+        total += 2 * q;
+    }
+    kernel->weights[radius] = WEIGHT_ONE - total;
+}
+
+// Function to build a Gaussian blur kernel
+int convolve_kernel_gaussian(struct ConvolveKernel* kernel, double sigma, enum ConvolveBorder border) {
+    if(!(sigma > 0.0) || sigma > CONVOLVE_MAX_RADIUS / 3.0){
+        fprintf(stderr, "Blur sigma must be greater than 0 and at most %d.\n", CONVOLVE_MAX_RADIUS / 3);
+        return 0;
+    }
+    memset(kernel, 0, sizeof(*kernel));
+    kernel->type = CONVOLVE_GAUSSIAN;
+    kernel->border = border;
+    kernel->radius = (int)ceil(3.0 * sigma);
+    gaussian_weights(kernel, sigma);
+    return 1;
+}
+
+// Function to build a box blur kernel
+int convolve_kernel_box(struct ConvolveKernel* kernel, int radius, enum ConvolveBorder border) {
+    if(radius < 1 || radius > CONVOLVE_MAX_BOX_RADIUS){
+        fprintf(stderr, "Box blur radius must be between 1 and %d.\n", CONVOLVE_MAX_BOX_RADIUS);
+        return 0;
+    }
+    memset(kernel, 0, sizeof(*kernel));
+    kernel->type = CONVOLVE_BOX;
+    kernel->border = border;
+    kernel->radius = radius;
+    return 1;
+}
+
+// Function to build a sharpening kernel
+int convolve_kernel_sharpen(struct ConvolveKernel* kernel, double amount, enum ConvolveBorder border) {
+    if(!(amount > 0.0) || amount > 16.0){
+        fprintf(stderr, "Sharpening amount must be greater than 0 and at most 16.\n");
+        return 0;
+    }
+    memset(kernel, 0, sizeof(*kernel));
+    kernel->type = CONVOLVE_SHARPEN;
+    kernel->border = border;
+    kernel->radius = 3;
+    kernel->amount = (int)lround(amount * 256.0);
+    gaussian_weights(kernel, 1.0);
+    return 1;
+}
+
+// Function to fold an index past the edges of an axis of length n back
+// into it, -1 for a black border pixel
+static int border_index(int i, int n, enum ConvolveBorder border) {
+    if(i >= 0 && i < n) return i;
+    switch(border){
+        case CONVOLVE_BORDER_CLAMP:
+            return i < 0 ? 0 : n - 1;
+        case CONVOLVE_BORDER_MIRROR: {
+            int m = i % (2 * n);
+            if(m < 0) m += 2 * n;
+            return m < n ? m : 2 * n - 1 - m;
+        }
+        case CONVOLVE_BORDER_WRAP: {
+            int m = i % n;
+            return m < 0 ? m + n : m;
+        }
+        default:
+            return -1;
+    }
+}
+
+// Function to get the source rows read by a range of output rows
+void convolve_source_rows(const struct ConvolveKernel* kernel, int height, int begin, int end, int* first, int* last) {
+    *first = begin;
+    *last = end - 1;
+    // Only the halo rows can fold onto rows outside the range
+    for(int t = 1; t <= kernel->radius; t++){
+        int above = border_index(begin - t, height, kernel->border);
+        int below = border_index(end - 1 + t, height, kernel->border);
+        if(above >= 0 && above < *first) *first = above;
+        if(above > *last) *last = above;
+        if(below >= 0 && below < *first) *first = below;
+        if(below > *last) *last = below;
+    }
+}
+
+// Context for filtering bands of output rows
+struct ConvolveBands {
+    const struct ConvolveKernel* kernel;
+    Image* src;         // Source rows first_row ..
+    int first_row;
+    int height;         // Height of the whole image
+    Image* dst;         // Output rows begin ..
+    int begin;
+    const struct PointProgram* post;
+    int planes;
+    int step;           // Bytes per pixel of a plane
+    int rows;           // Number of output rows
+    int chunks;         // Number of bands a box blur is split into
+    int failed;         // Set if a band could not allocate its rows
+};
+
+// Function to get a source row of a plane by its row in the whole image,
+// NULL for a black border row
+static const unsigned char* source_row(const struct ConvolveBands* job, int plane, int row) {
+    row = border_index(row, job->height, job->kernel->border);
+    if(row < 0) return NULL;
+    return image_get_plane_row(job->src, plane, row - job->first_row);
+}
+
+// Function to fill the halos of a padded row of 16-bit values, whose pixels
+// start radius pixels in, from the pixels of the row folded at its edges
+static void pad_row16(uint16_t* row, int width, int radius, int step, enum ConvolveBorder border) {
+    // Past -1 the loop jumps over the pixels to the right halo
+    for(int x = -radius; x < width + radius; x = x == -1 ? width : x + 1){
+        int from = border_index(x, width, border);
+        for(int c = 0; c < step; c++){
+            row[(radius + x) * step + c] = from < 0 ? 0 : row[(radius + from) * step + c];
+        }
+    }
+}
+
+// Function to fill the halos of a padded row of 32-bit sums, like pad_row16
+static void pad_row32(uint32_t* row, int width, int radius, int step, enum ConvolveBorder border) {
+    for(int x = -radius; x < width + radius; x = x == -1 ? width : x + 1){
+        int from = border_index(x, width, border);
+        for(int c = 0; c < step; c++){
+            row[(radius + x) * step + c] = from < 0 ? 0 : row[(radius + from) * step + c];
+        }
+    }
+}
+
+// Function to copy the fourth bytes of a BGRX row, which are not filtered
+static void copy_fourth_bytes(unsigned char* dst, const unsigned char* src, int width) {
+    for(int x = 0; x < width; x++) dst[4 * x + 3] = src[4 * x + 3];
+}
+
+// Function to filter a band of output rows with a weighted kernel
+static void weighted_band(void* ctx, int begin, int end) {
+    struct ConvolveBands* job = (struct ConvolveBands*)ctx;
+    const struct ConvolveKernel* kernel = job->kernel;
+    const int* w = kernel->weights + kernel->radius; // Weight of offset t is w[t]
+    int radius = kernel->radius;
+    int width = job->dst->width;
+    int step = job->step;
+    int bytes = width * step;
+    size_t acc_size = (size_t)bytes * sizeof(int32_t);
+    size_t row_size = (size_t)(width + 2 * radius) * step * sizeof(uint16_t);
+    int32_t* acc = (int32_t*)buffer_pool_alloc(acc_size);
+    uint16_t* row = (uint16_t*)buffer_pool_alloc(row_size);
+    if(acc == NULL || row == NULL){
+        perror("Failed to allocate memory for convolution rows");
+        buffer_pool_free(acc, acc_size);
+        buffer_pool_free(row, row_size);
+        job->failed = 1;
+        return;
+    }
+    uint16_t* pixels = row + radius * step;
+
+    for(int i = begin; i < end; i++){
+        int out_i = job->begin + i;
+        for(int p = 0; p < job->planes; p++){
+            // Vertical pass: symmetric pairs of source rows into the wider row
+            const unsigned char* center = source_row(job, p, out_i);
+            for(int b = 0; b < bytes; b++) acc[b] = w[0] * center[b];
+            for(int t = 1; t <= radius; t++){
+                const unsigned char* above = source_row(job, p, out_i - t);
+                const unsigned char* below = source_row(job, p, out_i + t);
+                int weight = w[t];
+                if(above != NULL && below != NULL){
+                    for(int b = 0; b < bytes; b++) acc[b] += weight * (above[b] + below[b]);
+                }
+                else if(above != NULL || below != NULL){
+                    const unsigned char* one = above != NULL ? above : below;
+                    for(int b = 0; b < bytes; b++) acc[b] += weight * one[b];
+                }
+            }
+            for(int b = 0; b < bytes; b++){
+                pixels[b] = (uint16_t)((acc[b] + (1 << (VERTICAL_SHIFT - 1))) >> VERTICAL_SHIFT);
+            }
+            pad_row16(row, width, radius, step, kernel->border);
+
+            // Horizontal pass, again in symmetric pairs, tap by tap so the
+            // inner loops run over contiguous bytes
+            for(int b = 0; b < bytes; b++) acc[b] = w[0] * pixels[b];
+            for(int t = 1; t <= radius; t++){
+                const uint16_t* left = pixels - t * step;
+                const uint16_t* right = pixels + t * step;
+                int weight = w[t];
+                for(int b = 0; b < bytes; b++) acc[b] += weight * (left[b] + right[b]);
+            }
+
+            unsigned char* out = image_get_plane_row(job->dst, p, i);
+            if(kernel->type == CONVOLVE_SHARPEN){
+                // Push every pixel away from its blur, at ROW_BITS fractional bits
+                for(int b = 0; b < bytes; b++){
+                    int blur = (acc[b] + (1 << (CONVOLVE_WEIGHT_BITS - 1))) >> CONVOLVE_WEIGHT_BITS;
+                    int pixel = center[b] << ROW_BITS;
+                    int value = (pixel + (((pixel - blur) * kernel->amount) >> 8) + (1 << (ROW_BITS - 1))) >> ROW_BITS;
+                    out[b] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+                }
+            }
+            else{
+                for(int b = 0; b < bytes; b++){
+                    out[b] = (unsigned char)((acc[b] + (1 << (HORIZONTAL_SHIFT - 1))) >> HORIZONTAL_SHIFT);
+                }
+            }
+            if(step == 4) copy_fourth_bytes(out, center, width);
+        }
+        if(job->post != NULL) image_apply_program_rows(job->dst, job->post, i, i + 1);
+    }
+    buffer_pool_free(acc, acc_size);
+    buffer_pool_free(row, row_size);
+}
+
+// Function to filter a band of output rows with a box. Column sums slide
+// down the band and row sums slide along each row, so every output pixel
+// costs two additions and two subtractions whatever the radius.
+static void box_band(void* ctx, int begin, int end) {
+    struct ConvolveBands* job = (struct ConvolveBands*)ctx;
+    int radius = job->kernel->radius;
+    int width = job->dst->width;
+    int step = job->step;
+    int bytes = width * step;
+    int taps = 2 * radius + 1;
+    // Multiplying by 2^32 / taps^2 and rounding divides by the area
+    uint64_t inverse = ((1ull << 32) + (uint64_t)taps * taps / 2) / ((uint64_t)taps * taps);
+    size_t sums_size = (size_t)job->planes * bytes * sizeof(uint32_t);
+    size_t row_size = (size_t)(width + 2 * radius) * step * sizeof(uint32_t);
+    uint32_t* sums = (uint32_t*)buffer_pool_alloc(sums_size);
+    uint32_t* row = (uint32_t*)buffer_pool_alloc(row_size);
+    if(sums == NULL || row == NULL){
+        perror("Failed to allocate memory for convolution rows");
+        buffer_pool_free(sums, sums_size);
+        buffer_pool_free(row, row_size);
+        job->failed = 1;
+        return;
+    }
+
+    for(int i = begin; i < end; i++){
+        int out_i = job->begin + i;
+        for(int p = 0; p < job->planes; p++){
+            uint32_t* column = sums + (size_t)p * bytes;
+            if(i == begin){
+                // The first row of the band sums its whole column window
+                memset(column, 0, bytes * sizeof(uint32_t));
+                for(int t = -radius; t <= radius; t++){
+                    const unsigned char* src = source_row(job, p, out_i + t);
+                    if(src != NULL) for(int b = 0; b < bytes; b++) column[b] += src[b];
+                }
+            }
+            else{
+                const unsigned char* leaving = source_row(job, p, out_i - radius - 1);
+                const unsigned char* entering = source_row(job, p, out_i + radius);
+                if(leaving != NULL) for(int b = 0; b < bytes; b++) column[b] -= leaving[b];
+                if(entering != NULL) for(int b = 0; b < bytes; b++) column[b] += entering[b];
+            }
+
+            memcpy(row + radius * step, column, bytes * sizeof(uint32_t));
+            pad_row32(row, width, radius, step, job->kernel->border);
+
+            unsigned char* out = image_get_plane_row(job->dst, p, i);
+            for(int c = 0; c < step; c++){
+                uint32_t sum = 0;
+                for(int k = 0; k < taps; k++) sum += row[k * step + c];
+                for(int x = 0; x < width; x++){
+                    out[x * step + c] = (unsigned char)((sum * inverse + (1ull << 31)) >> 32);
+                    if(x + 1 < width) sum += row[(x + taps) * step + c] - row[x * step + c];
+                }
+            }
+            if(step == 4) copy_fourth_bytes(out, source_row(job, p, out_i), width);
+        }
+        if(job->post != NULL) image_apply_program_rows(job->dst, job->post, i, i + 1);
+    }
+    buffer_pool_free(sums, sums_size);
+    buffer_pool_free(row, row_size);
+}
+
+// Function to filter one of a few large bands with a box. Every band sums
+// its first column window in full, so there is one band per thread rather
+// than the many small bands of threadpool_run_bands.
+static void box_chunk(void* ctx, int begin, int end) {
+    struct ConvolveBands* job = (struct ConvolveBands*)ctx;
+    int rows = (job->rows + job->chunks - 1) / job->chunks;
+    for(int chunk = begin; chunk < end; chunk++){
+        int first = chunk * rows;
+        int last = first + rows < job->rows ? first + rows : job->rows;
+        if(first < last) box_band(ctx, first, last);
+    }
+}
+
+// Function to filter a range of output rows
+int convolve_rows(const struct ConvolveKernel* kernel, Image* src, int first_row, int height, Image* dst,
+                  int begin, int end, const struct PointProgram* post) {
+    if(image_is_indexed(src) || image_is_indexed(dst) || src->width != dst->width ||
+       image_get_layout(src) != image_get_layout(dst)){
+        fprintf(stderr, "Convolution needs true color images of the same width and layout.\n");
+        return 0;
+    }
+    if(post != NULL && point_program_is_empty(post)) post = NULL;
+
+    enum ImageLayout layout = image_get_layout(src);
+    struct ConvolveBands job;
+    job.kernel = kernel;
+    job.src = src;
+    job.first_row = first_row;
+    job.height = height;
+    job.dst = dst;
+    job.begin = begin;
+    job.post = post;
+    job.planes = layout == IMAGE_LAYOUT_PLANAR ? 3 : 1;
+    job.step = layout == IMAGE_LAYOUT_PLANAR ? 1 : (layout == IMAGE_LAYOUT_BGRX ? 4 : (int)sizeof(struct Pixel));
+    job.rows = end - begin;
+    job.chunks = threadpool_get_threads(threadpool_get_default());
+    job.failed = 0;
+    if(kernel->type == CONVOLVE_BOX){
+        threadpool_run_items(threadpool_get_default(), job.chunks, box_chunk, &job);
+    }
+    else{
+        threadpool_run_bands(threadpool_get_default(), job.rows, weighted_band, &job);
+    }
+    return !job.failed;
+}
+
+// Function to filter a whole image
+int convolve_image(Image* img, const struct ConvolveKernel* kernel, const struct PointProgram* post) {
+    if(!image_expand_palette(img)) return 0;
+    Image* dst = image_create_layout(img->width, img->height, image_get_layout(img), img->flags);
+    if(dst == NULL){
+        return 0;
+    }
+    if(!convolve_rows(kernel, img, 0, img->height, dst, 0, img->height, post)){
+        image_destroy(&dst);
+        return 0;
+    }
+    image_take_pixels(img, &dst);
+    return 1;
+}
@@ -0,0 +1,135 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Convolve.h
+
+#ifndef CONVOLVE_H
+#define CONVOLVE_H
+
+#include "Image.h"
+#include "PointOps.h"
+
+// Fixed point kernel weights have this many fractional bits
+#define CONVOLVE_WEIGHT_BITS 14
+
+// Largest radius of a weighted kernel, which covers a Gaussian sigma of 16
+#define CONVOLVE_MAX_RADIUS 48
+
+// Largest radius of a box blur, whose cost does not depend on it
+#define CONVOLVE_MAX_BOX_RADIUS 1000
+
+// Neighborhood filters
+enum ConvolveType {
+    CONVOLVE_GAUSSIAN, // Gaussian blur with fixed point weights
+    CONVOLVE_BOX,      // Box blur with running sums, constant cost per pixel
+    CONVOLVE_SHARPEN   // Unsharp mask: the pixel pushed away from its Gaussian blur
+};
+
+// How pixels past the edges of the image are made up
+enum ConvolveBorder {
+    CONVOLVE_BORDER_CLAMP,  // Repeat the edge pixels
+    CONVOLVE_BORDER_MIRROR, // Reflect the image at its edges, edge pixels included
+    CONVOLVE_BORDER_WRAP,   // Continue with the opposite edge
+    CONVOLVE_BORDER_ZERO,   // Black
+    CONVOLVE_BORDER_COUNT
+};
+
+// A separable, symmetric kernel applied along rows and then along columns
+struct ConvolveKernel {
+    enum ConvolveType type;
+    enum ConvolveBorder border;
+    int radius;                              // The kernel covers 2 * radius + 1 pixels per axis
+    int weights[2 * CONVOLVE_MAX_RADIUS + 1]; // Fixed point weights summing to 1, unused for a box
+    int amount;                              // Sharpening strength, 256 for 1.0
+};
+
+/* Builds a Gaussian blur kernel, 3 sigma wide on each side.
+ *
+ * @param  kernel: the kernel.
+ * @param  sigma: standard deviation in pixels, greater than 0 and at most 16.
+ * @param  border: the border handling.
+ * @return 1 on success, 0 if sigma is out of range.
+*/
+int convolve_kernel_gaussian(struct ConvolveKernel* kernel, double sigma, enum ConvolveBorder border);
+
+/* Builds a box blur kernel averaging a square of 2 * radius + 1 pixels.
+ *
+ * @param  kernel: the kernel.
+ * @param  radius: 1 to CONVOLVE_MAX_BOX_RADIUS.
+ * @param  border: the border handling.
+ * @return 1 on success, 0 if the radius is out of range.
+*/
+int convolve_kernel_box(struct ConvolveKernel* kernel, int radius, enum ConvolveBorder border);
+
+/* Builds a sharpening kernel: every pixel moves away from its Gaussian blur
+ * of radius 1 sigma by amount times the difference.
+ *
+ * @param  kernel: the kernel.
+ * @param  amount: strength, greater than 0 and at most 16.
+ * @param  border: the border handling.
+ * @return 1 on success, 0 if the amount is out of range.
+*/
+int convolve_kernel_sharpen(struct ConvolveKernel* kernel, double amount, enum ConvolveBorder border);
+
+/* Looks up a border handling by name: clamp, mirror, wrap or zero.
+ *
+ * @param  name: the name.
+ * @param  border: receives the border handling.
+ * @return 1 on success, 0 if the name is unknown.
+*/
+int convolve_border_from_name(const char* name, enum ConvolveBorder* border);
+
+/* Returns the range of source rows read by a range of output rows, the rows
+ * plus a halo of radius rows on each side folded back into the image. With
+ * wrapped borders the rows at the edges read the opposite edge, so the range
+ * may span the whole image.
+ *
+ * @param  kernel: the kernel.
+ * @param  height: height of the image.
+ * @param  begin: the first output row.
+ * @param  end: one past the last output row.
+ * @param  first: receives the first source row.
+ * @param  last: receives the last source row.
+*/
+void convolve_source_rows(const struct ConvolveKernel* kernel, int height, int begin, int end, int* first, int* last);
+
+/* Filters a range of output rows into an existing image. The source image
+ * only has to hold the source rows the range reads, see
+ * convolve_source_rows, so a large image can be filtered strip by strip
+ * without copying it whole. Every output row first combines its column of
+ * source rows into a row of wider intermediate values, then filters that
+ * row horizontally, so no intermediate image is needed; a box blur keeps
+ * running sums in both directions instead. Bands of output rows run in
+ * parallel. Both images must be true color with the same width and layout;
+ * the fourth bytes of a BGRX image are copied as they are.
+ *
+ * @param  kernel: the kernel.
+ * @param  src: the source rows, row 0 holds source row first_row.
+ * @param  first_row: the source row held in row 0 of src.
+ * @param  height: height of the whole image, where the bottom border is.
+ * @param  dst: receives output rows begin .. end - 1 in its rows 0 .. end - begin - 1.
+ * @param  begin: the first output row.
+ * @param  end: one past the last output row.
+ * @param  post: point program applied to output pixels, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int convolve_rows(const struct ConvolveKernel* kernel, Image* src, int first_row, int height, Image* dst,
+                  int begin, int end, const struct PointProgram* post);
+
+/* Filters a whole image into a new buffer of the same layout. An indexed
+ * image is expanded first.
+ *
+ * @param  img: the image, replaced by the result.
+ * @param  kernel: the kernel.
+ * @param  post: point program applied to output pixels, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int convolve_image(Image* img, const struct ConvolveKernel* kernel, const struct PointProgram* post);
+
+#endif // CONVOLVE_H
@@ -0,0 +1,401 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// FilterChain.c
+
+#include "FilterChain.h"
+#include "Stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// Function to initialize an empty chain
+void filter_chain_init(FilterChain* chain) {
+    memset(chain, 0, sizeof(*chain));
+}
+
+// Function to append a stage to the chain
+static struct FilterStage* filter_chain_append(FilterChain* chain, enum FilterStageType type) {
+    if(chain->count >= FILTER_CHAIN_MAX_STAGES){
+        fprintf(stderr, "Too many filter stages (at most %d).\n", FILTER_CHAIN_MAX_STAGES);
+        return NULL;
+    }
+    struct FilterStage* stage = &chain->stages[chain->count++];
+    memset(stage, 0, sizeof(*stage));
+    stage->type = type;
+    return stage;
+}
+
+// Function to append a grayscale stage
+int filter_chain_add_grayscale(FilterChain* chain) {
+    return filter_chain_append(chain, STAGE_GRAYSCALE) != NULL;
+}
+
+// Function to append a color shift stage
+int filter_chain_add_colorshift(FilterChain* chain, int rShift, int gShift, int bShift) {
+    struct FilterStage* stage = filter_chain_append(chain, STAGE_COLORSHIFT);
+    if(stage == NULL) return 0;
+    stage->rShift = rShift;
+    stage->gShift = gShift;
+    stage->bShift = bShift;
+    return 1;
+}
+
+// Function to append a lookup table stage
+int filter_chain_add_lut(FilterChain* chain, const struct PointLUT* lut) {
+    struct FilterStage* stage = filter_chain_append(chain, STAGE_LUT);
+    if(stage == NULL) return 0;
+    stage->lut = *lut;
+    return 1;
+}
+
+// Function to append a resize stage
+int filter_chain_add_resize(FilterChain* chain, float factor) {
+    return filter_chain_add_resample(chain, factor, RESAMPLE_NEAREST);
+}
+
+// Function to append a resize stage with a resampling filter
+int filter_chain_add_resample(FilterChain* chain, float factor, enum ResampleFilter filter) {
+    if(factor <= 0){
+        fprintf(stderr, "Scaling factor must be greater than 0.\n");
+        return 0;
+    }
+    struct FilterStage* stage = filter_chain_append(chain, STAGE_RESIZE);
+    if(stage == NULL) return 0;
+    stage->factor = factor;
+    stage->filter = filter;
+    return 1;
+}
+
+// Function to append a geometric transform stage
+int filter_chain_add_geometry(FilterChain* chain, enum GeometryOp op) {
+    struct FilterStage* stage = filter_chain_append(chain, STAGE_GEOMETRY);
+    if(stage == NULL) return 0;
+    orientation_identity(&stage->orientation);
+    orientation_compose(&stage->orientation, op);
+    return 1;
+}
+
+// Function to append a convolution stage
+int filter_chain_add_convolve(FilterChain* chain, const struct ConvolveKernel* kernel) {
+    struct FilterStage* stage = filter_chain_append(chain, STAGE_CONVOLVE);
+    if(stage == NULL) return 0;
+    stage->kernel = *kernel;
+    return 1;
+}
+
+// Function to append an automatic adjustment stage
+int filter_chain_add_adjust(FilterChain* chain, enum HistogramAdjust adjust) {
+    struct FilterStage* stage = filter_chain_append(chain, STAGE_ADJUST);
+    if(stage == NULL) return 0;
+    stage->adjust = adjust;
+    return 1;
+}
+
+// Function to tell whether the chain has a resize stage
+int filter_chain_has_resize(const FilterChain* chain) {
+    for(int s = 0; s < chain->count; s++){
+        if(chain->stages[s].type == STAGE_RESIZE) return 1;
+    }
+    return 0;
+}
+
+// Function to tell whether a stage works on every pixel on its own
+int filter_chain_is_point_stage(const struct FilterStage* stage) {
+    return stage->type == STAGE_GRAYSCALE || stage->type == STAGE_COLORSHIFT || stage->type == STAGE_LUT;
+}
+
+// Function to add a point stage to a point program
+static int add_point_stage(struct PointProgram* prog, const struct FilterStage* stage) {
+    if(stage->type == STAGE_GRAYSCALE){
+        if(!point_program_add_luma(prog)){
+            fprintf(stderr, "Too many grayscale stages in filter chain.\n");
+            return 0;
+        }
+    }
+    else if(stage->type == STAGE_COLORSHIFT){
+        struct PointLUT lut;
+        point_lut_identity(&lut);
+        point_lut_shift(&lut, stage->rShift, stage->gShift, stage->bShift);
+        point_program_add_lut(prog, &lut);
+    }
+    else if(stage->type == STAGE_LUT){
+        point_program_add_lut(prog, &stage->lut);
+    }
+    return 1;
+}
+
+// Function to run the pending nearest neighbor resize and the pending
+// orientation, or only the pending point program if there are neither, and
+// reset all three. The point program is fused into the first pass.
+static int flush_pending(Image* img, struct ResizeAxis* x, struct ResizeAxis* y, struct PointProgram* prog,
+                         struct Orientation* o) {
+    int ok = 1;
+    unsigned long long start = stats_now();
+    if(x->map != NULL || y->map != NULL){
+        // Gather and filter in one pass
+        ok = resize_nearest(img, x, y, prog);
+        point_program_init(prog);
+        stats_add_time(STATS_RESIZE, start);
+        start = stats_now();
+    }
+    if(ok && !orientation_is_identity(o)){
+        // Move and filter in one pass
+        ok = geometry_apply(img, o, prog);
+        stats_add_time(STATS_RESIZE, start);
+    }
+    else if(ok && !point_program_is_empty(prog)){
+        // In parallel row bands, or on the palette of an indexed image
+        image_apply_program(img, prog);
+        stats_add_time(STATS_FILTER, start);
+    }
+    resize_axis_free(x);
+    resize_axis_free(y);
+    resize_axis_init(x, img->width);
+    resize_axis_init(y, img->height);
+    point_program_init(prog);
+    orientation_identity(o);
+    return ok;
+}
+
+// Function to apply the chain
+int filter_chain_apply(FilterChain* chain, Image* img) {
+    // Point stages, nearest neighbor resizes and an orientation not applied
+    // yet. Point stages commute with both, so they all fold into one pass.
+    struct PointProgram prog;
+    struct ResizeAxis x, y;
+    struct Orientation o;
+    point_program_init(&prog);
+    resize_axis_init(&x, img->width);
+    resize_axis_init(&y, img->height);
+    orientation_identity(&o);
+
+    int ok = 1;
+    for(int s = 0; ok && s < chain->count; s++){
+        const struct FilterStage* stage = &chain->stages[s];
+        if(stage->type == STAGE_GEOMETRY){
+            orientation_then(&o, &stage->orientation);
+        }
+        else if(stage->type == STAGE_CONVOLVE){
+            // Every output pixel reads many source pixels, so everything
+            // pending runs first and the point stages up to the next stage of
+            // another kind run on its output rows
+            ok = flush_pending(img, &x, &y, &prog, &o);
+            if(!ok) break;
+            struct PointProgram post;
+            point_program_init(&post);
+            while(ok && s + 1 < chain->count && filter_chain_is_point_stage(&chain->stages[s + 1])){
+                ok = add_point_stage(&post, &chain->stages[++s]);
+            }
+            if(!ok) break;
+            unsigned long long start = stats_now();
+            ok = convolve_image(img, &stage->kernel, &post);
+            stats_add_time(STATS_FILTER, start);
+        }
+        else if(stage->type == STAGE_ADJUST){
+            // The tables depend on every pixel as it is at this point, so
+            // everything pending runs first; the tables then wait like any
+            // other point stage
+            ok = flush_pending(img, &x, &y, &prog, &o);
+            if(!ok) break;
+            unsigned long long start = stats_now();
+            struct Histogram hist;
+            struct PointLUT lut;
+            ok = histogram_compute(img, &hist);
+            stats_add_time(STATS_FILTER, start);
+            if(!ok) break;
+            histogram_adjust_lut(&hist, stage->adjust, &lut);
+            point_program_add_lut(&prog, &lut);
+        }
+        else if(stage->type != STAGE_RESIZE){
+            ok = add_point_stage(&prog, stage);
+        }
+        else if(stage->filter == RESAMPLE_NEAREST){
+            // Both axes scale by the same factor, so a resize commutes with a
+            // transpose but not with a mirror, whose rounding differs
+            if(o.flip_x || o.flip_y){
+                ok = flush_pending(img, &x, &y, &prog, &o);
+                if(!ok) break;
+            }
+            ok = resize_axis_scale(&x, stage->factor) && resize_axis_scale(&y, stage->factor);
+        }
+        else{
+            // A filtered resize does not commute with point stages, so pending
+            // resizes and orientations go first, then pending point stages run
+            // on its source rows and the point stages up to the next resize on
+            // its output rows
+            if(x.map != NULL || y.map != NULL || !orientation_is_identity(&o)){
+                ok = flush_pending(img, &x, &y, &prog, &o);
+                if(!ok) break;
+            }
+            struct PointProgram post;
+            point_program_init(&post);
+            while(ok && s + 1 < chain->count && filter_chain_is_point_stage(&chain->stages[s + 1])){
+                ok = add_point_stage(&post, &chain->stages[++s]);
+            }
+            if(!ok) break;
+            if(image_is_indexed(img)){
+                // Filtering blends colors, so indices are looked up first; the
+                // pending point stages are cheaper on the palette
+                image_apply_program(img, &prog);
+                point_program_init(&prog);
+                ok = image_expand_palette(img);
+                if(!ok) break;
+            }
+            int new_width = (int)(img->width * stage->factor);
+            int new_height = (int)(img->height * stage->factor);
+            if(new_width == 0) new_width = 1;
+            if(new_height == 0) new_height = 1;
+            unsigned long long start = stats_now();
+            ok = resample_image(img, new_width, new_height, stage->filter, &prog, &post);
+            stats_add_time(STATS_RESIZE, start);
+            resize_axis_init(&x, img->width);
+            resize_axis_init(&y, img->height);
+            point_program_init(&prog);
+        }
+    }
+    if(!ok){
+        resize_axis_free(&x);
+        resize_axis_free(&y);
+        return 0;
+    }
+    return flush_pending(img, &x, &y, &prog, &o);
+}
+
+// Function to reduce a chain to a plan
+int filter_chain_plan(const FilterChain* chain, int width, int height, struct FilterChainPlan* plan) {
+    point_program_init(&plan->pre);
+    point_program_init(&plan->post);
+    resize_axis_init(&plan->x, width);
+    resize_axis_init(&plan->y, height);
+    plan->filter = RESAMPLE_NEAREST;
+    plan->resized = 0;
+    plan->convolved = 0;
+    plan->width = width;
+    plan->height = height;
+
+    int filtered = 0;
+    int ok = 1;
+    for(int s = 0; ok && s < chain->count; s++){
+        const struct FilterStage* stage = &chain->stages[s];
+        if(stage->type == STAGE_GEOMETRY){
+            fprintf(stderr, "Geometric transforms cannot be applied strip by strip.\n");
+            ok = 0;
+        }
+        else if(stage->type == STAGE_CONVOLVE){
+            if(plan->resized || plan->convolved){
+                fprintf(stderr, "A convolution cannot be combined with resizes or other convolutions here.\n");
+                ok = 0;
+            }
+            else if(stage->kernel.border == CONVOLVE_BORDER_WRAP){
+                // The first and last strips would read the opposite edge
+                fprintf(stderr, "Wrapped borders cannot be applied strip by strip.\n");
+                ok = 0;
+            }
+            plan->convolved = 1;
+            plan->kernel = stage->kernel;
+        }
+        else if(stage->type == STAGE_ADJUST){
+            fprintf(stderr, "Automatic adjustments after other filters cannot be applied strip by strip.\n");
+            ok = 0;
+        }
+        else if(stage->type != STAGE_RESIZE){
+            ok = add_point_stage(filtered || plan->convolved ? &plan->post : &plan->pre, stage);
+        }
+        else if(plan->convolved){
+            fprintf(stderr, "A convolution cannot be combined with resizes or other convolutions here.\n");
+            ok = 0;
+        }
+        else if(filtered || (plan->resized && stage->filter != RESAMPLE_NEAREST)){
+            fprintf(stderr, "A filtered resize cannot be combined with other resizes here.\n");
+            ok = 0;
+        }
+        else if(stage->filter == RESAMPLE_NEAREST){
+            ok = resize_axis_scale(&plan->x, stage->factor) && resize_axis_scale(&plan->y, stage->factor);
+            plan->width = plan->x.length;
+            plan->height = plan->y.length;
+            plan->resized = 1;
+        }
+        else{
+            filtered = 1;
+            plan->filter = stage->filter;
+            plan->width = (int)(width * stage->factor);
+            plan->height = (int)(height * stage->factor);
+            if(plan->width == 0) plan->width = 1;
+            if(plan->height == 0) plan->height = 1;
+            plan->resized = 1;
+        }
+    }
+    if(!ok){
+        filter_chain_plan_free(plan);
+    }
+    return ok;
+}
+
+// Function to split a vertical flip off the front of a chain
+int filter_chain_split_flip(const FilterChain* chain, FilterChain* rest) {
+    struct Orientation o;
+    orientation_identity(&o);
+    int first = 0; // First stage not moved past by the flip
+    int convolved = 0;
+    while(first < chain->count && chain->stages[first].type != STAGE_RESIZE){
+        const struct FilterStage* stage = &chain->stages[first];
+        if(stage->type == STAGE_CONVOLVE) convolved = 1;
+        if(stage->type == STAGE_GEOMETRY){
+            // Kernels are symmetric, so mirrors commute with convolutions; a
+            // transpose does not, as the passes round in a fixed order
+            if(convolved && stage->orientation.transpose) return 0;
+            orientation_then(&o, &stage->orientation);
+        }
+        first++;
+    }
+    if(o.transpose || !o.flip_y) return 0;
+
+    // Loading flipped applies the row mirror first; any column mirror left
+    // takes the place of the geometric stages, right before the first resize
+    filter_chain_init(rest);
+    for(int s = 0; s < first; s++){
+        if(chain->stages[s].type != STAGE_GEOMETRY) rest->stages[rest->count++] = chain->stages[s];
+    }
+    if(o.flip_x){
+        struct FilterStage* stage = &rest->stages[rest->count++];
+        memset(stage, 0, sizeof(*stage));
+        stage->type = STAGE_GEOMETRY;
+        stage->orientation.flip_x = 1;
+    }
+    for(int s = first; s < chain->count; s++){
+        rest->stages[rest->count++] = chain->stages[s];
+    }
+    return 1;
+}
+
+// Function to find an adjustment that sees the image as loaded
+int filter_chain_leading_adjust(const FilterChain* chain) {
+    for(int s = 0; s < chain->count; s++){
+        if(chain->stages[s].type == STAGE_ADJUST) return s;
+        if(chain->stages[s].type != STAGE_GEOMETRY) return -1;
+    }
+    return -1;
+}
+
+// Function to replace the leading adjustment by its lookup table
+void filter_chain_resolve_adjust(const FilterChain* chain, const struct Histogram* hist, FilterChain* resolved) {
+    if(resolved != chain) *resolved = *chain;
+    int s = filter_chain_leading_adjust(chain);
+    if(s < 0) return;
+    struct FilterStage* stage = &resolved->stages[s];
+    histogram_adjust_lut(hist, stage->adjust, &stage->lut);
+    stage->type = STAGE_LUT;
+}
+
+// Function to release the tables of a plan
+void filter_chain_plan_free(struct FilterChainPlan* plan) {
+    resize_axis_free(&plan->x);
+    resize_axis_free(&plan->y);
+}
@@ -0,0 +1,240 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// FilterChain.h
+
+#ifndef FILTERCHAIN_H
+#define FILTERCHAIN_H
+
+#include "Image.h"
+#include "PointOps.h"
+#include "Resample.h"
+#include "Resize.h"
+#include "Geometry.h"
+#include "Convolve.h"
+#include "Histogram.h"
+
+// Maximum number of stages in a filter chain
+#define FILTER_CHAIN_MAX_STAGES 16
+
+// Kinds of filter stages
+enum FilterStageType {
+    STAGE_GRAYSCALE,  // Per-pixel grayscale conversion
+    STAGE_COLORSHIFT, // Per-pixel color shift
+    STAGE_LUT,        // Per-channel lookup tables (gamma, levels, invert, ...)
+    STAGE_RESIZE,     // Resize, nearest neighbor or a resampling filter
+    STAGE_GEOMETRY,   // Rotation, flip or transpose
+    STAGE_CONVOLVE,   // Blur or sharpen
+    STAGE_ADJUST      // Lookup tables derived from the histogram of the image
+};
+
+// A single stage of a filter chain
+struct FilterStage {
+    enum FilterStageType type;
+    int rShift;   // Used by STAGE_COLORSHIFT
+    int gShift;
+    int bShift;
+    float factor; // Used by STAGE_RESIZE
+    enum ResampleFilter filter;
+    struct PointLUT lut; // Used by STAGE_LUT
+    struct Orientation orientation; // Used by STAGE_GEOMETRY
+    struct ConvolveKernel kernel;   // Used by STAGE_CONVOLVE
+    enum HistogramAdjust adjust;    // Used by STAGE_ADJUST
+};
+
+// Filter chain ADT
+typedef struct FilterChain FilterChain;
+
+// Filter chain structure, an ordered list of stages
+struct FilterChain {
+    struct FilterStage stages[FILTER_CHAIN_MAX_STAGES];
+    int count;
+};
+
+// A filter chain reduced to point stages around a single resize or
+// convolution, the form the chain takes when it is applied strip by strip
+struct FilterChainPlan {
+    struct PointProgram pre;    // Point stages before the resize or convolution, or all point stages
+    struct PointProgram post;   // Point stages after a filtered resize or a convolution
+    struct ResizeAxis x;        // Composed nearest neighbor resizes
+    struct ResizeAxis y;
+    enum ResampleFilter filter; // RESAMPLE_NEAREST, or the filter of the only resize
+    int resized;                // 1 if the chain has a resize stage
+    int convolved;              // 1 if the chain has a convolution stage, then it has no resize
+    struct ConvolveKernel kernel;
+    int width;                  // Size of the result
+    int height;
+};
+
+/* Initializes an empty filter chain.
+ *
+ * @param  chain: the chain to initialize.
+*/
+void filter_chain_init(FilterChain* chain);
+
+/* Appends a grayscale stage to the chain.
+ *
+ * @param  chain: the chain.
+ * @return 1 on success, 0 if the chain is full.
+*/
+int filter_chain_add_grayscale(FilterChain* chain);
+
+/* Appends a color shift stage to the chain.
+ *
+ * @param  chain: the chain.
+ * @param  rShift: the shift value of color r shift
+ * @param  gShift: the shift value of color g shift
+ * @param  bShift: the shift value of color b shift
+ * @return 1 on success, 0 if the chain is full.
+*/
+int filter_chain_add_colorshift(FilterChain* chain, int rShift, int gShift, int bShift);
+
+/* Appends a lookup table stage to the chain.
+ *
+ * @param  chain: the chain.
+ * @param  lut: the lookup tables, copied into the stage.
+ * @return 1 on success, 0 if the chain is full.
+*/
+int filter_chain_add_lut(FilterChain* chain, const struct PointLUT* lut);
+
+/* Appends a nearest neighbor resize stage to the chain.
+ *
+ * @param  chain: the chain.
+ * @param  factor: the scaling factor
+ * @return 1 on success, 0 if the chain is full or the factor is invalid.
+*/
+int filter_chain_add_resize(FilterChain* chain, float factor);
+
+/* Appends a resize stage with a resampling filter to the chain. With
+ * RESAMPLE_NEAREST this is the same as filter_chain_add_resize.
+ *
+ * @param  chain: the chain.
+ * @param  factor: the scaling factor
+ * @param  filter: the resampling filter.
+ * @return 1 on success, 0 if the chain is full or the factor is invalid.
+*/
+int filter_chain_add_resample(FilterChain* chain, float factor, enum ResampleFilter filter);
+
+/* Appends a geometric transform stage to the chain.
+ *
+ * @param  chain: the chain.
+ * @param  op: the transform.
+ * @return 1 on success, 0 if the chain is full.
+*/
+int filter_chain_add_geometry(FilterChain* chain, enum GeometryOp op);
+
+/* Appends a convolution stage to the chain.
+ *
+ * @param  chain: the chain.
+ * @param  kernel: the kernel, copied into the stage.
+ * @return 1 on success, 0 if the chain is full.
+*/
+int filter_chain_add_convolve(FilterChain* chain, const struct ConvolveKernel* kernel);
+
+/* Appends an automatic adjustment stage to the chain: auto-levels,
+ * equalization or white balance, derived from the histogram of the image
+ * as it is when the stage is reached.
+ *
+ * @param  chain: the chain.
+ * @param  adjust: the adjustment.
+ * @return 1 on success, 0 if the chain is full.
+*/
+int filter_chain_add_adjust(FilterChain* chain, enum HistogramAdjust adjust);
+
+/* Tells whether a stage is a point stage, one that maps every pixel on its
+ * own: grayscale, color shift or lookup table. Point stages fuse into one
+ * point program and may be moved by the planner.
+ *
+ * @param  stage: the stage.
+ * @return 1 for a point stage, 0 otherwise.
+*/
+int filter_chain_is_point_stage(const struct FilterStage* stage);
+
+/* Tells whether the chain has a resize stage.
+ *
+ * @param  chain: the chain.
+ * @return 1 if the chain resizes, 0 otherwise.
+*/
+int filter_chain_has_resize(const FilterChain* chain);
+
+/* Applies all stages of the chain to an image in as few passes as possible.
+ * Point stages are compiled into point programs, where consecutive shifts
+ * and lookup tables fold into a single table, and consecutive nearest
+ * neighbor resizes into one gather. A filtered resize runs the point stages
+ * before it on its source rows and the ones after it on its output rows.
+ * On an indexed image point stages only rewrite the palette and nearest
+ * neighbor resizes move indices; a filtered resize converts it to true
+ * color. Geometric stages compose into one orientation, which is applied
+ * after the pending resize with the pending point stages fused into it. A
+ * convolution runs after everything pending, with the point stages that
+ * follow it fused into its output rows. An adjustment runs everything
+ * pending, takes the histogram of the result and becomes a lookup table
+ * stage. The result is identical to applying the stages one after another.
+ *
+ * @param  chain: the chain.
+ * @param  img: the image, replaced by the result.
+ * @return 1 on success, 0 on failure.
+*/
+int filter_chain_apply(FilterChain* chain, Image* img);
+
+/* Reduces a chain to a plan for an image of a given size. Point stages
+ * commute with nearest neighbor resizes, so any number of those reduce to
+ * one; a filtered resize must be the only resize of the chain, and a
+ * convolution the only convolution of a chain without resizes. Geometric
+ * stages and adjustments need the whole image and cannot be planned; see
+ * filter_chain_resolve_adjust for a leading adjustment.
+ *
+ * @param  chain: the chain.
+ * @param  width: width of the image the chain is applied to.
+ * @param  height: height of the image the chain is applied to.
+ * @param  plan: receives the plan.
+ * @return 1 on success, 0 if the chain cannot be reduced.
+*/
+int filter_chain_plan(const FilterChain* chain, int width, int height, struct FilterChainPlan* plan);
+
+/* Splits a vertical flip off the front of a chain, so that the caller can
+ * absorb it by loading the rows of a BMP file in their bottom-up file order.
+ * Geometric stages before the first resize commute with the point stages
+ * around them, and mirrors with convolutions, whose kernels and borders are
+ * symmetric; they compose into one orientation; if it mirrors the rows
+ * without transposing, rest receives the chain without that mirror.
+ *
+ * @param  chain: the chain.
+ * @param  rest: receives the remaining chain, if a flip was split off.
+ * @return 1 if the image must be loaded flipped and rest applied, 0 if
+ *         chain must be applied as is.
+*/
+int filter_chain_split_flip(const FilterChain* chain, FilterChain* rest);
+
+/* Finds an adjustment that sees the image as it is loaded: the first stage
+ * of the chain that is not geometric, whose histogram does not depend on
+ * where the pixels are. Its histogram can be taken while the image is read.
+ *
+ * @param  chain: the chain.
+ * @return the index of the stage, or -1 if there is none.
+*/
+int filter_chain_leading_adjust(const FilterChain* chain);
+
+/* Replaces the leading adjustment of a chain, see
+ * filter_chain_leading_adjust, by the lookup table stage the histogram of
+ * the loaded image gives.
+ *
+ * @param  chain: the chain.
+ * @param  hist: histogram of the image the chain is applied to.
+ * @param  resolved: receives the chain with the stage replaced, may be chain itself.
+*/
+void filter_chain_resolve_adjust(const FilterChain* chain, const struct Histogram* hist, FilterChain* resolved);
+
+/* Releases the tables of a plan.
+ *
+ * @param  plan: the plan.
+*/
+void filter_chain_plan_free(struct FilterChainPlan* plan);
+
+#endif // FILTERCHAIN_H
@@ -0,0 +1,297 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Geometry.c
+
+#include "Geometry.h"
+#include "ThreadPool.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+// Size in bytes of the chunks rows are swapped in
+#define GEOMETRY_SWAP_BYTES 1024
+
+// Names of the transforms, indexed by enum GeometryOp
+static const char* op_names[GEOMETRY_OP_COUNT] = {
+    "rotate90", "rotate180", "rotate270", "fliph", "flipv", "transpose"
+};
+
+// Every transform as an orientation, indexed by enum GeometryOp
+static const struct Orientation op_orientations[GEOMETRY_OP_COUNT] = {
+    {1, 1, 0}, // out(i, j) = src(height - 1 - j, i)
+    {0, 1, 1},
+    {1, 0, 1}, // out(i, j) = src(j, width - 1 - i)
+    {0, 1, 0},
+    {0, 0, 1},
+    {1, 0, 0}
+};
+
+// Function to initialize an orientation to the identity
+void orientation_identity(struct Orientation* o) {
+    o->transpose = 0;
+    o->flip_x = 0;
+    o->flip_y = 0;
+}
+
+// Function to compose an orientation onto another one. A transpose after a
+// mirror turns a column mirror into a row mirror and the other way around.
+void orientation_then(struct Orientation* o, const struct Orientation* next) {
+    int flip_x = next->transpose ? o->flip_y : o->flip_x;
+    int flip_y = next->transpose ? o->flip_x : o->flip_y;
+    o->transpose ^= next->transpose;
+    o->flip_x = flip_x ^ next->flip_x;
+    o->flip_y = flip_y ^ next->flip_y;
+}
+
+// Function to compose a transform onto an orientation
+void orientation_compose(struct Orientation* o, enum GeometryOp op) {
+    orientation_then(o, &op_orientations[op]);
+}
+
+// Function to check whether an orientation is the identity
+int orientation_is_identity(const struct Orientation* o) {
+    return !o->transpose && !o->flip_x && !o->flip_y;
+}
+
+// Function to look up a transform by name
+int geometry_from_name(const char* name, enum GeometryOp* op) {
+    for(int i = 0; i < GEOMETRY_OP_COUNT; i++){
+        if(strcmp(name, op_names[i]) == 0){
+            *op = (enum GeometryOp)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to get the number of planes and the size of a pixel of a plane
+static void pixel_format(Image* img, int* planes, int* bytes) {
+    enum ImageLayout layout = image_get_layout(img);
+    *planes = layout == IMAGE_LAYOUT_PLANAR ? 3 : 1;
+    if(image_is_indexed(img) || layout == IMAGE_LAYOUT_PLANAR) *bytes = 1;
+    else *bytes = layout == IMAGE_LAYOUT_BGRX ? 4 : (int)sizeof(struct Pixel);
+}
+
+// Function to reverse the pixels of a row in place
+static void reverse_row(unsigned char* row, int width, int bytes) {
+    int i = 0, j = width - 1;
+    switch(bytes){
+        case 1:
+            for(; i < j; i++, j--){
+                unsigned char t = row[i];
+                row[i] = row[j];
+                row[j] = t;
+            }
+            break;
+        case 4: {
+            uint32_t* p = (uint32_t*)row;
+            for(; i < j; i++, j--){
+                uint32_t t = p[i];
+                p[i] = p[j];
+                p[j] = t;
+            }
+            break;
+        }
+        default: {
+            struct Pixel* p = (struct Pixel*)row;
+            for(; i < j; i++, j--){
+                struct Pixel t = p[i];
+                p[i] = p[j];
+                p[j] = t;
+            }
+            break;
+        }
+    }
+}
+
+// Function to swap two rows, reversing both when reverse is set
+static void swap_rows(unsigned char* a, unsigned char* b, int width, int bytes, int reverse) {
+    if(!reverse){
+        // Chunk by chunk through a small buffer that stays in L1
+        unsigned char t[GEOMETRY_SWAP_BYTES];
+        size_t length = (size_t)width * bytes;
+        for(size_t k = 0; k < length; k += GEOMETRY_SWAP_BYTES){
+            size_t n = length - k < GEOMETRY_SWAP_BYTES ? length - k : GEOMETRY_SWAP_BYTES;
+            memcpy(t, a + k, n);
+            memcpy(a + k, b + k, n);
+            memcpy(b + k, t, n);
+        }
+        return;
+    }
+    switch(bytes){
+        case 1:
+            for(int j = 0; j < width; j++){
+                unsigned char t = a[j];
+                a[j] = b[width - 1 - j];
+                b[width - 1 - j] = t;
+            }
+            break;
+        case 4: {
+            uint32_t* p = (uint32_t*)a;
+            uint32_t* q = (uint32_t*)b;
+            for(int j = 0; j < width; j++){
+                uint32_t t = p[j];
+                p[j] = q[width - 1 - j];
+                q[width - 1 - j] = t;
+            }
+            break;
+        }
+        default: {
+            struct Pixel* p = (struct Pixel*)a;
+            struct Pixel* q = (struct Pixel*)b;
+            for(int j = 0; j < width; j++){
+                struct Pixel t = p[j];
+                p[j] = q[width - 1 - j];
+                q[width - 1 - j] = t;
+            }
+            break;
+        }
+    }
+}
+
+// Context for the in-place orientations on bands of row pairs
+struct MirrorBands {
+    Image* img;
+    const struct Orientation* o;
+    const struct PointProgram* prog; // NULL if there is nothing to apply
+    int planes;
+    int bytes;
+};
+
+// Function to mirror a band of row pairs in place. Pair k is row k and row
+// height - 1 - k, so each pair is touched by one thread only.
+static void mirror_band(void* ctx, int begin, int end) {
+    struct MirrorBands* job = (struct MirrorBands*)ctx;
+    Image* img = job->img;
+    int width = img->width;
+    for(int k = begin; k < end; k++){
+        int other = img->height - 1 - k;
+        for(int p = 0; p < job->planes; p++){
+            unsigned char* top = image_get_plane_row(img, p, k);
+            unsigned char* bottom = image_get_plane_row(img, p, other);
+            if(job->o->flip_y && other != k){
+                swap_rows(top, bottom, width, job->bytes, job->o->flip_x);
+            }
+            else if(job->o->flip_x){
+                reverse_row(top, width, job->bytes);
+                if(other != k) reverse_row(bottom, width, job->bytes);
+            }
+        }
+        // The point program runs while both rows are still in cache
+        if(job->prog != NULL){
+            image_apply_program_rows(img, job->prog, k, k + 1);
+            if(other != k) image_apply_program_rows(img, job->prog, other, other + 1);
+        }
+    }
+}
+
+// Context for a transposing orientation on bands of tile rows
+struct TransposeBands {
+    Image* src;
+    Image* dst;
+    const struct Orientation* o;
+    const struct PointProgram* prog; // NULL if there is nothing to apply
+    int planes;
+    int bytes;
+    int tile;                        // Side of a tile in pixels
+};
+
+// Function to get the side of a square tile in pixels, so that the source
+// and destination of a tile take about 8 KB together
+static int tile_size(int bytes) {
+    return bytes == 1 ? 64 : 32;
+}
+
+// Function to fill the output tiles of a band of tile rows. Output pixel
+// (i, j) reads source pixel (r, c) with r = j and c = i before the mirrors.
+static void transpose_band(void* ctx, int begin, int end) {
+    struct TransposeBands* job = (struct TransposeBands*)ctx;
+    Image* src = job->src;
+    Image* dst = job->dst;
+    int tile = job->tile;
+    int bytes = job->bytes;
+    ptrdiff_t stride = image_get_stride(src);
+    for(int band = begin; band < end; band++){
+        int i0 = band * tile;
+        int i1 = i0 + tile < dst->height ? i0 + tile : dst->height;
+        for(int j0 = 0; j0 < dst->width; j0 += tile){
+            int j1 = j0 + tile < dst->width ? j0 + tile : dst->width;
+            // Source rows of this tile run forward or backward from row r0
+            int r0 = job->o->flip_x ? src->height - 1 - j0 : j0;
+            ptrdiff_t step = job->o->flip_x ? -stride : stride;
+            for(int p = 0; p < job->planes; p++){
+                const unsigned char* plane = image_get_plane_row(src, p, r0);
+                for(int i = i0; i < i1; i++){
+                    int c = job->o->flip_y ? src->width - 1 - i : i;
+                    const unsigned char* s = plane + (ptrdiff_t)c * bytes;
+                    unsigned char* d = image_get_plane_row(dst, p, i) + (size_t)j0 * bytes;
+                    int n = j1 - j0;
+                    switch(bytes){
+                        case 1:
+                            for(int j = 0; j < n; j++, s += step) d[j] = *s;
+                            break;
+                        case 4:
+                            for(int j = 0; j < n; j++, s += step) ((uint32_t*)d)[j] = *(const uint32_t*)s;
+                            break;
+                        default:
+                            for(int j = 0; j < n; j++, s += step) ((struct Pixel*)d)[j] = *(const struct Pixel*)s;
+                            break;
+                    }
+                }
+            }
+        }
+        if(job->prog != NULL){
+            image_apply_program_rows(dst, job->prog, i0, i1);
+        }
+    }
+}
+
+// Function to apply an orientation and a point program
+int geometry_apply(Image* img, const struct Orientation* o, const struct PointProgram* prog) {
+    if(prog != NULL && point_program_is_empty(prog)) prog = NULL;
+    if(orientation_is_identity(o)){
+        if(prog != NULL) image_apply_program(img, prog);
+        return 1;
+    }
+
+    int planes, bytes;
+    pixel_format(img, &planes, &bytes);
+    // The colors of an indexed image are in its palette
+    const struct PointProgram* pixel_prog = image_is_indexed(img) ? NULL : prog;
+
+    if(!o->transpose){
+        struct MirrorBands job = {img, o, pixel_prog, planes, bytes};
+        threadpool_run_bands(threadpool_get_default(), (img->height + 1) / 2, mirror_band, &job);
+        if(image_is_indexed(img) && prog != NULL) image_apply_program(img, prog);
+        return 1;
+    }
+
+    Image* dst;
+    if(image_is_indexed(img)){
+        dst = image_create_indexed(img->height, img->width, image_get_colors(img));
+        if(dst == NULL){
+            return 0;
+        }
+        memcpy(image_get_palette(dst), image_get_palette(img), IMAGE_MAX_COLORS * sizeof(struct Pixel));
+        if(prog != NULL) image_apply_program(dst, prog);
+    }
+    else{
+        dst = image_create_layout(img->height, img->width, image_get_layout(img), img->flags);
+        if(dst == NULL){
+            return 0;
+        }
+    }
+    int tile = tile_size(bytes);
+    struct TransposeBands job = {img, dst, o, pixel_prog, planes, bytes, tile};
+    threadpool_run_bands(threadpool_get_default(), (dst->height + tile - 1) / tile, transpose_band, &job);
+    image_take_pixels(img, &dst);
+    return 1;
+}
@@ -0,0 +1,93 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Geometry.h
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "Image.h"
+#include "PointOps.h"
+
+// Largest number of transforms a command line or request may give
+#define GEOMETRY_MAX_OPS 8
+
+// Geometric transforms; rotations are clockwise
+enum GeometryOp {
+    GEOMETRY_ROTATE_90,
+    GEOMETRY_ROTATE_180,
+    GEOMETRY_ROTATE_270,
+    GEOMETRY_FLIP_HORIZONTAL, // Mirror the columns
+    GEOMETRY_FLIP_VERTICAL,   // Mirror the rows
+    GEOMETRY_TRANSPOSE,       // Swap rows and columns
+    GEOMETRY_OP_COUNT
+};
+
+// One of the eight orientations of an image: an optional transpose followed
+// by optional mirrors. Any sequence of geometric transforms reduces to one.
+struct Orientation {
+    int transpose;  // 1 to swap rows and columns first
+    int flip_x;     // 1 to mirror the columns afterwards
+    int flip_y;     // 1 to mirror the rows afterwards
+};
+
+/* Initializes an orientation to the identity.
+ *
+ * @param  o: the orientation.
+*/
+void orientation_identity(struct Orientation* o);
+
+/* Composes a transform onto an orientation, so that o becomes op applied
+ * after o.
+ *
+ * @param  o: the orientation.
+ * @param  op: the transform.
+*/
+void orientation_compose(struct Orientation* o, enum GeometryOp op);
+
+/* Composes an orientation onto another one, so that o becomes next applied
+ * after o.
+ *
+ * @param  o: the orientation.
+ * @param  next: the orientation applied second.
+*/
+void orientation_then(struct Orientation* o, const struct Orientation* next);
+
+/* Returns 1 if the orientation is the identity, 0 otherwise.
+ *
+ * @param  o: the orientation.
+*/
+int orientation_is_identity(const struct Orientation* o);
+
+/* Looks up a transform by name: rotate90, rotate180, rotate270, fliph,
+ * flipv or transpose.
+ *
+ * @param  name: the name.
+ * @param  op: receives the transform.
+ * @return 1 on success, 0 if the name is unknown.
+*/
+int geometry_from_name(const char* name, enum GeometryOp* op);
+
+/* Applies an orientation to an image and a point program to every pixel on
+ * the way. Orientations that keep rows and columns apart (flips and the 180
+ * degree rotation) run in place, swapping and reversing rows in parallel
+ * bands. Orientations that transpose copy the image into a new buffer in
+ * square tiles that fit in the L1 cache, so neither the reads nor the
+ * writes stride across the whole image; bands of tile rows run in
+ * parallel. Works on every layout; an indexed image has its indices moved
+ * and the point program applied to its palette.
+ *
+ * @param  img: the image, replaced by the result.
+ * @param  o: the orientation.
+ * @param  prog: point program to apply, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int geometry_apply(Image* img, const struct Orientation* o, const struct PointProgram* prog);
+
+#endif // GEOMETRY_H
@@ -0,0 +1,234 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Histogram.c
+
+#include "Histogram.h"
+#include "PixelKernels.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include <stdio.h>
+#include <string.h>
+
+// Names of the adjustments, indexed by enum HistogramAdjust
+static const char* adjust_names[HISTOGRAM_ADJUST_COUNT] = {"levels", "equalize", "balance"};
+
+// Function to initialize an empty histogram
+void histogram_init(struct Histogram* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+// Function to add a histogram to another
+void histogram_merge(struct Histogram* hist, const struct Histogram* other) {
+    for(int v = 0; v < 256; v++){
+        hist->blue[v] += other->blue[v];
+        hist->green[v] += other->green[v];
+        hist->red[v] += other->red[v];
+        hist->luma[v] += other->luma[v];
+    }
+    hist->count += other->count;
+}
+
+// Function to count a run of pixels given as separate channel bytes, step
+// bytes apart
+static void count_pixels(struct Histogram* hist, const unsigned char* blue, const unsigned char* green,
+                         const unsigned char* red, int count, int step, const unsigned char* ties) {
+    for(int j = 0; j < count; j++){
+        int b = blue[j * step], g = green[j * step], r = red[j * step];
+        hist->blue[b]++;
+        hist->green[g]++;
+        hist->red[r]++;
+        hist->luma[pixel_luma_fixed(ties, r, g, b)]++;
+    }
+    hist->count += count;
+}
+
+// Function to add rows of an image to a histogram
+void histogram_add_rows(struct Histogram* hist, Image* img, int begin, int end) {
+    const unsigned char* ties = point_luma_ties();
+    int width = img->width;
+    if(image_is_indexed(img)){
+        // The indices are counted, then every color once
+        unsigned long long indices[IMAGE_MAX_COLORS] = {0};
+        for(int i = begin; i < end; i++){
+            const unsigned char* row = image_get_index_row(img, i);
+            for(int j = 0; j < width; j++) indices[row[j]]++;
+        }
+        const struct Pixel* palette = image_get_palette(img);
+        for(int k = 0; k < image_get_colors(img); k++){
+            const struct Pixel* p = &palette[k];
+            hist->blue[p->blue] += indices[k];
+            hist->green[p->green] += indices[k];
+            hist->red[p->red] += indices[k];
+            hist->luma[pixel_luma_fixed(ties, p->red, p->green, p->blue)] += indices[k];
+            hist->count += indices[k];
+        }
+        return;
+    }
+    enum ImageLayout layout = image_get_layout(img);
+    for(int i = begin; i < end; i++){
+        if(layout == IMAGE_LAYOUT_PLANAR){
+            count_pixels(hist, image_get_plane_row(img, 0, i), image_get_plane_row(img, 1, i),
+                         image_get_plane_row(img, 2, i), width, 1, ties);
+        }
+        else{
+            const unsigned char* row = image_get_plane_row(img, 0, i);
+            int step = layout == IMAGE_LAYOUT_BGRX ? 4 : 3;
+            count_pixels(hist, row, row + 1, row + 2, width, step, ties);
+        }
+    }
+}
+
+// Context for histograms of contiguous shares of rows, one per thread
+struct HistogramChunks {
+    Image* img;
+    HistogramLoadFn load; // NULL if the rows are already loaded
+    void* ctx;
+    struct Histogram* private_hists;
+    int chunks;
+};
+
+// Rows loaded and counted at a time, so they are still in cache when counted
+#define LOAD_ROWS 16
+
+// Function to fill the private histogram of a share of rows
+static void histogram_chunk(void* ctx, int begin, int end) {
+    struct HistogramChunks* job = (struct HistogramChunks*)ctx;
+    int height = job->img->height;
+    int rows = (height + job->chunks - 1) / job->chunks;
+    for(int chunk = begin; chunk < end; chunk++){
+        struct Histogram* hist = &job->private_hists[chunk];
+        histogram_init(hist);
+        int last = (chunk + 1) * rows < height ? (chunk + 1) * rows : height;
+        for(int first = chunk * rows; first < last; first += LOAD_ROWS){
+            int stop = first + LOAD_ROWS < last ? first + LOAD_ROWS : last;
+            if(job->load != NULL) job->load(job->ctx, first, stop);
+            histogram_add_rows(hist, job->img, first, stop);
+        }
+    }
+}
+
+// Function to load rows and compute their histogram with private histograms
+static int histogram_run(Image* img, HistogramLoadFn load, void* ctx, struct Histogram* hist) {
+    struct HistogramChunks job = {img, load, ctx, NULL, threadpool_get_threads(threadpool_get_default())};
+    size_t bytes = (size_t)job.chunks * sizeof(struct Histogram);
+    job.private_hists = (struct Histogram*)buffer_pool_alloc(bytes);
+    if(job.private_hists == NULL){
+        perror("Failed to allocate memory for histograms");
+        return 0;
+    }
+    threadpool_run_items(threadpool_get_default(), job.chunks, histogram_chunk, &job);
+    histogram_init(hist);
+    for(int chunk = 0; chunk < job.chunks; chunk++){
+        histogram_merge(hist, &job.private_hists[chunk]);
+    }
+    buffer_pool_free(job.private_hists, bytes);
+    return 1;
+}
+
+// Function to compute the histogram of an image
+int histogram_compute(Image* img, struct Histogram* hist) {
+    return histogram_run(img, NULL, NULL, hist);
+}
+
+// Function to load an image and compute its histogram in one pass
+int histogram_load(Image* img, HistogramLoadFn load, void* ctx, struct Histogram* hist) {
+    return histogram_run(img, load, ctx, hist);
+}
+
+// Function to stretch a channel between its clipped extremes
+static void levels_channel(const unsigned long long* counts, unsigned long long total, unsigned char* table) {
+    unsigned long long clip = total * HISTOGRAM_CLIP_PERMILLE / 1000;
+    int low = 0, high = 255;
+    unsigned long long sum = counts[0];
+    while(low < 255 && sum <= clip) sum += counts[++low];
+    sum = counts[255];
+    while(high > 0 && sum <= clip) sum += counts[--high];
+    for(int v = 0; v < 256; v++){
+        if(high <= low){
+            table[v] = (unsigned char)v;
+            continue;
+        }
+        int value = v <= low ? 0 : v >= high ? 255 : ((v - low) * 255 + (high - low) / 2) / (high - low);
+        table[v] = (unsigned char)value;
+    }
+}
+
+// Function to map a channel through its cumulative distribution
+static void equalize_channel(const unsigned long long* counts, unsigned long long total, unsigned char* table) {
+    // The darkest value present maps to 0 and the brightest to 255
+    unsigned long long first = 0;
+    for(int v = 0; v < 256 && first == 0; v++) first = counts[v];
+    unsigned long long sum = 0;
+    for(int v = 0; v < 256; v++){
+        sum += counts[v];
+        if(total <= first){
+            table[v] = (unsigned char)v;
+        }
+        else{
+            unsigned long long above = sum > first ? sum - first : 0;
+            table[v] = (unsigned char)((above * 255 + (total - first) / 2) / (total - first));
+        }
+    }
+}
+
+// Function to compute the mean of a channel
+static double channel_mean(const unsigned long long* counts, unsigned long long total) {
+    double sum = 0.0;
+    for(int v = 0; v < 256; v++) sum += (double)counts[v] * v;
+    return total > 0 ? sum / total : 0.0;
+}
+
+// Function to compute gray world white balance shifts
+void histogram_balance_shifts(const struct Histogram* hist, int* rShift, int* gShift, int* bShift) {
+    double red = channel_mean(hist->red, hist->count);
+    double green = channel_mean(hist->green, hist->count);
+    double blue = channel_mean(hist->blue, hist->count);
+    double gray = (red + green + blue) / 3.0;
+    *rShift = (int)(gray - red + (gray >= red ? 0.5 : -0.5));
+    *gShift = (int)(gray - green + (gray >= green ? 0.5 : -0.5));
+    *bShift = (int)(gray - blue + (gray >= blue ? 0.5 : -0.5));
+}
+
+// Function to derive the lookup tables of an adjustment
+void histogram_adjust_lut(const struct Histogram* hist, enum HistogramAdjust adjust, struct PointLUT* lut) {
+    point_lut_identity(lut);
+    if(hist->count == 0) return;
+    if(adjust == HISTOGRAM_LEVELS){
+        levels_channel(hist->red, hist->count, lut->red);
+        levels_channel(hist->green, hist->count, lut->green);
+        levels_channel(hist->blue, hist->count, lut->blue);
+    }
+    else if(adjust == HISTOGRAM_EQUALIZE){
+        equalize_channel(hist->red, hist->count, lut->red);
+        equalize_channel(hist->green, hist->count, lut->green);
+        equalize_channel(hist->blue, hist->count, lut->blue);
+    }
+    else{
+        int rShift, gShift, bShift;
+        histogram_balance_shifts(hist, &rShift, &gShift, &bShift);
+        point_lut_shift(lut, rShift, gShift, bShift);
+    }
+}
+
+// Function to look up an adjustment by name
+int histogram_adjust_from_name(const char* name, enum HistogramAdjust* adjust) {
+    for(int i = 0; i < HISTOGRAM_ADJUST_COUNT; i++){
+        if(strcmp(name, adjust_names[i]) == 0){
+            *adjust = (enum HistogramAdjust)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to get the name of an adjustment
+const char* histogram_adjust_name(enum HistogramAdjust adjust) {
+    return adjust_names[adjust];
+}
@@ -0,0 +1,119 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Histogram.h
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "Image.h"
+#include "PointOps.h"
+
+// Share of the pixels auto-levels clips at each end of a channel, in tenths of a percent
+#define HISTOGRAM_CLIP_PERMILLE 5
+
+// Adjustments derived from the histogram of an image
+enum HistogramAdjust {
+    HISTOGRAM_LEVELS,   // Stretch every channel to the full range, clipping its extremes
+    HISTOGRAM_EQUALIZE, // Map every channel through its cumulative distribution
+    HISTOGRAM_BALANCE,  // Gray world white balance: shift the channel means together
+    HISTOGRAM_ADJUST_COUNT
+};
+
+// Per-channel and luma histograms of an image
+struct Histogram {
+    unsigned long long blue[256];
+    unsigned long long green[256];
+    unsigned long long red[256];
+    unsigned long long luma[256]; // Of the grayscale values, see point_luma
+    unsigned long long count;     // Number of pixels
+};
+
+// Function loading a band of rows [begin, end) of an image, see histogram_load
+typedef void (*HistogramLoadFn)(void* ctx, int begin, int end);
+
+/* Initializes an empty histogram.
+ *
+ * @param  hist: the histogram.
+*/
+void histogram_init(struct Histogram* hist);
+
+/* Adds the counts of a histogram to another.
+ *
+ * @param  hist: the histogram added to.
+ * @param  other: the histogram added.
+*/
+void histogram_merge(struct Histogram* hist, const struct Histogram* other);
+
+/* Adds a range of rows of an image to a histogram. An indexed image counts
+ * its indices and adds the palette colors they select.
+ *
+ * @param  hist: the histogram.
+ * @param  img: the image, of any layout.
+ * @param  begin: the first row.
+ * @param  end: one past the last row.
+*/
+void histogram_add_rows(struct Histogram* hist, Image* img, int begin, int end);
+
+/* Computes the histogram of an image in one read of its pixels. Every
+ * thread fills a private histogram over one contiguous share of the rows,
+ * and the private histograms are merged at the end.
+ *
+ * @param  img: the image.
+ * @param  hist: receives the histogram.
+ * @return 1 on success, 0 on failure.
+*/
+int histogram_compute(Image* img, struct Histogram* hist);
+
+/* Loads an image and computes its histogram in the same pass, like
+ * histogram_compute, with every thread loading a band of rows and counting
+ * them while they are still in cache.
+ *
+ * @param  img: the image the rows are loaded into.
+ * @param  load: loads a band of rows into img, called from any thread.
+ * @param  ctx: passed to load.
+ * @param  hist: receives the histogram.
+ * @return 1 on success, 0 on failure.
+*/
+int histogram_load(Image* img, HistogramLoadFn load, void* ctx, struct Histogram* hist);
+
+/* Derives the lookup tables of an adjustment from a histogram. An image
+ * whose channel holds a single value keeps that channel.
+ *
+ * @param  hist: the histogram.
+ * @param  adjust: the adjustment.
+ * @param  lut: receives the lookup tables.
+*/
+void histogram_adjust_lut(const struct Histogram* hist, enum HistogramAdjust adjust, struct PointLUT* lut);
+
+/* Computes gray world white balance shifts: each channel is shifted so that
+ * its mean becomes the mean of all three channel means.
+ *
+ * @param  hist: the histogram.
+ * @param  rShift: receives the red shift.
+ * @param  gShift: receives the green shift.
+ * @param  bShift: receives the blue shift.
+*/
+void histogram_balance_shifts(const struct Histogram* hist, int* rShift, int* gShift, int* bShift);
+
+/* Looks up an adjustment by name: levels, equalize or balance.
+ *
+ * @param  name: the name.
+ * @param  adjust: receives the adjustment.
+ * @return 1 on success, 0 if the name is unknown.
+*/
+int histogram_adjust_from_name(const char* name, enum HistogramAdjust* adjust);
+
+/* Returns the name of an adjustment.
+ *
+ * @param  adjust: the adjustment.
+*/
+const char* histogram_adjust_name(enum HistogramAdjust adjust);
+
+#endif // HISTOGRAM_H
@@ -9,157 +9,584 @@
 
 // Image.c
 
+#define _GNU_SOURCE
+
 #include "Image.h"
+#include "PointOps.h"
+#include "ThreadPool.h"
+#include "Resize.h"
+#include "Geometry.h"
+#include "Stats.h"
+#include "BufferPool.h"
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
 
-// Define the Pixel structure
-struct Pixel {
-    unsigned char blue;
-    unsigned char green;
-    unsigned char red;
-};
+// Huge page size used to round huge page backed buffers
+#define IMAGE_HUGEPAGE_SIZE (2 * 1024 * 1024)
 
-// Function to create a new image
-Image* image_create(struct Pixel** pArr, int width, int height) {
+// Size in bytes of a palette, which always has room for 256 entries
+#define IMAGE_PALETTE_BYTES (IMAGE_MAX_COLORS * sizeof(struct Pixel))
+
+// Names of the layouts, indexed by enum ImageLayout
+static const char* layout_names[IMAGE_LAYOUT_COUNT] = {"bgr", "bgrx", "planar"};
+
+// Function to get the size in bytes of one pixel of a plane of a layout
+static size_t layout_pixel_bytes(enum ImageLayout layout) {
+    return layout == IMAGE_LAYOUT_BGRX ? 4 : (layout == IMAGE_LAYOUT_PLANAR ? 1 : sizeof(struct Pixel));
+}
+
+// Function to get the number of planes of a layout
+static int layout_planes(enum ImageLayout layout) {
+    return layout == IMAGE_LAYOUT_PLANAR ? 3 : 1;
+}
+
+// Function to compute the row stride for a given width and pixel size
+static size_t image_row_stride(int width, size_t pixel_bytes) {
+    size_t bytes = (size_t)width * pixel_bytes;
+    return (bytes + IMAGE_ROW_ALIGN - 1) & ~((size_t)IMAGE_ROW_ALIGN - 1);
+}
+
+// Function to allocate a contiguous pixel buffer of one or more planes and
+// the row pointers of the first plane
+static int image_alloc_pixels(Image* img, int width, int height, int flags, size_t pixel_bytes, int planes) {
+    size_t stride = image_row_stride(width, pixel_bytes);
+    size_t size = stride * (size_t)height * planes;
+    unsigned char* data = NULL;
+    int mapped = 0;
+
+    if((flags & IMAGE_ALLOC_HUGEPAGES) && size >= IMAGE_HUGEPAGE_SIZE){
+        size = (size + IMAGE_HUGEPAGE_SIZE - 1) & ~((size_t)IMAGE_HUGEPAGE_SIZE - 1);
+        // Try explicit huge pages first, then transparent huge pages
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p == MAP_FAILED){
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(p != MAP_FAILED){
+                madvise(p, size, MADV_HUGEPAGE);
+            }
+        }
+        if(p != MAP_FAILED){
+            data = (unsigned char*)p;
+            mapped = 1;
+            stats_add_allocation(size);
+        }
+    }
+
+    if(data == NULL){
+        // The whole size class is usable, which lets image_reshape reuse it
+        size = buffer_pool_class_size(size);
+        data = (unsigned char*)buffer_pool_alloc(size);
+        if(data == NULL){
+            fprintf(stderr, "Failed to allocate memory for pixel buffer.\n");
+            return 0;
+        }
+    }
+
+    struct Pixel** pArr = (struct Pixel**)buffer_pool_alloc(height * sizeof(struct Pixel*));
     if(pArr == NULL){
-        fprintf(stderr, "Pixel array is NULL.\n");
+        perror("Failed to allocate memory for pixel row pointers");
+        if(mapped) munmap(data, size);
+        else buffer_pool_free(data, size);
+        return 0;
+    }
+    for(int i = 0; i < height; i++){
+        pArr[i] = (struct Pixel*)(data + i * stride);
+    }
+
+    img->pArr = pArr;
+    img->data = data;
+    img->stride = stride;
+    img->size = size;
+    img->width = width;
+    img->height = height;
+    img->mapped = mapped;
+    img->borrowed = 0;
+    img->palette = NULL;
+    img->colors = 0;
+    return 1;
+}
+
+// Function to release the pixel buffer and row pointers of an image
+static void image_release_pixels(Image* img) {
+    if(img->borrowed) img->data = NULL;
+    else if(img->mapped) munmap(img->data, img->size);
+    else buffer_pool_free(img->data, img->size);
+    buffer_pool_free(img->pArr, img->height * sizeof(struct Pixel*));
+    buffer_pool_free(img->palette, IMAGE_PALETTE_BYTES);
+    img->pArr = NULL;
+    img->data = NULL;
+    img->palette = NULL;
+    img->colors = 0;
+}
+
+// Function to create a new image
+Image* image_create(int width, int height) {
+    return image_create_ex(width, height, IMAGE_ALLOC_DEFAULT);
+}
+
+// Function to create a new image with allocation flags
+Image* image_create_ex(int width, int height, int flags) {
+    return image_create_layout(width, height, IMAGE_LAYOUT_BGR, flags);
+}
+
+// Function to create a new image with a pixel layout and allocation flags
+Image* image_create_layout(int width, int height, enum ImageLayout layout, int flags) {
+    if(width <= 0 || height <= 0){
+        fprintf(stderr, "Invalid image dimensions %dx%d.\n", width, height);
+        return NULL;
+    }
+    Image* img = (Image*)buffer_pool_alloc(sizeof(Image));
+    if(img == NULL){
+        perror("Failed to allocate memory for Image");
+        return NULL;
+    }
+    img->flags = flags;
+    img->layout = layout;
+    if(!image_alloc_pixels(img, width, height, flags, layout_pixel_bytes(layout), layout_planes(layout))){
+        buffer_pool_free(img, sizeof(Image));
+        return NULL;
+    }
+    return img;
+}
+
+// Function to create a new indexed image
+Image* image_create_indexed(int width, int height, int colors) {
+    if(width <= 0 || height <= 0){
+        fprintf(stderr, "Invalid image dimensions %dx%d.\n", width, height);
+        return NULL;
+    }
+    if(colors <= 0 || colors > IMAGE_MAX_COLORS){
+        fprintf(stderr, "Invalid number of palette colors %d.\n", colors);
         return NULL;
     }
-    Image* img = (Image*)malloc(sizeof(Image));
+    Image* img = (Image*)buffer_pool_alloc(sizeof(Image));
     if(img == NULL){
         perror("Failed to allocate memory for Image");
         return NULL;
     }
+    img->flags = IMAGE_ALLOC_DEFAULT;
+    img->layout = IMAGE_LAYOUT_BGR;
+    if(!image_alloc_pixels(img, width, height, IMAGE_ALLOC_DEFAULT, 1, 1)){
+        buffer_pool_free(img, sizeof(Image));
+        return NULL;
+    }
+    // Entries past colors stay black, so stray indices still map to a color
+    img->palette = (struct Pixel*)buffer_pool_alloc(IMAGE_PALETTE_BYTES);
+    if(img->palette == NULL){
+        perror("Failed to allocate memory for palette");
+        image_destroy(&img);
+        return NULL;
+    }
+    memset(img->palette, 0, IMAGE_PALETTE_BYTES);
+    img->colors = colors;
+    return img;
+}
+
+// Function to create an image over pixels owned by the caller
+Image* image_wrap(unsigned char* data, int width, int height, ptrdiff_t stride) {
+    if(width <= 0 || height <= 0){
+        fprintf(stderr, "Invalid image dimensions %dx%d.\n", width, height);
+        return NULL;
+    }
+    Image* img = (Image*)buffer_pool_alloc(sizeof(Image));
+    struct Pixel** pArr = (struct Pixel**)buffer_pool_alloc(height * sizeof(struct Pixel*));
+    if(img == NULL || pArr == NULL){
+        perror("Failed to allocate memory for Image");
+        buffer_pool_free(img, sizeof(Image));
+        buffer_pool_free(pArr, height * sizeof(struct Pixel*));
+        return NULL;
+    }
+    for(int i = 0; i < height; i++){
+        pArr[i] = (struct Pixel*)(data + i * stride);
+    }
     img->pArr = pArr;
+    img->data = data;
+    img->stride = stride;
+    img->size = 0; // Never reused by image_reshape
     img->width = width;
     img->height = height;
+    img->flags = IMAGE_ALLOC_DEFAULT;
+    img->layout = IMAGE_LAYOUT_BGR;
+    img->mapped = 0;
+    img->borrowed = 1;
+    img->palette = NULL;
+    img->colors = 0;
     return img;
 }
 
 // Function to destroy an image
 void image_destroy(Image** img) {
     if(img && *img){
-        // Free each row
-        for(int i = 0; i < (*img)->height; i++){
-            free((*img)->pArr[i]);
-        }
-        // Free pixel array
-        free((*img)->pArr);
-        // Free image structure
-        free(*img);
+        // Free pixel buffer and row pointers
+        image_release_pixels(*img);
+        // Give image structure back to the pool
+        buffer_pool_free(*img, sizeof(Image));
         *img = NULL;
     }
 }
 
+// Function to move the pixels of one image into another
+void image_take_pixels(Image* img, Image** src) {
+    image_release_pixels(img);
+    img->pArr = (*src)->pArr;
+    img->data = (*src)->data;
+    img->stride = (*src)->stride;
+    img->size = (*src)->size;
+    img->mapped = (*src)->mapped;
+    img->borrowed = (*src)->borrowed;
+    img->width = (*src)->width;
+    img->height = (*src)->height;
+    img->palette = (*src)->palette;
+    img->colors = (*src)->colors;
+    img->layout = (*src)->layout;
+    buffer_pool_free(*src, sizeof(Image));
+    *src = NULL;
+}
+
+// Function to give an image a new size, reusing its pixel buffer if possible
+int image_reshape(Image* img, int width, int height) {
+    if(width <= 0 || height <= 0){
+        fprintf(stderr, "Invalid image dimensions %dx%d.\n", width, height);
+        return 0;
+    }
+    size_t stride = image_row_stride(width, layout_pixel_bytes(img->layout));
+    if(stride * (size_t)height * layout_planes(img->layout) > img->size){
+        Image* fresh = image_create_layout(width, height, img->layout, img->flags);
+        if(fresh == NULL){
+            return 0;
+        }
+        image_take_pixels(img, &fresh);
+        return 1;
+    }
+
+    struct Pixel** pArr = (struct Pixel**)buffer_pool_alloc(height * sizeof(struct Pixel*));
+    if(pArr == NULL){
+        perror("Failed to allocate memory for pixel row pointers");
+        return 0;
+    }
+    buffer_pool_free(img->pArr, img->height * sizeof(struct Pixel*));
+    // A reshaped image always holds true color pixels
+    buffer_pool_free(img->palette, IMAGE_PALETTE_BYTES);
+    img->palette = NULL;
+    img->colors = 0;
+    for(int i = 0; i < height; i++){
+        pArr[i] = (struct Pixel*)(img->data + i * stride);
+    }
+    img->pArr = pArr;
+    img->stride = stride;
+    img->width = width;
+    img->height = height;
+    return 1;
+}
+
 // Function to get pixel array
 struct Pixel** image_get_pixels(Image* img) {
     return img->pArr;
 }
 
-// Function to get image width
-int image_get_width(Image* img) {
-    return img->width;
+// Function to get a pointer to a row
+struct Pixel* image_get_row(Image* img, int row) {
+    return (struct Pixel*)(img->data + row * img->stride);
 }
 
-// Function to get image height
-int image_get_height(Image* img) {
-    return img->height;
+// Function to get the row stride
+ptrdiff_t image_get_stride(Image* img) {
+    return img->stride;
 }
 
-// Function to apply grayscale filter
-void image_apply_bw(Image* img) {
-    for(int i = 0; i < img->height; i++) {
-        for(int j = 0; j < img->width; j++) {
-            struct Pixel* p = &img->pArr[i][j];
-            unsigned char grayscale = (unsigned char)(0.299 * p->red + 0.587 * p->green + 0.114 * p->blue);
-            p->red = grayscale;
-            p->green = grayscale;
-            p->blue = grayscale;
+// Function to get the pixel layout
+enum ImageLayout image_get_layout(Image* img) {
+    return img->layout;
+}
+
+// Function to get a pointer to a row of a plane
+unsigned char* image_get_plane_row(Image* img, int plane, int row) {
+    return img->data + ((ptrdiff_t)plane * img->height + row) * img->stride;
+}
+
+// Function to load a row of 24 or 32-bit BMP pixels
+void image_load_row(Image* img, int row, const unsigned char* src, int bits) {
+    int width = img->width;
+    int step = bits / 8;
+    if(img->layout == IMAGE_LAYOUT_PLANAR){
+        unsigned char* b = image_get_plane_row(img, 0, row);
+        unsigned char* g = image_get_plane_row(img, 1, row);
+        unsigned char* r = image_get_plane_row(img, 2, row);
+        for(int j = 0; j < width; j++, src += step){
+            b[j] = src[0];
+            g[j] = src[1];
+            r[j] = src[2];
         }
+        return;
+    }
+    unsigned char* dst = image_get_plane_row(img, 0, row);
+    int size = (int)layout_pixel_bytes(img->layout);
+    if(step == size){
+        memcpy(dst, src, (size_t)width * size);
+        return;
+    }
+    for(int j = 0; j < width; j++, src += step, dst += size){
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        if(size == 4) dst[3] = 0;
     }
 }
 
-// Helper function to clamp color values
-unsigned char clamp(int value) {
-    if(value < 0) return 0;
-    if(value > 255) return 255;
-    return (unsigned char)value;
+// Function to store a row as 24 or 32-bit BMP pixels
+void image_store_row(Image* img, int row, unsigned char* dst, int bits) {
+    int width = img->width;
+    int step = bits / 8;
+    if(img->layout == IMAGE_LAYOUT_PLANAR){
+        const unsigned char* b = image_get_plane_row(img, 0, row);
+        const unsigned char* g = image_get_plane_row(img, 1, row);
+        const unsigned char* r = image_get_plane_row(img, 2, row);
+        for(int j = 0; j < width; j++, dst += step){
+            dst[0] = b[j];
+            dst[1] = g[j];
+            dst[2] = r[j];
+            if(step == 4) dst[3] = 0;
+        }
+        return;
+    }
+    const unsigned char* src = image_get_plane_row(img, 0, row);
+    int size = (int)layout_pixel_bytes(img->layout);
+    if(step == size){
+        memcpy(dst, src, (size_t)width * size);
+        return;
+    }
+    for(int j = 0; j < width; j++, src += size, dst += step){
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        if(step == 4) dst[3] = 0;
+    }
 }
 
-// Function to apply color shift
-void image_apply_colorshift(Image* img, int rShift, int gShift, int bShift) {
-    for(int i = 0; i < img->height; i++) {
-        for(int j = 0; j < img->width; j++) {
-            struct Pixel* p = &img->pArr[i][j];
-            p->red = clamp(p->red + rShift);
-            p->green = clamp(p->green + gShift);
-            p->blue = clamp(p->blue + bShift);
+// Context for converting bands of rows to another layout
+struct ConvertBands {
+    Image* src;
+    Image* dst;
+};
+
+// Function to convert a band of rows, through BMP pixels of the non-planar side
+static void convert_band(void* ctx, int begin, int end) {
+    struct ConvertBands* job = (struct ConvertBands*)ctx;
+    for(int i = begin; i < end; i++){
+        if(job->src->layout == IMAGE_LAYOUT_PLANAR){
+            int bits = job->dst->layout == IMAGE_LAYOUT_BGRX ? 32 : 24;
+            image_store_row(job->src, i, image_get_plane_row(job->dst, 0, i), bits);
+        }
+        else{
+            int bits = job->src->layout == IMAGE_LAYOUT_BGRX ? 32 : 24;
+            image_load_row(job->dst, i, image_get_plane_row(job->src, 0, i), bits);
         }
     }
 }
 
-// Function to apply resize using nearest neighbor
-int image_apply_resize(Image* img, float factor) {
-    if(factor <= 0){
-        fprintf(stderr, "Scaling factor must be greater than 0.\n");
+// Function to convert an image to another pixel layout
+int image_convert_layout(Image* img, enum ImageLayout layout) {
+    if(!image_expand_palette(img)){
         return 0;
     }
+    if(img->layout == layout) return 1;
+    Image* converted = image_create_layout(img->width, img->height, layout, img->flags);
+    if(converted == NULL){
+        return 0;
+    }
+    struct ConvertBands job = {img, converted};
+    threadpool_run_bands(threadpool_get_default(), img->height, convert_band, &job);
+    image_take_pixels(img, &converted);
+    return 1;
+}
 
-    int new_width = (int)(img->width * factor);
-    int new_height = (int)(img->height * factor);
+// Function to look up a layout by name
+int image_layout_from_name(const char* name, enum ImageLayout* layout) {
+    for(int i = 0; i < IMAGE_LAYOUT_COUNT; i++){
+        if(strcmp(name, layout_names[i]) == 0){
+            *layout = (enum ImageLayout)i;
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    if(new_width == 0) new_width = 1;
-    if(new_height == 0) new_height = 1;
+// Function to get the name of a layout
+const char* image_layout_name(enum ImageLayout layout) {
+    return layout_names[layout];
+}
 
-    // Allocate new pixel array
-    struct Pixel** new_pArr = (struct Pixel**)malloc(new_height * sizeof(struct Pixel*));
-    if(new_pArr == NULL){
-        perror("Failed to allocate memory for resized pixel array");
-        return 0;
-    }
+// Function to tell whether an image is indexed
+int image_is_indexed(Image* img) {
+    return img->palette != NULL;
+}
+
+// Function to get the palette of an indexed image
+struct Pixel* image_get_palette(Image* img) {
+    return img->palette;
+}
+
+// Function to get the number of palette colors
+int image_get_colors(Image* img) {
+    return img->colors;
+}
+
+// Function to get a pointer to a row of indices
+unsigned char* image_get_index_row(Image* img, int row) {
+    return img->data + row * img->stride;
+}
+
+// Function to get image width
+int image_get_width(Image* img) {
+    return img->width;
+}
 
-    int allocation_failed = 0;
-    for(int i = 0; i < new_height; i++) {
-        new_pArr[i] = (struct Pixel*)malloc(new_width * sizeof(struct Pixel));
-        if(new_pArr[i] == NULL){
-            perror("Failed to allocate memory for resized pixel row");
-            allocation_failed = 1;
-            // Free previously allocated rows
-            for(int j = 0; j < i; j++) free(new_pArr[j]);
-            break;
+// Function to get image height
+int image_get_height(Image* img) {
+    return img->height;
+}
+
+// Context for running a point program on bands of rows
+struct ProgramBands {
+    Image* img;
+    const struct PointProgram* prog;
+};
+
+// Function to run a point program on a range of rows
+void image_apply_program_rows(Image* img, const struct PointProgram* prog, int begin, int end) {
+    for(int i = begin; i < end; i++) {
+        if(img->layout == IMAGE_LAYOUT_BGRX){
+            point_program_apply_bgrx(prog, image_get_plane_row(img, 0, i), img->width);
+        }
+        else if(img->layout == IMAGE_LAYOUT_PLANAR){
+            point_program_apply_planar(prog, image_get_plane_row(img, 0, i), image_get_plane_row(img, 1, i),
+                                       image_get_plane_row(img, 2, i), img->width);
+        }
+        else{
+            point_program_apply(prog, image_get_row(img, i), img->width);
         }
     }
+}
+
+// Function to run a point program on a band of rows
+static void program_band(void* ctx, int begin, int end) {
+    struct ProgramBands* job = (struct ProgramBands*)ctx;
+    image_apply_program_rows(job->img, job->prog, begin, end);
+}
+
+// Function to run a point program on every pixel, or on the palette of an
+// indexed image, which makes it independent of the image size
+void image_apply_program(Image* img, const struct PointProgram* prog) {
+    if(img->palette != NULL){
+        point_program_apply(prog, img->palette, img->colors);
+        return;
+    }
+    struct ProgramBands job = {img, prog};
+    threadpool_run_bands(threadpool_get_default(), img->height, program_band, &job);
+}
+
+// Context for expanding the indices of bands of rows
+struct ExpandBands {
+    Image* src;
+    Image* dst;
+};
 
-    if(allocation_failed){
-        free(new_pArr);
+// Function to look up the colors of a band of rows
+static void expand_band(void* ctx, int begin, int end) {
+    struct ExpandBands* job = (struct ExpandBands*)ctx;
+    const struct Pixel* palette = job->src->palette;
+    int width = job->src->width;
+    for(int i = begin; i < end; i++){
+        const unsigned char* src = image_get_index_row(job->src, i);
+        struct Pixel* dst = image_get_row(job->dst, i);
+        for(int j = 0; j < width; j++) dst[j] = palette[src[j]];
+    }
+}
+
+// Function to convert an indexed image to true color pixels
+int image_expand_palette(Image* img) {
+    if(img->palette == NULL) return 1;
+    Image* expanded = image_create_ex(img->width, img->height, img->flags);
+    if(expanded == NULL){
         return 0;
     }
+    struct ExpandBands job = {img, expanded};
+    threadpool_run_bands(threadpool_get_default(), img->height, expand_band, &job);
+    image_take_pixels(img, &expanded);
+    return 1;
+}
 
-    // Apply nearest neighbor
-    for(int i = 0; i < new_height; i++) {
-        for(int j = 0; j < new_width; j++) {
-            int orig_i = (int)(i / factor);
-            int orig_j = (int)(j / factor);
+// Function to apply grayscale filter
+void image_apply_bw(Image* img) {
+    struct PointProgram prog;
+    point_program_init(&prog);
+    point_program_add_luma(&prog);
+    image_apply_program(img, &prog);
+}
 
-            if(orig_i >= img->height) orig_i = img->height -1;
-            if(orig_j >= img->width) orig_j = img->width -1;
+// Function to apply color shift
+void image_apply_colorshift(Image* img, int rShift, int gShift, int bShift) {
+    struct PointLUT lut;
+    point_lut_identity(&lut);
+    point_lut_shift(&lut, rShift, gShift, bShift);
+    image_apply_lut(img, &lut);
+}
 
-            new_pArr[i][j] = img->pArr[orig_i][orig_j];
-        }
+// Function to apply per-channel lookup tables
+void image_apply_lut(Image* img, const struct PointLUT* lut) {
+    struct PointProgram prog;
+    point_program_init(&prog);
+    point_program_add_lut(&prog, lut);
+    image_apply_program(img, &prog);
+}
+
+// Function to apply resize using nearest neighbor
+int image_apply_resize(Image* img, float factor) {
+    if(factor <= 0){
+        fprintf(stderr, "Scaling factor must be greater than 0.\n");
+        return 0;
     }
 
-    // Free old pixel array
-    for(int i = 0; i < img->height; i++) {
-        free(img->pArr[i]);
+    // Build the source index tables once, then gather
+    struct ResizeAxis x, y;
+    resize_axis_init(&x, img->width);
+    resize_axis_init(&y, img->height);
+    int ok = resize_axis_scale(&x, factor) && resize_axis_scale(&y, factor) &&
+             resize_nearest(img, &x, &y, NULL);
+    resize_axis_free(&x);
+    resize_axis_free(&y);
+    return ok;
+}
+
+// Function to apply a geometric transform
+static int apply_geometry(Image* img, enum GeometryOp op) {
+    struct Orientation o;
+    orientation_identity(&o);
+    orientation_compose(&o, op);
+    return geometry_apply(img, &o, NULL);
+}
+
+// Function to rotate clockwise
+int image_apply_rotate(Image* img, int degrees) {
+    switch(((degrees % 360) + 360) % 360){
+        case 0: return 1;
+        case 90: return apply_geometry(img, GEOMETRY_ROTATE_90);
+        case 180: return apply_geometry(img, GEOMETRY_ROTATE_180);
+        case 270: return apply_geometry(img, GEOMETRY_ROTATE_270);
+        default:
+            fprintf(stderr, "Rotation must be a multiple of 90 degrees.\n");
+            return 0;
     }
-    free(img->pArr);
+}
 
-    // Update image
-    img->pArr = new_pArr;
-    img->width = new_width;
-    img->height = new_height;
+// Function to mirror the columns or the rows
+int image_apply_flip(Image* img, int horizontal) {
+    return apply_geometry(img, horizontal ? GEOMETRY_FLIP_HORIZONTAL : GEOMETRY_FLIP_VERTICAL);
+}
 
-    return 1;
+// Function to swap rows and columns
+int image_apply_transpose(Image* img) {
+    return apply_geometry(img, GEOMETRY_TRANSPOSE);
 }
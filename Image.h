@@ -13,43 +13,260 @@
 #define IMAGE_H
 
 #include <stdio.h>
+#include <stddef.h>
 
-// Forward declaration of Pixel struct
-struct Pixel;
+// Structure for a single 24-bit Pixel
+struct Pixel {
+    unsigned char blue;
+    unsigned char green;
+    unsigned char red;
+};
+
+// Forward declarations of the point operations used by image_apply_lut
+struct PointLUT;
+struct PointProgram;
 
 // Image ADT
 typedef struct Image Image;
 
+// Alignment in bytes of every pixel row
+#define IMAGE_ROW_ALIGN 64
+
+// Largest number of palette colors of an indexed image
+#define IMAGE_MAX_COLORS 256
+
+// Pixel layouts of a true color image
+enum ImageLayout {
+    IMAGE_LAYOUT_BGR,    // Packed 3-byte blue, green, red pixels, as in a 24-bit BMP file
+    IMAGE_LAYOUT_BGRX,   // 4-byte pixels with a fourth byte kept as is, as in a 32-bit BMP file
+    IMAGE_LAYOUT_PLANAR, // One plane of bytes per channel: blue, then green, then red
+    IMAGE_LAYOUT_COUNT
+};
+
+// Allocation flags for image_create_ex
+#define IMAGE_ALLOC_DEFAULT   0
+#define IMAGE_ALLOC_HUGEPAGES 1 // Back the pixel buffer with huge pages when possible
+
 // Image structure
 struct Image {
-    struct Pixel** pArr;
+    struct Pixel** pArr;   // Row pointers into data (the blue plane if planar), kept for compatibility
+    unsigned char* data;   // Single contiguous pixel buffer
+    ptrdiff_t stride;      // Distance in bytes between the starts of two rows, negative for bottom-up rows
+    size_t size;           // Size of the pixel buffer in bytes
     int width;
     int height;
+    int flags;             // Allocation flags the image was created with
+    enum ImageLayout layout; // Layout of the pixels, IMAGE_LAYOUT_BGR for an indexed image
+    int mapped;            // 1 if data was allocated with mmap, 0 if drawn from the buffer pool
+    int borrowed;          // 1 if data belongs to the caller, see image_wrap
+    struct Pixel* palette; // Colors of an indexed image, whose data holds one index byte per pixel; NULL otherwise
+    int colors;            // Number of palette colors in use
 };
 
 // Function Declarations
 
-/* Creates a new image and returns it.
- * 
- * @param  pArr: Pixel array of this image.
+/* Creates a new image with an uninitialized pixel buffer and returns it.
+ * All rows live in one allocation and start on a IMAGE_ROW_ALIGN boundary.
+ * The image and its buffers are drawn from the buffer pool (see
+ * BufferPool.h), so images of similar sizes reuse released memory.
+ *
+ * @param  width: Width of this image.
+ * @param  height: Height of this image.
+ * @return A pointer to a new image, NULL on failure.
+*/
+Image* image_create(int width, int height);
+
+/* Creates a new image like image_create, using the given allocation flags.
+ *
+ * @param  width: Width of this image.
+ * @param  height: Height of this image.
+ * @param  flags: IMAGE_ALLOC_DEFAULT or IMAGE_ALLOC_HUGEPAGES.
+ * @return A pointer to a new image, NULL on failure.
+*/
+Image* image_create_ex(int width, int height, int flags);
+
+/* Creates a new image like image_create_ex with the given pixel layout. A
+ * planar image holds its three planes in one allocation, each with height
+ * rows of image_get_stride bytes.
+ *
+ * @param  width: Width of this image.
+ * @param  height: Height of this image.
+ * @param  layout: the pixel layout.
+ * @param  flags: IMAGE_ALLOC_DEFAULT or IMAGE_ALLOC_HUGEPAGES.
+ * @return A pointer to a new image, NULL on failure.
+*/
+Image* image_create_layout(int width, int height, enum ImageLayout layout, int flags);
+
+/* Creates a new indexed image: one byte per pixel indexing a palette of up
+ * to IMAGE_MAX_COLORS colors, as in a 1, 4 or 8-bit BMP file. Both the
+ * indices and the palette, which is all black, are left for the caller to
+ * fill in. Point filters on an indexed image only rewrite its palette, and
+ * nearest neighbor resizes move its indices; other filters need
+ * image_expand_palette first.
+ *
  * @param  width: Width of this image.
  * @param  height: Height of this image.
- * @return A pointer to a new image.
+ * @param  colors: Number of palette colors, 1 to IMAGE_MAX_COLORS.
+ * @return A pointer to a new image, NULL on failure.
 */
-Image* image_create(struct Pixel** pArr, int width, int height);
+Image* image_create_indexed(int width, int height, int colors);
 
-/* Destroys an image. Does not deallocate internal pixel array.
- * 
+/* Creates an image over pixels owned by the caller, without copying them.
+ * Row i starts at data + i * stride, so a negative stride wraps rows stored
+ * bottom-up as in a BMP file. Filters write into the caller's pixels; a
+ * resize or reshape moves the image to a buffer of its own. The pixels must
+ * outlive the image and are not freed by image_destroy.
+ *
+ * @param  data: the first pixel of row 0.
+ * @param  width: Width of this image.
+ * @param  height: Height of this image.
+ * @param  stride: distance in bytes between the starts of two rows.
+ * @return A pointer to a new image, NULL on failure.
+*/
+Image* image_wrap(unsigned char* data, int width, int height, ptrdiff_t stride);
+
+/* Destroys an image and gives its pixel buffer back to the buffer pool.
+ *
  * @param  img: the image to destroy.
 */
 void image_destroy(Image** img);
 
-/* Returns a double pointer to the pixel array.
+/* Replaces the pixels of an image with those of another image and destroys
+ * the other image. Useful for filters that produce a new pixel buffer.
+ *
+ * @param  img: the image whose pixels are replaced.
+ * @param  src: the image whose pixels are moved into img.
+*/
+void image_take_pixels(Image* img, Image** src);
+
+/* Gives an image a new size, reusing its pixel buffer when it is large
+ * enough and allocating a new one otherwise. The pixels are left
+ * uninitialized and keep their layout, except that an indexed image becomes
+ * a packed BGR one. Useful for processing many images with one buffer.
+ *
+ * @param  img: the image.
+ * @param  width: the new width.
+ * @param  height: the new height.
+ * @return 1 on success, 0 on failure.
+*/
+int image_reshape(Image* img, int width, int height);
+
+/* Returns a double pointer to the pixel array. The row pointers point into
+ * the contiguous pixel buffer.
  *
  * @param  img: the image.
 */
 struct Pixel** image_get_pixels(Image* img);
 
+/* Returns a pointer to the first pixel of a row of a packed BGR image.
+ *
+ * @param  img: the image.
+ * @param  row: the row index, 0 being the top row.
+*/
+struct Pixel* image_get_row(Image* img, int row);
+
+/* Returns the distance in bytes between the starts of two rows, negative
+ * for a wrapped image whose rows are stored bottom-up.
+ *
+ * @param  img: the image.
+*/
+ptrdiff_t image_get_stride(Image* img);
+
+/* Tells whether an image is indexed, see image_create_indexed.
+ *
+ * @param  img: the image.
+ * @return 1 if the image has a palette, 0 if it holds true color pixels.
+*/
+int image_is_indexed(Image* img);
+
+/* Returns the palette of an indexed image, which always has room for
+ * IMAGE_MAX_COLORS entries, or NULL for a true color image.
+ *
+ * @param  img: the image.
+*/
+struct Pixel* image_get_palette(Image* img);
+
+/* Returns the number of palette colors in use, 0 for a true color image.
+ *
+ * @param  img: the image.
+*/
+int image_get_colors(Image* img);
+
+/* Returns a pointer to the first index of a row of an indexed image.
+ *
+ * @param  img: the image.
+ * @param  row: the row index, 0 being the top row.
+*/
+unsigned char* image_get_index_row(Image* img, int row);
+
+/* Returns the pixel layout of an image.
+ *
+ * @param  img: the image.
+*/
+enum ImageLayout image_get_layout(Image* img);
+
+/* Returns a pointer to the first byte of a row of a plane. A planar image
+ * has planes 0 (blue), 1 (green) and 2 (red); every other image has only
+ * plane 0, whose rows hold whole pixels.
+ *
+ * @param  img: the image.
+ * @param  plane: the plane index.
+ * @param  row: the row index, 0 being the top row.
+*/
+unsigned char* image_get_plane_row(Image* img, int plane, int row);
+
+/* Converts one row of 24 or 32-bit BMP pixels into a row of an image of any
+ * layout. Loading 24-bit pixels into a BGRX image sets the fourth bytes to 0.
+ *
+ * @param  img: the true color image.
+ * @param  row: the row index.
+ * @param  src: the pixels, blue, green, red and for 32 bits a fourth byte.
+ * @param  bits: 24 or 32.
+*/
+void image_load_row(Image* img, int row, const unsigned char* src, int bits);
+
+/* Converts one row of an image of any layout into 24 or 32-bit BMP pixels,
+ * the inverse of image_load_row. Storing 32-bit pixels from an image
+ * without fourth bytes sets them to 0.
+ *
+ * @param  img: the true color image.
+ * @param  row: the row index.
+ * @param  dst: receives width pixels.
+ * @param  bits: 24 or 32.
+*/
+void image_store_row(Image* img, int row, unsigned char* dst, int bits);
+
+/* Converts an image to another pixel layout in parallel row bands. An
+ * indexed image is expanded first. Does nothing if the layout is unchanged.
+ *
+ * @param  img: the image.
+ * @param  layout: the new layout.
+ * @return 1 on success, 0 on failure.
+*/
+int image_convert_layout(Image* img, enum ImageLayout layout);
+
+/* Looks up a layout by name: bgr, bgrx or planar.
+ *
+ * @param  name: the name.
+ * @param  layout: receives the layout.
+ * @return 1 on success, 0 if the name is unknown.
+*/
+int image_layout_from_name(const char* name, enum ImageLayout* layout);
+
+/* Returns the name of a layout.
+ *
+ * @param  layout: the layout.
+*/
+const char* image_layout_name(enum ImageLayout layout);
+
+/* Converts an indexed image to true color pixels by looking up every index
+ * in the palette. Does nothing for a true color image.
+ *
+ * @param  img: the image.
+ * @return 1 on success, 0 on failure.
+*/
+int image_expand_palette(Image* img);
+
 /* Returns the width of the image.
  *
  * @param  img: the image.
@@ -62,7 +279,8 @@ int image_get_width(Image* img);
 */
 int image_get_height(Image* img);
 
-/* Converts the image to grayscale.
+/* Converts the image to grayscale. An indexed image only has its palette
+ * converted.
  *
  * @param  img: the image.
 */
@@ -71,6 +289,7 @@ void image_apply_bw(Image* img);
 /**
  * Shift color of the internal Pixel array. The dimension of the array is width * height.
  * The shift value of RGB is rShift, gShift, bShift. Useful for color shift.
+ * An indexed image only has its palette shifted.
  *
  * @param  img: the image.
  * @param  rShift: the shift value of color r shift
@@ -79,7 +298,36 @@ void image_apply_bw(Image* img);
  */
 void image_apply_colorshift(Image* img, int rShift, int gShift, int bShift);
 
-/* Resizes the image using nearest neighbor scaling.
+/* Applies per-channel lookup tables to every pixel. Tone operations such as
+ * gamma, levels or invert are built as a struct PointLUT (see PointOps.h).
+ *
+ * @param  img: the image.
+ * @param  lut: the lookup tables.
+*/
+void image_apply_lut(Image* img, const struct PointLUT* lut);
+
+/* Applies a point program to every pixel in parallel row bands, with the
+ * kernel for the layout of the image, or only to the palette of an indexed
+ * image.
+ *
+ * @param  img: the image.
+ * @param  prog: the point program.
+*/
+void image_apply_program(Image* img, const struct PointProgram* prog);
+
+/* Applies a point program to a range of rows of a true color image in the
+ * calling thread, with the kernel for the layout of the image. Useful for
+ * fusing a point program into another pass over the rows.
+ *
+ * @param  img: the true color image.
+ * @param  prog: the point program.
+ * @param  begin: the first row.
+ * @param  end: one past the last row.
+*/
+void image_apply_program_rows(Image* img, const struct PointProgram* prog, int begin, int end);
+
+/* Resizes the image using nearest neighbor scaling. The image keeps its
+ * layout, and an indexed image keeps its palette and has its indices resized.
  *
  * @param  img: the image.
  * @param  factor: the scaling factor
@@ -87,4 +335,27 @@ void image_apply_colorshift(Image* img, int rShift, int gShift, int bShift);
 */
 int image_apply_resize(Image* img, float factor);
 
+/* Rotates the image clockwise, see geometry_apply in Geometry.h.
+ *
+ * @param  img: the image.
+ * @param  degrees: a multiple of 90, may be negative.
+ * @return 1 on success, 0 on failure.
+*/
+int image_apply_rotate(Image* img, int degrees);
+
+/* Mirrors the image in place.
+ *
+ * @param  img: the image.
+ * @param  horizontal: 1 to mirror the columns, 0 to mirror the rows.
+ * @return 1 on success, 0 on failure.
+*/
+int image_apply_flip(Image* img, int horizontal);
+
+/* Swaps the rows and columns of the image.
+ *
+ * @param  img: the image.
+ * @return 1 on success, 0 on failure.
+*/
+int image_apply_transpose(Image* img);
+
 #endif // IMAGE_H
@@ -0,0 +1,31 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// KernelCheck.c
+//
+// Checks that every SIMD kernel set the CPU supports is bit-identical to the
+// scalar kernels, see pixel_kernels_verify. Exits with status 0 if they all
+// are, 1 otherwise. make check builds and runs it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "PixelKernels.h"
+
+int main(void) {
+    for(int level = KERNEL_SCALAR + 1; level < KERNEL_LEVEL_COUNT; level++){
+        const struct PixelKernels* kernels = pixel_kernels_for((enum KernelLevel)level);
+        if(kernels != NULL) printf("Checking kernel set %s.\n", kernels->name);
+    }
+    if(!pixel_kernels_verify()){
+        fprintf(stderr, "Kernel verification failed.\n");
+        return EXIT_FAILURE;
+    }
+    printf("Every kernel set matches the scalar kernels.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,314 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Pipeline.c
+
+#include "Pipeline.h"
+#include "Stream.h"
+#include "Stats.h"
+#include "Planner.h"
+#include "Pyramid.h"
+#include "Histogram.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Outputs at least this large are preallocated before writing
+#define LARGE_OUTPUT_BYTES (64u * 1024 * 1024)
+
+// Function to filter a BMP file held in memory and encode the result
+unsigned char* pipeline_process_buffer(unsigned char* data, size_t length, FilterChain* chain, size_t* out_length) {
+    struct BMP_Header bmp_header;
+    struct DIB_Header dib_header;
+    // A leading vertical flip is absorbed by decoding the rows in file order
+    FilterChain rest;
+    int flip = filter_chain_split_flip(chain, &rest);
+    if(flip) chain = &rest;
+    unsigned long long start = stats_now();
+    Image* img = bmp_decode_from_buffer(data, length, &bmp_header, &dib_header,
+                                        flip ? BMP_DECODE_FLIP : BMP_DECODE_DEFAULT);
+    if(img == NULL){
+        // Error message already printed
+        return NULL;
+    }
+    stats_add_time(STATS_HEADERS, start);
+
+    // Point stages run where the image is smallest
+    FilterChain planned;
+    planner_optimize(chain, img->width, img->height, &planned);
+    chain = &planned;
+
+    // A resize always gets new headers, even when the size does not change;
+    // an indexed image keeps its bit count and resolution
+    int resized = filter_chain_has_resize(chain);
+    unsigned char* output = NULL;
+    if(filter_chain_apply(chain, img)){
+        start = stats_now();
+        output = resized && !image_is_indexed(img) ? bmp_encode_to_buffer(img, NULL, NULL, out_length) :
+                           bmp_encode_to_buffer(img, &bmp_header, &dib_header, out_length);
+        stats_add_time(STATS_WRITE, start);
+    }
+    image_destroy(&img);
+    return output;
+}
+
+// Function to name a level of a pyramid
+char* pipeline_level_filename(const char* output_filename, int level) {
+    // The extension starts at the last dot of the file name, if any
+    const char* slash = strrchr(output_filename, '/');
+    const char* dot = strrchr(output_filename, '.');
+    if(dot == NULL || (slash != NULL && dot < slash)) dot = output_filename + strlen(output_filename);
+
+    size_t length = strlen(output_filename) + 16;
+    char* name = (char*)malloc(length);
+    if(name == NULL){
+        perror("Failed to allocate memory for output filename");
+        return NULL;
+    }
+    snprintf(name, length, "%.*s_%lu%s", (int)(dot - output_filename), output_filename, 1ul << level, dot);
+    return name;
+}
+
+// Function to write the levels of a pyramid below a filtered image, each
+// reduced from the one before. An indexed image is expanded first.
+static int write_levels(Image* img, const char* output_filename, int bits, const struct PipelineOptions* options) {
+    if(options->pyramid_levels > 0 && image_is_indexed(img) && !image_expand_palette(img)){
+        // Error message already printed
+        return 0;
+    }
+    Image* level = img;
+    int ok = 1;
+    for(int k = 1; ok && k <= options->pyramid_levels; k++){
+        unsigned long long start = stats_now();
+        Image* next = pyramid_reduce(level);
+        stats_add_time(STATS_RESIZE, start);
+        if(level != img) image_destroy(&level);
+        level = next;
+        char* level_filename = level != NULL ? pipeline_level_filename(output_filename, k) : NULL;
+        if(level_filename == NULL){
+            // Error message already printed
+            ok = 0;
+            break;
+        }
+
+        struct BMP_Header bmp_header;
+        struct DIB_Header dib_header;
+        makeBMPHeader(&bmp_header, level->width, level->height);
+        makeDIBHeader(&dib_header, level->width, level->height);
+        if(bits == 32) setBitCountBMP(&bmp_header, &dib_header, 32);
+        start = stats_now();
+        ok = writeImageBMP(level_filename, &bmp_header, &dib_header, level, options->write_flags);
+        stats_add_time(STATS_WRITE, start);
+        free(level_filename);
+    }
+    if(level != img) image_destroy(&level);
+    return ok;
+}
+
+// Function to tell whether an input is a regular file that can be mapped
+static int input_is_mappable(const char* input_filename) {
+    struct stat st;
+    int found = strcmp(input_filename, BMP_STDIO_NAME) == 0 ? fstat(STDIN_FILENO, &st) == 0 :
+                                                              stat(input_filename, &st) == 0;
+    return found && S_ISREG(st.st_mode);
+}
+
+// Context for copying bands of rows out of a source
+struct LoadBands {
+    const struct BMP_Source* source;
+    Image* img;
+    int flip;
+};
+
+// Function to copy a band of rows out of a source, top-down or in their
+// bottom-up file order
+static void load_band(void* ctx, int begin, int end) {
+    struct LoadBands* job = (struct LoadBands*)ctx;
+    int height = job->source->height;
+    for(int i = begin; i < end; i++){
+        const struct Pixel* src = getSourceRowBMP(job->source, job->flip ? height - 1 - i : i);
+        image_load_row(job->img, i, (const unsigned char*)src, job->source->bits);
+    }
+}
+
+// Function to filter an indexed source and write the result. Point stages
+// only rewrite the palette, so the indices are loaded into an image of their
+// own rather than into the reusable true color buffer. With flip set the
+// rows are loaded mirrored, see filter_chain_split_flip.
+static int process_indexed(struct BMP_Source* source, const char* output_filename, FilterChain* chain,
+                           int flip, const struct PipelineOptions* options) {
+    struct BMP_Header bmp_header = source->bmp_header;
+    struct DIB_Header dib_header = source->dib_header;
+
+    unsigned long long start = stats_now();
+    Image* img = image_create_indexed(source->width, source->height, source->colors);
+    stats_add_time(STATS_ALLOC, start);
+    if(img == NULL){
+        // Error message already printed
+        closeBMPSource(source);
+        return 0;
+    }
+    start = stats_now();
+    if(flip) copyFlippedBMP(source, img);
+    else copyIndexedBMP(source, img);
+    closeBMPSource(source);
+    stats_add_time(STATS_READ, start);
+
+    int ok = filter_chain_apply(chain, img);
+    if(ok && !image_is_indexed(img)){
+        // A filtered resize blended the colors into a true color image
+        makeBMPHeader(&bmp_header, img->width, img->height);
+        makeDIBHeader(&dib_header, img->width, img->height);
+    }
+    if(ok){
+        start = stats_now();
+        ok = writeImageBMP(output_filename, &bmp_header, &dib_header, img, options->write_flags);
+        stats_add_time(STATS_WRITE, start);
+    }
+    if(ok){
+        ok = write_levels(img, output_filename, 24, options);
+    }
+    image_destroy(&img);
+    return ok;
+}
+
+// Function to load an image, apply the filter chain and write the result.
+// The image in *buffer, if any, is reused and the image used is left there.
+static int process_image(const char* input_filename, const char* output_filename, FilterChain* chain,
+                         const struct PipelineOptions* options, Image** buffer) {
+    // Map input file and parse its headers. A pipe is read forward into the
+    // image instead, so its contents are never buffered twice.
+    struct BMP_Source source;
+    struct BMP_Reader reader;
+    int mapped = input_is_mappable(input_filename);
+    unsigned long long start = stats_now();
+    if(mapped ? !openBMPSource(input_filename, &source) : !openBMPReader(input_filename, &reader)){
+        // Error message already printed
+        return 0;
+    }
+    stats_add_time(STATS_HEADERS, start);
+
+    // Point stages run where the image is smallest, and a leading vertical
+    // flip is absorbed by loading the rows in file order
+    FilterChain planned, rest;
+    planner_optimize(chain, mapped ? source.width : reader.width, mapped ? source.height : reader.height, &planned);
+    chain = &planned;
+    int flip = filter_chain_split_flip(chain, &rest);
+    if(flip) chain = &rest;
+    if(mapped && source.bits < 24){
+        return process_indexed(&source, output_filename, chain, flip, options);
+    }
+
+    // The output always has the pixel array right after a 40 byte DIB header
+    struct BMP_Header bmp_header = mapped ? source.bmp_header : reader.bmp_header;
+    struct DIB_Header dib_header = mapped ? source.dib_header : reader.dib_header;
+    normalizeHeadersBMP(&bmp_header, &dib_header);
+    int width = dib_header.biWidth;
+    int height = dib_header.biHeight;
+    int bits = dib_header.biBitCount;
+
+    // Pixels are converted to the layout while they are loaded; a pipe is
+    // read as packed BGR and converted afterwards
+    enum ImageLayout layout = IMAGE_LAYOUT_BGR;
+    if(options->layout != PIPELINE_LAYOUT_AUTO) layout = (enum ImageLayout)options->layout;
+    else if(bits == 32) layout = IMAGE_LAYOUT_BGRX;
+    enum ImageLayout load_layout = mapped ? layout : IMAGE_LAYOUT_BGR;
+
+    // Allocate image with one contiguous pixel buffer, or reuse the previous one
+    start = stats_now();
+    int allocated;
+    if(*buffer != NULL && image_get_layout(*buffer) != load_layout){
+        image_destroy(buffer);
+    }
+    if(*buffer == NULL){
+        *buffer = image_create_layout(width, height, load_layout, options->alloc_flags);
+        allocated = *buffer != NULL;
+    }
+    else{
+        allocated = image_reshape(*buffer, width, height);
+    }
+    stats_add_time(STATS_ALLOC, start);
+    if(!allocated){
+        // Error message already printed
+        if(mapped) closeBMPSource(&source);
+        else closeBMPReader(&reader);
+        return 0;
+    }
+    Image* img = *buffer;
+
+    // Copy pixel data out of the mapping in one pass, or read it in place
+    start = stats_now();
+    int loaded = 1;
+    if(mapped && filter_chain_leading_adjust(chain) >= 0){
+        // The histogram of a leading adjustment is taken while the rows are
+        // copied, and the adjustment becomes a plain lookup table
+        struct LoadBands load = {&source, img, flip};
+        struct Histogram hist;
+        loaded = histogram_load(img, load_band, &load, &hist);
+        closeBMPSource(&source);
+        if(loaded) filter_chain_resolve_adjust(chain, &hist, chain);
+    }
+    else if(mapped){
+        if(flip) copyFlippedBMP(&source, img);
+        else copyPixelsBMP(&source, img);
+        closeBMPSource(&source);
+    }
+    else{
+        loaded = (flip ? readFlippedImageBMP(&reader, img) : readImageBMP(&reader, img)) &&
+                 image_convert_layout(img, layout);
+        closeBMPReader(&reader);
+    }
+    stats_add_time(STATS_READ, start);
+    if(!loaded){
+        // Error message already printed
+        return 0;
+    }
+
+    // Apply all filters in a single fused pass, in parallel row bands; the
+    // chain times its own filter and resize passes
+    int resized = filter_chain_has_resize(chain);
+    if(!filter_chain_apply(chain, img)){
+        // Error message already printed
+        return 0;
+    }
+
+    // Update headers if resized or turned
+    if(resized || img->width != width || img->height != height){
+        // Update BMP and DIB headers
+        makeBMPHeader(&bmp_header, img->width, img->height);
+        makeDIBHeader(&dib_header, img->width, img->height);
+        if(bits == 32) setBitCountBMP(&bmp_header, &dib_header, 32);
+    }
+
+    // Write headers and pixel data in bulk
+    int write_flags = options->write_flags;
+    if(bmp_header.bfSize >= LARGE_OUTPUT_BYTES){
+        write_flags |= BMP_WRITE_FALLOCATE;
+    }
+    start = stats_now();
+    int written = writeImageBMP(output_filename, &bmp_header, &dib_header, img, write_flags);
+    stats_add_time(STATS_WRITE, start);
+    return written && write_levels(img, output_filename, bits, options);
+}
+
+// Function to process one file, whole or strip by strip within a memory budget
+int pipeline_process_file(const char* input_filename, const char* output_filename, FilterChain* chain,
+                          const struct PipelineOptions* options, Image** buffer) {
+    if(options->memory_budget > 0){
+        if(options->pyramid_levels > 0){
+            fprintf(stderr, "Pyramids cannot be streamed.\n");
+            return 0;
+        }
+        return stream_filter_chain(input_filename, output_filename, chain, options->memory_budget,
+                                   options->alloc_flags, options->stream_flags);
+    }
+    return process_image(input_filename, output_filename, chain, options, buffer);
+}
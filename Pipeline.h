@@ -0,0 +1,82 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Pipeline.h
+//
+// Entry points of the image processing library: every source file except
+// StahlImageProcessor.c, BMPBench.c and KernelCheck.c, which only parse
+// options and call in here. make builds it as libstahlimage.a, linked with
+// -lstahlimage -pthread -lm.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include "Image.h"
+#include "BMPHandler.h"
+#include "FilterChain.h"
+
+// Layout option picking BGRX for 32-bit inputs and packed BGR otherwise
+#define PIPELINE_LAYOUT_AUTO -1
+
+// Options for processing files
+struct PipelineOptions {
+    int alloc_flags;       // Allocation flags of pixel buffers, see image_create_ex
+    int write_flags;       // Flags for writing outputs, see writeImageBMP
+    size_t memory_budget;  // Stream files in strips within this many bytes, 0 to load them whole
+    int stream_flags;      // Flags for streaming files, see stream_filter_chain
+    int layout;            // Pixel layout of whole images, an enum ImageLayout or PIPELINE_LAYOUT_AUTO
+    int pyramid_levels;    // Also write this many levels, each half the previous one, see pipeline_level_filename
+};
+
+/* Applies a filter chain to a BMP file held in memory and encodes the result
+ * into a new buffer. The pixels are decoded in place, see
+ * bmp_decode_from_buffer, so the input buffer is overwritten by the filters
+ * unless the chain starts with a resize.
+ *
+ * @param  data: the input file contents.
+ * @param  length: length of the input in bytes.
+ * @param  chain: the filter chain.
+ * @param  out_length: receives the length of the output.
+ * @return The output file contents, to be released with bmp_buffer_free, or
+ *         NULL on failure.
+*/
+unsigned char* pipeline_process_buffer(unsigned char* data, size_t length, FilterChain* chain, size_t* out_length);
+
+/* Returns the name of a level of a pyramid written next to an output:
+ * the output name with _<divisor> inserted before its extension, so level
+ * 2 of photo_copy.bmp is photo_copy_4.bmp, a quarter of its size per side.
+ *
+ * @param  output_filename: name of the full size output.
+ * @param  level: the level, 1 for half the size.
+ * @return The name, to be released with free, or NULL on failure.
+*/
+char* pipeline_level_filename(const char* output_filename, int level);
+
+/* Applies a filter chain to a BMP file and writes the result to another
+ * file: whole, through a mapping of the input and one contiguous image, or
+ * strip by strip when options->memory_budget is set. With
+ * options->pyramid_levels set, the filtered image is then halved that many
+ * times with pyramid_reduce, each level from the one before, and every
+ * level written as a 24-bit file, or a 32-bit one for a 32-bit input, named
+ * by pipeline_level_filename. Pyramids are not streamed.
+ *
+ * @param  input_filename: name of the BMP file to read.
+ * @param  output_filename: name of the BMP file to write.
+ * @param  chain: the filter chain.
+ * @param  options: allocation, write and streaming options.
+ * @param  buffer: an image to reuse, or NULL; receives the image used so it
+ *                 can be reused for the next file, and must be destroyed by
+ *                 the caller.
+ * @return 1 on success, 0 on failure.
+*/
+int pipeline_process_file(const char* input_filename, const char* output_filename, FilterChain* chain,
+                          const struct PipelineOptions* options, Image** buffer);
+
+#endif // PIPELINE_H
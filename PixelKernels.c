@@ -0,0 +1,942 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// PixelKernels.c
+
+#include "PixelKernels.h"
+#include "PointOps.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Rounding term of a resampling accumulator
+#define WEIGHT_ROUND (1 << (PIXEL_WEIGHT_BITS - 1))
+
+// Kernel set in use, selected on first use
+static const struct PixelKernels* active_kernels = NULL;
+static pthread_once_t active_kernels_once = PTHREAD_ONCE_INIT;
+
+// Helper function to clamp a shift to the range a saturating byte add can express
+static unsigned char shift_magnitude(int shift) {
+    if(shift < 0) shift = -shift;
+    return shift > 255 ? 255 : (unsigned char)shift;
+}
+
+// Helper function to clamp color values
+static unsigned char clamp(int value) {
+    if(value < 0) return 0;
+    if(value > 255) return 255;
+    return (unsigned char)value;
+}
+
+// Scalar reference kernel for grayscale
+static void luma_scalar(struct Pixel* pixels, int count, const unsigned char* ties) {
+    for(int j = 0; j < count; j++){
+        struct Pixel* p = &pixels[j];
+        unsigned char y = pixel_luma_fixed(ties, p->red, p->green, p->blue);
+        p->red = y;
+        p->green = y;
+        p->blue = y;
+    }
+}
+
+// Scalar reference kernel for grayscale of BGRX pixels
+static void luma_bgrx_scalar(unsigned char* pixels, int count, const unsigned char* ties) {
+    for(int j = 0; j < count; j++){
+        unsigned char* p = pixels + 4 * j;
+        unsigned char y = pixel_luma_fixed(ties, p[2], p[1], p[0]);
+        p[0] = y;
+        p[1] = y;
+        p[2] = y;
+    }
+}
+
+// Scalar reference kernel for grayscale of planar pixels
+static void luma_planar_scalar(unsigned char* blue, unsigned char* green, unsigned char* red, int count,
+                               const unsigned char* ties) {
+    for(int j = 0; j < count; j++){
+        unsigned char y = pixel_luma_fixed(ties, red[j], green[j], blue[j]);
+        blue[j] = y;
+        green[j] = y;
+        red[j] = y;
+    }
+}
+
+// Scalar reference kernel for color shift
+static void shift_scalar(struct Pixel* pixels, int count, int rShift, int gShift, int bShift) {
+    for(int j = 0; j < count; j++){
+        struct Pixel* p = &pixels[j];
+        p->red = clamp(p->red + rShift);
+        p->green = clamp(p->green + gShift);
+        p->blue = clamp(p->blue + bShift);
+    }
+}
+
+// Scalar reference kernel for a shift with a 4-byte pattern
+static void shift_bytes_scalar(unsigned char* bytes, int length, const unsigned char* add, const unsigned char* sub) {
+    for(int i = 0; i < length; i++){
+        bytes[i] = clamp(clamp(bytes[i] + add[i & 3]) - sub[i & 3]);
+    }
+}
+
+// Helper function to turn a resampling accumulator into a byte
+static inline unsigned char weighted_byte(int acc) {
+    if(acc < 0) return 0;
+    acc >>= PIXEL_WEIGHT_BITS;
+    return acc > 255 ? 255 : (unsigned char)acc;
+}
+
+// Helper function to filter one output pixel of a row
+static inline void resample_pixel(const struct Pixel* p, int count, const short* w, struct Pixel* out) {
+    int b = WEIGHT_ROUND, g = WEIGHT_ROUND, r = WEIGHT_ROUND;
+    for(int t = 0; t < count; t++){
+        b += w[t] * p[t].blue;
+        g += w[t] * p[t].green;
+        r += w[t] * p[t].red;
+    }
+    out->blue = weighted_byte(b);
+    out->green = weighted_byte(g);
+    out->red = weighted_byte(r);
+}
+
+// Scalar reference kernel for horizontal resampling
+static void resample_row_scalar(const struct Pixel* src, int width, struct Pixel* out, int length,
+                                const int* start, const int* count, const short* weights, int taps) {
+    (void)width;
+    for(int j = 0; j < length; j++){
+        resample_pixel(src + start[j], count[j], &weights[(size_t)j * taps], &out[j]);
+    }
+}
+
+// Function to blend the bytes begin .. end - 1 of rows
+static void blend_range(unsigned char* out, const unsigned char* const* rows, const short* weights,
+                        int count, int begin, int end) {
+    // Blocks of bytes at a time, so the inner loop is a plain multiply-add over a row
+    enum { BLOCK = 256 };
+    int acc[BLOCK];
+    for(int b0 = begin; b0 < end; b0 += BLOCK){
+        int n = end - b0 < BLOCK ? end - b0 : BLOCK;
+        for(int b = 0; b < n; b++) acc[b] = WEIGHT_ROUND;
+        for(int t = 0; t < count; t++){
+            const unsigned char* row = rows[t] + b0;
+            int weight = weights[t];
+            for(int b = 0; b < n; b++) acc[b] += weight * row[b];
+        }
+        for(int b = 0; b < n; b++) out[b0 + b] = weighted_byte(acc[b]);
+    }
+}
+
+// Scalar reference kernel for vertical resampling
+static void blend_rows_scalar(unsigned char* out, const unsigned char* const* rows, const short* weights,
+                              int count, int bytes) {
+    blend_range(out, rows, weights, count, 0, bytes);
+}
+
+// Helper function to put two weights in the 16 bit halves of a 32 bit lane, as _mm_madd_epi16 pairs them
+static inline int weight_pair(short first, short second) {
+    return (int)(((unsigned int)(unsigned short)second << 16) | (unsigned short)first);
+}
+
+// Function to build the per-byte add and subtract patterns of a shift.
+// Byte i of a run of pixels belongs to channel i % 3 (blue, green, red).
+static void build_shift_patterns(unsigned char* add, unsigned char* sub, int length, int rShift, int gShift, int bShift) {
+    int shifts[3] = {bShift, gShift, rShift};
+    for(int i = 0; i < length; i++){
+        int s = shifts[i % 3];
+        add[i] = s > 0 ? shift_magnitude(s) : 0;
+        sub[i] = s < 0 ? shift_magnitude(s) : 0;
+    }
+}
+
+#ifdef PIXEL_KERNELS_X86
+
+// Shuffle masks that gather one channel of 16 BGR pixels out of three 16
+// byte vectors, and that spread 16 gray bytes back into 48 BGR bytes
+static unsigned char deinterleave_masks[3][3][16]; // [channel][source vector][byte]
+static unsigned char interleave_masks[3][16];      // [destination vector][byte]
+
+// The same for 16 BGRX pixels in four vectors; the spread leaves the fourth
+// byte of every pixel zero, to be merged back from the source
+static unsigned char bgrx_deinterleave_masks[3][4][16]; // [channel][source vector][byte]
+static unsigned char bgrx_interleave_masks[4][16];      // [destination vector][byte]
+
+// Function to build the shuffle masks
+static void build_shuffle_masks(void) {
+    for(int c = 0; c < 3; c++){
+        for(int v = 0; v < 3; v++){
+            for(int k = 0; k < 16; k++){
+                int byte = 3 * k + c - 16 * v;
+                deinterleave_masks[c][v][k] = (byte >= 0 && byte < 16) ? (unsigned char)byte : 0x80;
+            }
+        }
+    }
+    for(int v = 0; v < 3; v++){
+        for(int i = 0; i < 16; i++){
+            interleave_masks[v][i] = (unsigned char)((16 * v + i) / 3);
+        }
+    }
+    for(int v = 0; v < 4; v++){
+        for(int k = 0; k < 16; k++){
+            for(int c = 0; c < 3; c++){
+                bgrx_deinterleave_masks[c][v][k] = k / 4 == v ? (unsigned char)(4 * (k % 4) + c) : 0x80;
+            }
+            bgrx_interleave_masks[v][k] = k % 4 == 3 ? 0x80 : (unsigned char)(4 * v + k / 4);
+        }
+    }
+}
+
+// SSE2 kernel for color shift, 16 pixels (48 bytes) per iteration
+__attribute__((target("sse2")))
+static void shift_sse2(struct Pixel* pixels, int count, int rShift, int gShift, int bShift) {
+    unsigned char add[48], sub[48];
+    build_shift_patterns(add, sub, 48, rShift, gShift, bShift);
+    __m128i add0 = _mm_loadu_si128((const __m128i*)add);
+    __m128i add1 = _mm_loadu_si128((const __m128i*)(add + 16));
+    __m128i add2 = _mm_loadu_si128((const __m128i*)(add + 32));
+    __m128i sub0 = _mm_loadu_si128((const __m128i*)sub);
+    __m128i sub1 = _mm_loadu_si128((const __m128i*)(sub + 16));
+    __m128i sub2 = _mm_loadu_si128((const __m128i*)(sub + 32));
+
+    unsigned char* p = (unsigned char*)pixels;
+    int j = 0;
+    for(; j + 16 <= count; j += 16, p += 48){
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(p + 32));
+        a = _mm_subs_epu8(_mm_adds_epu8(a, add0), sub0);
+        b = _mm_subs_epu8(_mm_adds_epu8(b, add1), sub1);
+        c = _mm_subs_epu8(_mm_adds_epu8(c, add2), sub2);
+        _mm_storeu_si128((__m128i*)p, a);
+        _mm_storeu_si128((__m128i*)(p + 16), b);
+        _mm_storeu_si128((__m128i*)(p + 32), c);
+    }
+    shift_scalar(pixels + j, count - j, rShift, gShift, bShift);
+}
+
+// AVX2 kernel for color shift, 32 pixels (96 bytes) per iteration
+__attribute__((target("avx2")))
+static void shift_avx2(struct Pixel* pixels, int count, int rShift, int gShift, int bShift) {
+    unsigned char add[96], sub[96];
+    build_shift_patterns(add, sub, 96, rShift, gShift, bShift);
+    __m256i add0 = _mm256_loadu_si256((const __m256i*)add);
+    __m256i add1 = _mm256_loadu_si256((const __m256i*)(add + 32));
+    __m256i add2 = _mm256_loadu_si256((const __m256i*)(add + 64));
+    __m256i sub0 = _mm256_loadu_si256((const __m256i*)sub);
+    __m256i sub1 = _mm256_loadu_si256((const __m256i*)(sub + 32));
+    __m256i sub2 = _mm256_loadu_si256((const __m256i*)(sub + 64));
+
+    unsigned char* p = (unsigned char*)pixels;
+    int j = 0;
+    for(; j + 32 <= count; j += 32, p += 96){
+        __m256i a = _mm256_loadu_si256((const __m256i*)p);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(p + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(p + 64));
+        a = _mm256_subs_epu8(_mm256_adds_epu8(a, add0), sub0);
+        b = _mm256_subs_epu8(_mm256_adds_epu8(b, add1), sub1);
+        c = _mm256_subs_epu8(_mm256_adds_epu8(c, add2), sub2);
+        _mm256_storeu_si256((__m256i*)p, a);
+        _mm256_storeu_si256((__m256i*)(p + 32), b);
+        _mm256_storeu_si256((__m256i*)(p + 64), c);
+    }
+    shift_scalar(pixels + j, count - j, rShift, gShift, bShift);
+}
+
+// SSE2 kernel for a shift with a 4-byte pattern, 64 bytes per iteration
+__attribute__((target("sse2")))
+static void shift_bytes_sse2(unsigned char* bytes, int length, const unsigned char* add, const unsigned char* sub) {
+    int add4, sub4;
+    memcpy(&add4, add, 4);
+    memcpy(&sub4, sub, 4);
+    __m128i va = _mm_set1_epi32(add4);
+    __m128i vs = _mm_set1_epi32(sub4);
+    int i = 0;
+    for(; i + 64 <= length; i += 64){
+        for(int k = 0; k < 64; k += 16){
+            __m128i a = _mm_loadu_si128((const __m128i*)(bytes + i + k));
+            _mm_storeu_si128((__m128i*)(bytes + i + k), _mm_subs_epu8(_mm_adds_epu8(a, va), vs));
+        }
+    }
+    for(; i + 16 <= length; i += 16){
+        __m128i a = _mm_loadu_si128((const __m128i*)(bytes + i));
+        _mm_storeu_si128((__m128i*)(bytes + i), _mm_subs_epu8(_mm_adds_epu8(a, va), vs));
+    }
+    shift_bytes_scalar(bytes + i, length - i, add, sub);
+}
+
+// AVX2 kernel for a shift with a 4-byte pattern, 128 bytes per iteration
+__attribute__((target("avx2")))
+static void shift_bytes_avx2(unsigned char* bytes, int length, const unsigned char* add, const unsigned char* sub) {
+    int add4, sub4;
+    memcpy(&add4, add, 4);
+    memcpy(&sub4, sub, 4);
+    __m256i va = _mm256_set1_epi32(add4);
+    __m256i vs = _mm256_set1_epi32(sub4);
+    int i = 0;
+    for(; i + 128 <= length; i += 128){
+        for(int k = 0; k < 128; k += 32){
+            __m256i a = _mm256_loadu_si256((const __m256i*)(bytes + i + k));
+            _mm256_storeu_si256((__m256i*)(bytes + i + k), _mm256_subs_epu8(_mm256_adds_epu8(a, va), vs));
+        }
+    }
+    for(; i + 32 <= length; i += 32){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(bytes + i));
+        _mm256_storeu_si256((__m256i*)(bytes + i), _mm256_subs_epu8(_mm256_adds_epu8(a, va), vs));
+    }
+    shift_bytes_scalar(bytes + i, length - i, add, sub);
+}
+
+// Function to fix up the lanes of a block whose luma hit a tie
+static void fix_luma_ties(unsigned char* gray, const unsigned char* red, const unsigned char* green,
+                          unsigned int mask, const unsigned char* ties) {
+    while(mask){
+        int k = __builtin_ctz(mask);
+        gray[k] -= ties[(red[k] << 8) | green[k]];
+        mask &= mask - 1;
+    }
+}
+
+// Helper to compute the gray values of 16 pixels given as channel vectors:
+// forms t = 299r + 587g + 114b with pmaddwd, divides by 1000 as
+// (t >> 3) * 33555 >> 22 and fixes up the lanes that hit a tie
+__attribute__((target("sse2")))
+static inline __m128i gray_sse2(__m128i blue, __m128i green, __m128i red, const unsigned char* ties) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w_rg = _mm_set1_epi32((587 << 16) | 299);
+    const __m128i w_b = _mm_set1_epi32(114);
+    const __m128i recip = _mm_set1_epi16((short)33555);
+    const __m128i c125 = _mm_set1_epi16(125);
+    const __m128i c7 = _mm_set1_epi32(7);
+    __m128i b16[2] = {_mm_unpacklo_epi8(blue, zero), _mm_unpackhi_epi8(blue, zero)};
+    __m128i g16[2] = {_mm_unpacklo_epi8(green, zero), _mm_unpackhi_epi8(green, zero)};
+    __m128i r16[2] = {_mm_unpacklo_epi8(red, zero), _mm_unpackhi_epi8(red, zero)};
+
+    __m128i q16[2], tie16[2];
+    for(int h = 0; h < 2; h++){
+        __m128i t_lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r16[h], g16[h]), w_rg),
+                                     _mm_madd_epi16(_mm_unpacklo_epi16(b16[h], zero), w_b));
+        __m128i t_hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r16[h], g16[h]), w_rg),
+                                     _mm_madd_epi16(_mm_unpackhi_epi16(b16[h], zero), w_b));
+        __m128i u = _mm_packs_epi32(_mm_srli_epi32(t_lo, 3), _mm_srli_epi32(t_hi, 3));
+        __m128i m = _mm_packs_epi32(_mm_and_si128(t_lo, c7), _mm_and_si128(t_hi, c7));
+        q16[h] = _mm_srli_epi16(_mm_mulhi_epu16(u, recip), 6);
+        tie16[h] = _mm_and_si128(_mm_cmpeq_epi16(_mm_mullo_epi16(q16[h], c125), u), _mm_cmpeq_epi16(m, zero));
+    }
+    __m128i gray = _mm_packus_epi16(q16[0], q16[1]);
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_packs_epi16(tie16[0], tie16[1]));
+    if(mask){
+        unsigned char g8[16], r8[16], y8[16];
+        _mm_storeu_si128((__m128i*)y8, gray);
+        _mm_storeu_si128((__m128i*)r8, red);
+        _mm_storeu_si128((__m128i*)g8, green);
+        fix_luma_ties(y8, r8, g8, mask, ties);
+        gray = _mm_loadu_si128((const __m128i*)y8);
+    }
+    return gray;
+}
+
+// SSSE3 kernel for grayscale, 16 pixels (48 bytes) per iteration.
+// Deinterleaves B, G and R with pshufb and re-interleaves the gray values.
+__attribute__((target("ssse3")))
+static void luma_ssse3(struct Pixel* pixels, int count, const unsigned char* ties) {
+    __m128i dm[3][3], im[3];
+    for(int c = 0; c < 3; c++){
+        for(int v = 0; v < 3; v++) dm[c][v] = _mm_loadu_si128((const __m128i*)deinterleave_masks[c][v]);
+        im[c] = _mm_loadu_si128((const __m128i*)interleave_masks[c]);
+    }
+
+    unsigned char* p = (unsigned char*)pixels;
+    int j = 0;
+    for(; j + 16 <= count; j += 16, p += 48){
+        __m128i v0 = _mm_loadu_si128((const __m128i*)p);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(p + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(p + 32));
+        __m128i ch[3];
+        for(int c = 0; c < 3; c++){
+            ch[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, dm[c][0]), _mm_shuffle_epi8(v1, dm[c][1])),
+                                 _mm_shuffle_epi8(v2, dm[c][2]));
+        }
+        __m128i gray = gray_sse2(ch[0], ch[1], ch[2], ties);
+        _mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(gray, im[0]));
+        _mm_storeu_si128((__m128i*)(p + 16), _mm_shuffle_epi8(gray, im[1]));
+        _mm_storeu_si128((__m128i*)(p + 32), _mm_shuffle_epi8(gray, im[2]));
+    }
+    luma_scalar(pixels + j, count - j, ties);
+}
+
+// SSSE3 kernel for grayscale of BGRX pixels, 16 pixels (64 bytes) per
+// iteration. The fourth bytes are kept.
+__attribute__((target("ssse3")))
+static void luma_bgrx_ssse3(unsigned char* pixels, int count, const unsigned char* ties) {
+    const __m128i keep = _mm_set1_epi32((int)0xFF000000u);
+    __m128i dm[3][4], im[4];
+    for(int v = 0; v < 4; v++){
+        for(int c = 0; c < 3; c++) dm[c][v] = _mm_loadu_si128((const __m128i*)bgrx_deinterleave_masks[c][v]);
+        im[v] = _mm_loadu_si128((const __m128i*)bgrx_interleave_masks[v]);
+    }
+
+    unsigned char* p = pixels;
+    int j = 0;
+    for(; j + 16 <= count; j += 16, p += 64){
+        __m128i v[4];
+        for(int k = 0; k < 4; k++) v[k] = _mm_loadu_si128((const __m128i*)(p + 16 * k));
+        __m128i ch[3];
+        for(int c = 0; c < 3; c++){
+            ch[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v[0], dm[c][0]), _mm_shuffle_epi8(v[1], dm[c][1])),
+                                 _mm_or_si128(_mm_shuffle_epi8(v[2], dm[c][2]), _mm_shuffle_epi8(v[3], dm[c][3])));
+        }
+        __m128i gray = gray_sse2(ch[0], ch[1], ch[2], ties);
+        for(int k = 0; k < 4; k++){
+            __m128i out = _mm_or_si128(_mm_shuffle_epi8(gray, im[k]), _mm_and_si128(v[k], keep));
+            _mm_storeu_si128((__m128i*)(p + 16 * k), out);
+        }
+    }
+    luma_bgrx_scalar(pixels + 4 * j, count - j, ties);
+}
+
+// SSE2 kernel for grayscale of planar pixels, 16 pixels per iteration; the
+// planes need no shuffles
+__attribute__((target("sse2")))
+static void luma_planar_sse2(unsigned char* blue, unsigned char* green, unsigned char* red, int count,
+                             const unsigned char* ties) {
+    int j = 0;
+    for(; j + 16 <= count; j += 16){
+        __m128i gray = gray_sse2(_mm_loadu_si128((const __m128i*)(blue + j)),
+                                 _mm_loadu_si128((const __m128i*)(green + j)),
+                                 _mm_loadu_si128((const __m128i*)(red + j)), ties);
+        _mm_storeu_si128((__m128i*)(blue + j), gray);
+        _mm_storeu_si128((__m128i*)(green + j), gray);
+        _mm_storeu_si128((__m128i*)(red + j), gray);
+    }
+    luma_planar_scalar(blue + j, green + j, red + j, count - j, ties);
+}
+
+// Helper to load two 16 byte blocks into the low and high lane of a vector
+__attribute__((target("avx2")))
+static inline __m256i load_lanes(const unsigned char* lo, const unsigned char* hi) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)lo)),
+                                   _mm_loadu_si128((const __m128i*)hi), 1);
+}
+
+// Helper to compute the gray values of 32 pixels given as channel vectors,
+// as gray_sse2 does in each 128 bit lane
+__attribute__((target("avx2")))
+static inline __m256i gray_avx2(__m256i blue, __m256i green, __m256i red, const unsigned char* ties) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i w_rg = _mm256_set1_epi32((587 << 16) | 299);
+    const __m256i w_b = _mm256_set1_epi32(114);
+    const __m256i recip = _mm256_set1_epi16((short)33555);
+    const __m256i c125 = _mm256_set1_epi16(125);
+    const __m256i c7 = _mm256_set1_epi32(7);
+    __m256i b16[2] = {_mm256_unpacklo_epi8(blue, zero), _mm256_unpackhi_epi8(blue, zero)};
+    __m256i g16[2] = {_mm256_unpacklo_epi8(green, zero), _mm256_unpackhi_epi8(green, zero)};
+    __m256i r16[2] = {_mm256_unpacklo_epi8(red, zero), _mm256_unpackhi_epi8(red, zero)};
+
+    __m256i q16[2], tie16[2];
+    for(int h = 0; h < 2; h++){
+        __m256i t_lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r16[h], g16[h]), w_rg),
+                                        _mm256_madd_epi16(_mm256_unpacklo_epi16(b16[h], zero), w_b));
+        __m256i t_hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r16[h], g16[h]), w_rg),
+                                        _mm256_madd_epi16(_mm256_unpackhi_epi16(b16[h], zero), w_b));
+        __m256i u = _mm256_packs_epi32(_mm256_srli_epi32(t_lo, 3), _mm256_srli_epi32(t_hi, 3));
+        __m256i m = _mm256_packs_epi32(_mm256_and_si256(t_lo, c7), _mm256_and_si256(t_hi, c7));
+        q16[h] = _mm256_srli_epi16(_mm256_mulhi_epu16(u, recip), 6);
+        tie16[h] = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_mullo_epi16(q16[h], c125), u),
+                                    _mm256_cmpeq_epi16(m, zero));
+    }
+    __m256i gray = _mm256_packus_epi16(q16[0], q16[1]);
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_packs_epi16(tie16[0], tie16[1]));
+    if(mask){
+        unsigned char g8[32], r8[32], y8[32];
+        _mm256_storeu_si256((__m256i*)y8, gray);
+        _mm256_storeu_si256((__m256i*)r8, red);
+        _mm256_storeu_si256((__m256i*)g8, green);
+        fix_luma_ties(y8, r8, g8, mask, ties);
+        gray = _mm256_loadu_si256((const __m256i*)y8);
+    }
+    return gray;
+}
+
+// AVX2 kernel for grayscale, 32 pixels (96 bytes) per iteration. Each 128
+// bit lane runs the SSSE3 algorithm on its own block of 16 pixels, since
+// vpshufb does not cross lanes.
+__attribute__((target("avx2")))
+static void luma_avx2(struct Pixel* pixels, int count, const unsigned char* ties) {
+    __m256i dm[3][3], im[3];
+    for(int c = 0; c < 3; c++){
+        for(int v = 0; v < 3; v++) dm[c][v] = load_lanes(deinterleave_masks[c][v], deinterleave_masks[c][v]);
+        im[c] = load_lanes(interleave_masks[c], interleave_masks[c]);
+    }
+
+    unsigned char* p = (unsigned char*)pixels;
+    int j = 0;
+    for(; j + 32 <= count; j += 32, p += 96){
+        // Lane 0 holds pixels 0-15, lane 1 holds pixels 16-31
+        __m256i v0 = load_lanes(p, p + 48);
+        __m256i v1 = load_lanes(p + 16, p + 64);
+        __m256i v2 = load_lanes(p + 32, p + 80);
+        __m256i ch[3];
+        for(int c = 0; c < 3; c++){
+            ch[c] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v0, dm[c][0]), _mm256_shuffle_epi8(v1, dm[c][1])),
+                                    _mm256_shuffle_epi8(v2, dm[c][2]));
+        }
+        __m256i gray = gray_avx2(ch[0], ch[1], ch[2], ties);
+        __m256i o0 = _mm256_shuffle_epi8(gray, im[0]);
+        __m256i o1 = _mm256_shuffle_epi8(gray, im[1]);
+        __m256i o2 = _mm256_shuffle_epi8(gray, im[2]);
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(o0));
+        _mm_storeu_si128((__m128i*)(p + 16), _mm256_castsi256_si128(o1));
+        _mm_storeu_si128((__m128i*)(p + 32), _mm256_castsi256_si128(o2));
+        _mm_storeu_si128((__m128i*)(p + 48), _mm256_extracti128_si256(o0, 1));
+        _mm_storeu_si128((__m128i*)(p + 64), _mm256_extracti128_si256(o1, 1));
+        _mm_storeu_si128((__m128i*)(p + 80), _mm256_extracti128_si256(o2, 1));
+    }
+    luma_scalar(pixels + j, count - j, ties);
+}
+
+// AVX2 kernel for grayscale of BGRX pixels, 32 pixels (128 bytes) per
+// iteration, 16 in each lane. The fourth bytes are kept.
+__attribute__((target("avx2")))
+static void luma_bgrx_avx2(unsigned char* pixels, int count, const unsigned char* ties) {
+    const __m256i keep = _mm256_set1_epi32((int)0xFF000000u);
+    __m256i dm[3][4], im[4];
+    for(int v = 0; v < 4; v++){
+        for(int c = 0; c < 3; c++) dm[c][v] = load_lanes(bgrx_deinterleave_masks[c][v], bgrx_deinterleave_masks[c][v]);
+        im[v] = load_lanes(bgrx_interleave_masks[v], bgrx_interleave_masks[v]);
+    }
+
+    unsigned char* p = pixels;
+    int j = 0;
+    for(; j + 32 <= count; j += 32, p += 128){
+        // Lane 0 holds pixels 0-15, lane 1 holds pixels 16-31
+        __m256i v[4];
+        for(int k = 0; k < 4; k++) v[k] = load_lanes(p + 16 * k, p + 64 + 16 * k);
+        __m256i ch[3];
+        for(int c = 0; c < 3; c++){
+            ch[c] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v[0], dm[c][0]), _mm256_shuffle_epi8(v[1], dm[c][1])),
+                                    _mm256_or_si256(_mm256_shuffle_epi8(v[2], dm[c][2]), _mm256_shuffle_epi8(v[3], dm[c][3])));
+        }
+        __m256i gray = gray_avx2(ch[0], ch[1], ch[2], ties);
+        for(int k = 0; k < 4; k++){
+            __m256i out = _mm256_or_si256(_mm256_shuffle_epi8(gray, im[k]), _mm256_and_si256(v[k], keep));
+            _mm_storeu_si128((__m128i*)(p + 16 * k), _mm256_castsi256_si128(out));
+            _mm_storeu_si128((__m128i*)(p + 64 + 16 * k), _mm256_extracti128_si256(out, 1));
+        }
+    }
+    luma_bgrx_scalar(pixels + 4 * j, count - j, ties);
+}
+
+// AVX2 kernel for grayscale of planar pixels, 32 pixels per iteration
+__attribute__((target("avx2")))
+static void luma_planar_avx2(unsigned char* blue, unsigned char* green, unsigned char* red, int count,
+                             const unsigned char* ties) {
+    int j = 0;
+    for(; j + 32 <= count; j += 32){
+        __m256i gray = gray_avx2(_mm256_loadu_si256((const __m256i*)(blue + j)),
+                                 _mm256_loadu_si256((const __m256i*)(green + j)),
+                                 _mm256_loadu_si256((const __m256i*)(red + j)), ties);
+        _mm256_storeu_si256((__m256i*)(blue + j), gray);
+        _mm256_storeu_si256((__m256i*)(green + j), gray);
+        _mm256_storeu_si256((__m256i*)(red + j), gray);
+    }
+    luma_planar_scalar(blue + j, green + j, red + j, count - j, ties);
+}
+
+// SSSE3 kernel for horizontal resampling, two taps per multiply-add. The
+// channels of two neighbouring pixels are spread into 16 bit pairs so that
+// one _mm_madd_epi16 weighs and sums both taps of all three channels.
+__attribute__((target("ssse3")))
+static void resample_row_ssse3(const struct Pixel* src, int width, struct Pixel* out, int length,
+                               const int* start, const int* count, const short* weights, int taps) {
+    const __m128i spread = _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+    const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+    const __m128i zero = _mm_setzero_si128();
+    for(int j = 0; j < length; j++){
+        const struct Pixel* p = src + start[j];
+        const short* w = &weights[(size_t)j * taps];
+        int pairs = (count[j] + 1) / 2;
+        // Each pair loads 8 bytes, the last pixels of a row are done one at a time
+        if(3 * (start[j] + 2 * pairs) + 2 > 3 * width){
+            resample_pixel(p, count[j], w, &out[j]);
+            continue;
+        }
+        __m128i acc = round;
+        for(int k = 0; k < pairs; k++){
+            __m128i v = _mm_loadl_epi64((const __m128i*)((const unsigned char*)p + 6 * k));
+            __m128i pair = _mm_set1_epi32(weight_pair(w[2 * k], w[2 * k + 1]));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_shuffle_epi8(v, spread), pair));
+        }
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(_mm_srai_epi32(acc, PIXEL_WEIGHT_BITS), zero), zero);
+        unsigned int bgr = (unsigned int)_mm_cvtsi128_si32(bytes);
+        out[j].blue = (unsigned char)bgr;
+        out[j].green = (unsigned char)(bgr >> 8);
+        out[j].red = (unsigned char)(bgr >> 16);
+    }
+}
+
+// AVX2 kernel for horizontal resampling, four taps per multiply-add: the
+// low lane weighs the first two taps of a group and the high lane the other two
+__attribute__((target("avx2")))
+static void resample_row_avx2(const struct Pixel* src, int width, struct Pixel* out, int length,
+                              const int* start, const int* count, const short* weights, int taps) {
+    const __m256i spread = _mm256_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1,
+                                            6, -1, 9, -1, 7, -1, 10, -1, 8, -1, 11, -1, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+    const __m128i zero = _mm_setzero_si128();
+    for(int j = 0; j < length; j++){
+        const struct Pixel* p = src + start[j];
+        const short* w = &weights[(size_t)j * taps];
+        int groups = (count[j] + 3) / 4;
+        // Each group loads 16 bytes, the last pixels of a row are done one at a time
+        if(3 * (start[j] + 4 * groups) + 4 > 3 * width){
+            resample_pixel(p, count[j], w, &out[j]);
+            continue;
+        }
+        __m256i acc = _mm256_setzero_si256();
+        for(int k = 0; k < groups; k++){
+            __m256i v = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)((const unsigned char*)p + 12 * k)));
+            __m256i pairs = _mm256_permutevar8x32_epi32(
+                _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(w + 4 * k))), lanes);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_shuffle_epi8(v, spread), pairs));
+        }
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)), round);
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(_mm_srai_epi32(sum, PIXEL_WEIGHT_BITS), zero), zero);
+        unsigned int bgr = (unsigned int)_mm_cvtsi128_si32(bytes);
+        out[j].blue = (unsigned char)bgr;
+        out[j].green = (unsigned char)(bgr >> 8);
+        out[j].red = (unsigned char)(bgr >> 16);
+    }
+}
+
+// SSE2 kernel for vertical resampling, 16 bytes and two rows per multiply-add
+__attribute__((target("sse2")))
+static void blend_rows_sse2(unsigned char* out, const unsigned char* const* rows, const short* weights,
+                            int count, int bytes) {
+    const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+    const __m128i zero = _mm_setzero_si128();
+    int b = 0;
+    for(; b + 16 <= bytes; b += 16){
+        __m128i a0 = round, a1 = round, a2 = round, a3 = round;
+        for(int t = 0; t < count; t += 2){
+            // An odd last row is paired with itself at weight zero
+            const unsigned char* second = t + 1 < count ? rows[t + 1] : rows[t];
+            __m128i pair = _mm_set1_epi32(weight_pair(weights[t], weights[t + 1]));
+            __m128i u = _mm_loadu_si128((const __m128i*)(rows[t] + b));
+            __m128i v = _mm_loadu_si128((const __m128i*)(second + b));
+            __m128i ulo = _mm_unpacklo_epi8(u, zero), uhi = _mm_unpackhi_epi8(u, zero);
+            __m128i vlo = _mm_unpacklo_epi8(v, zero), vhi = _mm_unpackhi_epi8(v, zero);
+            a0 = _mm_add_epi32(a0, _mm_madd_epi16(_mm_unpacklo_epi16(ulo, vlo), pair));
+            a1 = _mm_add_epi32(a1, _mm_madd_epi16(_mm_unpackhi_epi16(ulo, vlo), pair));
+            a2 = _mm_add_epi32(a2, _mm_madd_epi16(_mm_unpacklo_epi16(uhi, vhi), pair));
+            a3 = _mm_add_epi32(a3, _mm_madd_epi16(_mm_unpackhi_epi16(uhi, vhi), pair));
+        }
+        // Negative sums saturate to 0 and large ones to 255, as in weighted_byte
+        __m128i lo = _mm_packs_epi32(_mm_srai_epi32(a0, PIXEL_WEIGHT_BITS), _mm_srai_epi32(a1, PIXEL_WEIGHT_BITS));
+        __m128i hi = _mm_packs_epi32(_mm_srai_epi32(a2, PIXEL_WEIGHT_BITS), _mm_srai_epi32(a3, PIXEL_WEIGHT_BITS));
+        _mm_storeu_si128((__m128i*)(out + b), _mm_packus_epi16(lo, hi));
+    }
+    blend_range(out, rows, weights, count, b, bytes);
+}
+
+// AVX2 kernel for vertical resampling, 32 bytes and two rows per multiply-add.
+// Unpacking and packing both work within 128 bit lanes, so bytes stay in order.
+__attribute__((target("avx2")))
+static void blend_rows_avx2(unsigned char* out, const unsigned char* const* rows, const short* weights,
+                            int count, int bytes) {
+    const __m256i round = _mm256_set1_epi32(WEIGHT_ROUND);
+    const __m256i zero = _mm256_setzero_si256();
+    int b = 0;
+    for(; b + 32 <= bytes; b += 32){
+        __m256i a0 = round, a1 = round, a2 = round, a3 = round;
+        for(int t = 0; t < count; t += 2){
+            const unsigned char* second = t + 1 < count ? rows[t + 1] : rows[t];
+            __m256i pair = _mm256_set1_epi32(weight_pair(weights[t], weights[t + 1]));
+            __m256i u = _mm256_loadu_si256((const __m256i*)(rows[t] + b));
+            __m256i v = _mm256_loadu_si256((const __m256i*)(second + b));
+            __m256i ulo = _mm256_unpacklo_epi8(u, zero), uhi = _mm256_unpackhi_epi8(u, zero);
+            __m256i vlo = _mm256_unpacklo_epi8(v, zero), vhi = _mm256_unpackhi_epi8(v, zero);
+            a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(_mm256_unpacklo_epi16(ulo, vlo), pair));
+            a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(_mm256_unpackhi_epi16(ulo, vlo), pair));
+            a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(_mm256_unpacklo_epi16(uhi, vhi), pair));
+            a3 = _mm256_add_epi32(a3, _mm256_madd_epi16(_mm256_unpackhi_epi16(uhi, vhi), pair));
+        }
+        __m256i lo = _mm256_packs_epi32(_mm256_srai_epi32(a0, PIXEL_WEIGHT_BITS), _mm256_srai_epi32(a1, PIXEL_WEIGHT_BITS));
+        __m256i hi = _mm256_packs_epi32(_mm256_srai_epi32(a2, PIXEL_WEIGHT_BITS), _mm256_srai_epi32(a3, PIXEL_WEIGHT_BITS));
+        _mm256_storeu_si256((__m256i*)(out + b), _mm256_packus_epi16(lo, hi));
+    }
+    blend_range(out, rows, weights, count, b, bytes);
+}
+
+#endif // PIXEL_KERNELS_X86
+
+// Kernel sets for every level. SSE2 has no byte shuffle, so its packed
+// grayscale and horizontal resampling kernels are the scalar ones.
+static const struct PixelKernels kernel_sets[KERNEL_LEVEL_COUNT] = {
+    {"scalar", KERNEL_SCALAR, luma_scalar, luma_bgrx_scalar, luma_planar_scalar, shift_scalar, shift_bytes_scalar,
+     resample_row_scalar, blend_rows_scalar},
+#ifdef PIXEL_KERNELS_X86
+    {"sse2", KERNEL_SSE2, luma_scalar, luma_bgrx_scalar, luma_planar_sse2, shift_sse2, shift_bytes_sse2,
+     resample_row_scalar, blend_rows_sse2},
+    {"ssse3", KERNEL_SSSE3, luma_ssse3, luma_bgrx_ssse3, luma_planar_sse2, shift_sse2, shift_bytes_sse2,
+     resample_row_ssse3, blend_rows_sse2},
+    {"avx2", KERNEL_AVX2, luma_avx2, luma_bgrx_avx2, luma_planar_avx2, shift_avx2, shift_bytes_avx2,
+     resample_row_avx2, blend_rows_avx2},
+#else
+    {"sse2", KERNEL_SSE2, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+    {"ssse3", KERNEL_SSSE3, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+    {"avx2", KERNEL_AVX2, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+#endif
+};
+
+// Function to check whether the CPU supports a level
+static int level_supported(enum KernelLevel level) {
+    if(level == KERNEL_SCALAR) return 1;
+#ifdef PIXEL_KERNELS_X86
+    __builtin_cpu_init();
+    switch(level){
+        case KERNEL_SSE2: return __builtin_cpu_supports("sse2");
+        case KERNEL_SSSE3: return __builtin_cpu_supports("ssse3");
+        case KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+        default: return 0;
+    }
+#else
+    return 0;
+#endif
+}
+
+// Function to select the best kernel set on first use
+static void select_best_kernels(void) {
+#ifdef PIXEL_KERNELS_X86
+    build_shuffle_masks();
+#endif
+    active_kernels = &kernel_sets[KERNEL_SCALAR];
+    for(int level = KERNEL_LEVEL_COUNT - 1; level > KERNEL_SCALAR; level--){
+        if(level_supported((enum KernelLevel)level)){
+            active_kernels = &kernel_sets[level];
+            break;
+        }
+    }
+}
+
+// Function to get the kernel set in use
+const struct PixelKernels* pixel_kernels(void) {
+    pthread_once(&active_kernels_once, select_best_kernels);
+    return active_kernels;
+}
+
+// Function to get the kernel set for a level
+const struct PixelKernels* pixel_kernels_for(enum KernelLevel level) {
+    pthread_once(&active_kernels_once, select_best_kernels);
+    if(level < 0 || level >= KERNEL_LEVEL_COUNT || !level_supported(level)) return NULL;
+    return &kernel_sets[level];
+}
+
+// Function to select the kernel set in use
+int pixel_kernels_select(enum KernelLevel level) {
+    const struct PixelKernels* kernels = pixel_kernels_for(level);
+    if(kernels == NULL) return 0;
+    active_kernels = kernels;
+    return 1;
+}
+
+// Function to fill pixels with consecutive colors of the 2^24 color cube
+static void fill_colors(struct Pixel* pixels, int count, unsigned int first) {
+    for(int j = 0; j < count; j++){
+        unsigned int c = first + j;
+        pixels[j].red = (unsigned char)(c >> 16);
+        pixels[j].green = (unsigned char)(c >> 8);
+        pixels[j].blue = (unsigned char)c;
+    }
+}
+
+// Function to fill pixels with a pattern that reaches every byte value in every channel
+static void fill_pattern(struct Pixel* pixels, int count, unsigned int seed) {
+    for(int j = 0; j < count; j++){
+        pixels[j].red = (unsigned char)(seed + 97u * j);
+        pixels[j].green = (unsigned char)(3u * seed + 53u * j);
+        pixels[j].blue = (unsigned char)(7u * seed + 29u * j);
+    }
+}
+
+// Function to check the resampling kernels of all kernel sets against the
+// scalar ones, on rows of every width up to 64 with every tap count up to 12
+// at every start position, and on row blends of up to 12 rows
+static int verify_resampling(void) {
+    enum { WIDTH = 64, TAPS = 12 };
+    struct Pixel src[WIDTH], expected[WIDTH], actual[WIDTH];
+    unsigned char rows_data[TAPS][3 * WIDTH];
+    const unsigned char* rows[TAPS];
+    unsigned char blend_expected[3 * WIDTH], blend_actual[3 * WIDTH];
+    int start[WIDTH], count[WIDTH];
+    short weights[WIDTH * TAPS];
+    const struct PixelKernels* ref = &kernel_sets[KERNEL_SCALAR];
+
+    for(int level = KERNEL_SCALAR + 1; level < KERNEL_LEVEL_COUNT; level++){
+        const struct PixelKernels* k = pixel_kernels_for((enum KernelLevel)level);
+        if(k == NULL) continue;
+
+        for(int taps = 1; taps <= TAPS; taps++){
+            // Weights of mixed sign summing to more than one, so both clamps are reached
+            for(int i = 0; i < WIDTH * TAPS; i++){
+                int t = i % TAPS;
+                weights[i] = t < taps ? (short)((t % 3 == 1 ? -1 : 3) * ((i * 2654435761u >> 20) % 9000)) : 0;
+            }
+            for(int width = taps; width <= WIDTH; width++){
+                fill_pattern(src, width, (unsigned int)(width * TAPS + taps));
+                int length = width - taps + 1;
+                for(int j = 0; j < length; j++){
+                    start[j] = j;
+                    count[j] = taps;
+                }
+                ref->resample_row(src, width, expected, length, start, count, weights, TAPS);
+                k->resample_row(src, width, actual, length, start, count, weights, TAPS);
+                if(memcmp(expected, actual, length * sizeof(struct Pixel)) != 0){
+                    fprintf(stderr, "Kernel %s: resampling with %d taps on %d pixels differs from scalar.\n",
+                            k->name, taps, width);
+                    return 0;
+                }
+            }
+
+            for(int t = 0; t < taps; t++){
+                fill_pattern((struct Pixel*)rows_data[t], WIDTH, (unsigned int)(taps * TAPS + t));
+                rows[t] = rows_data[t];
+            }
+            for(int bytes = 1; bytes <= 3 * WIDTH; bytes++){
+                ref->blend_rows(blend_expected, rows, weights, taps, bytes);
+                k->blend_rows(blend_actual, rows, weights, taps, bytes);
+                if(memcmp(blend_expected, blend_actual, bytes) != 0){
+                    fprintf(stderr, "Kernel %s: blending %d rows of %d bytes differs from scalar.\n",
+                            k->name, taps, bytes);
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// Function to check all kernel sets against the scalar kernels
+int pixel_kernels_verify(void) {
+    const unsigned char* ties = point_luma_ties();
+    const struct PixelKernels* ref = &kernel_sets[KERNEL_SCALAR];
+    // Odd block length so every run ends in a scalar tail
+    enum { BLOCK = 4099 };
+    struct Pixel* expected = (struct Pixel*)malloc(BLOCK * sizeof(struct Pixel));
+    struct Pixel* actual = (struct Pixel*)malloc(BLOCK * sizeof(struct Pixel));
+    unsigned char* bgrx_expected = (unsigned char*)malloc(4 * BLOCK);
+    unsigned char* bgrx_actual = (unsigned char*)malloc(4 * BLOCK);
+    if(expected == NULL || actual == NULL || bgrx_expected == NULL || bgrx_actual == NULL){
+        perror("Failed to allocate memory for kernel verification");
+        free(expected);
+        free(actual);
+        free(bgrx_expected);
+        free(bgrx_actual);
+        return 0;
+    }
+
+    int ok = 1;
+    for(int level = KERNEL_SCALAR + 1; level < KERNEL_LEVEL_COUNT; level++){
+        const struct PixelKernels* k = pixel_kernels_for((enum KernelLevel)level);
+        if(k == NULL) continue;
+
+        // Grayscale over the whole color cube
+        for(unsigned int first = 0; first < (1u << 24) && ok; first += BLOCK){
+            int count = (1u << 24) - first < BLOCK ? (int)((1u << 24) - first) : BLOCK;
+            fill_colors(expected, count, first);
+            memcpy(actual, expected, count * sizeof(struct Pixel));
+            ref->luma(expected, count, ties);
+            k->luma(actual, count, ties);
+            if(memcmp(expected, actual, count * sizeof(struct Pixel)) != 0){
+                fprintf(stderr, "Kernel %s: grayscale differs from scalar near color 0x%06x.\n", k->name, first);
+                ok = 0;
+            }
+        }
+
+        // The same colors as BGRX pixels, with a varying fourth byte, and as planes
+        for(unsigned int first = 0; first < (1u << 24) && ok; first += BLOCK){
+            int count = (1u << 24) - first < BLOCK ? (int)((1u << 24) - first) : BLOCK;
+            fill_colors(expected, count, first);
+            unsigned char* ref_bytes = bgrx_expected;
+            unsigned char* bytes = bgrx_actual;
+            for(int j = 0; j < count; j++){
+                ref_bytes[4 * j] = expected[j].blue;
+                ref_bytes[4 * j + 1] = expected[j].green;
+                ref_bytes[4 * j + 2] = expected[j].red;
+                ref_bytes[4 * j + 3] = (unsigned char)(first + 7u * j);
+            }
+            memcpy(bytes, ref_bytes, 4 * (size_t)count);
+            ref->luma_bgrx(ref_bytes, count, ties);
+            k->luma_bgrx(bytes, count, ties);
+            if(memcmp(ref_bytes, bytes, 4 * (size_t)count) != 0){
+                fprintf(stderr, "Kernel %s: BGRX grayscale differs from scalar near color 0x%06x.\n", k->name, first);
+                ok = 0;
+            }
+
+            // Planes of BLOCK bytes each, blue, green then red
+            for(int j = 0; j < count; j++){
+                ref_bytes[j] = expected[j].blue;
+                ref_bytes[BLOCK + j] = expected[j].green;
+                ref_bytes[2 * BLOCK + j] = expected[j].red;
+            }
+            memcpy(bytes, ref_bytes, 3 * BLOCK);
+            ref->luma_planar(ref_bytes, ref_bytes + BLOCK, ref_bytes + 2 * BLOCK, count, ties);
+            k->luma_planar(bytes, bytes + BLOCK, bytes + 2 * BLOCK, count, ties);
+            if(memcmp(ref_bytes, bytes, 3 * BLOCK) != 0){
+                fprintf(stderr, "Kernel %s: planar grayscale differs from scalar near color 0x%06x.\n", k->name, first);
+                ok = 0;
+            }
+        }
+
+        // Color shift, shifts from -300 to 300 on every run length up to 100 pixels
+        for(int shift = -300; shift <= 300 && ok; shift++){
+            for(int count = 1; count <= 100 && ok; count++){
+                int shifts[3][3] = {{shift, 0, 0}, {0, shift, 0}, {shift, -shift, shift / 2}};
+                for(int s = 0; s < 3 && ok; s++){
+                    fill_pattern(expected, count, (unsigned int)(shift + 300) * 101u + count);
+                    memcpy(actual, expected, count * sizeof(struct Pixel));
+                    ref->shift(expected, count, shifts[s][0], shifts[s][1], shifts[s][2]);
+                    k->shift(actual, count, shifts[s][0], shifts[s][1], shifts[s][2]);
+                    if(memcmp(expected, actual, count * sizeof(struct Pixel)) != 0){
+                        fprintf(stderr, "Kernel %s: color shift (%d, %d, %d) differs from scalar.\n",
+                                k->name, shifts[s][0], shifts[s][1], shifts[s][2]);
+                        ok = 0;
+                    }
+                    // The same shift as a 4-byte pattern over the bytes of the run
+                    unsigned char add[4], sub[4];
+                    int pattern[4] = {shifts[s][2], shifts[s][1], shifts[s][0], -shift};
+                    for(int b = 0; b < 4; b++){
+                        add[b] = pattern[b] > 0 ? shift_magnitude(pattern[b]) : 0;
+                        sub[b] = pattern[b] < 0 ? shift_magnitude(pattern[b]) : 0;
+                    }
+                    memcpy(actual, expected, count * sizeof(struct Pixel));
+                    ref->shift_bytes((unsigned char*)expected, count * 3, add, sub);
+                    k->shift_bytes((unsigned char*)actual, count * 3, add, sub);
+                    if(memcmp(expected, actual, count * sizeof(struct Pixel)) != 0){
+                        fprintf(stderr, "Kernel %s: byte shift (%d, %d, %d, %d) differs from scalar.\n",
+                                k->name, pattern[0], pattern[1], pattern[2], pattern[3]);
+                        ok = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    if(ok) ok = verify_resampling();
+    free(expected);
+    free(actual);
+    free(bgrx_expected);
+    free(bgrx_actual);
+    return ok;
+}
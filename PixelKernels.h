@@ -0,0 +1,100 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// PixelKernels.h
+
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include "Image.h"
+
+// Instruction set levels a kernel set can be built for
+enum KernelLevel {
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_SSSE3,
+    KERNEL_AVX2,
+    KERNEL_LEVEL_COUNT
+};
+
+// Resampling weights are fixed point numbers with this many fractional bits
+#define PIXEL_WEIGHT_BITS 14
+
+// A set of row kernels for packed BGR pixels, plus byte kernels for the other layouts
+struct PixelKernels {
+    const char* name;
+    enum KernelLevel level;
+    // Replaces every pixel by its grayscale value (see point_luma)
+    void (*luma)(struct Pixel* pixels, int count, const unsigned char* ties);
+    // The same for BGRX pixels, 4 bytes each, keeping the fourth byte
+    void (*luma_bgrx)(unsigned char* pixels, int count, const unsigned char* ties);
+    // The same for pixels in three planes, writing the gray value to all three
+    void (*luma_planar)(unsigned char* blue, unsigned char* green, unsigned char* red, int count,
+                        const unsigned char* ties);
+    // Adds a clamped shift to every channel
+    void (*shift)(struct Pixel* pixels, int count, int rShift, int gShift, int bShift);
+    // Adds add[i % 4] to byte i of a run and subtracts sub[i % 4], saturating:
+    // a shift of 4-byte BGRX pixels, or of a single plane with four equal entries
+    void (*shift_bytes)(unsigned char* bytes, int length, const unsigned char* add, const unsigned char* sub);
+    // Filters a row horizontally: out[j] is the sum of weights[j * taps + t] * src[start[j] + t]
+    // over t < count[j]. taps is a multiple of 4 and weights past count[j] are zero.
+    void (*resample_row)(const struct Pixel* src, int width, struct Pixel* out, int length,
+                         const int* start, const int* count, const short* weights, int taps);
+    // Combines rows byte by byte: out[b] is the sum of weights[t] * rows[t][b] over t < count.
+    // weights[count] is readable when count is odd.
+    void (*blend_rows)(unsigned char* out, const unsigned char* const* rows, const short* weights,
+                       int count, int bytes);
+};
+
+/* Computes the grayscale value of a color in fixed point, as
+ * t / 1000 with t = 299r + 587g + 114b, minus the tie correction for exact
+ * multiples of 1000 (see point_luma_ties).
+ *
+ * @param  ties: the tie table returned by point_luma_ties.
+ * @param  r: red value.
+ * @param  g: green value.
+ * @param  b: blue value.
+*/
+static inline unsigned char pixel_luma_fixed(const unsigned char* ties, int r, int g, int b) {
+    unsigned int t = 299 * r + 587 * g + 114 * b;
+    // t / 1000 as (t / 8) / 125, with 1 / 125 as a 22 bit reciprocal
+    unsigned int q = ((t >> 3) * 33555u) >> 22;
+    if(q * 1000 == t) q -= ties[(r << 8) | g];
+    return (unsigned char)q;
+}
+
+/* Returns the kernel set in use. On first use the best kernel set the CPU
+ * supports is selected with cpuid.
+*/
+const struct PixelKernels* pixel_kernels(void);
+
+/* Returns the kernel set for a level, or NULL if the CPU does not support it.
+ *
+ * @param  level: the instruction set level.
+*/
+const struct PixelKernels* pixel_kernels_for(enum KernelLevel level);
+
+/* Selects the kernel set used from now on, for example to compare levels.
+ *
+ * @param  level: the instruction set level.
+ * @return 1 on success, 0 if the CPU does not support the level.
+*/
+int pixel_kernels_select(enum KernelLevel level);
+
+/* Checks every kernel set the CPU supports against the scalar kernels:
+ * grayscale on all 2^24 colors in every layout, color shift and byte shift
+ * for shifts from -300 to 300 on every run length up to 100 pixels, and the
+ * resampling kernels on short rows with up to 12 taps. Prints any mismatch to stderr.
+ *
+ * @return 1 if every kernel set is bit-identical to the scalar one, 0
+ *         otherwise.
+*/
+int pixel_kernels_verify(void);
+
+#endif // PIXELKERNELS_H
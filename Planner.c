@@ -0,0 +1,191 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Planner.c
+
+#include "Planner.h"
+#include "Stats.h"
+#include <stdio.h>
+#include <string.h>
+
+// Work per pixel of the stages, relative to one table lookup
+#define COST_LOOKUP 1.0    // Color shift or lookup table
+#define COST_LUMA 3.0      // Grayscale, a weighted sum per pixel
+#define COST_GATHER 1.0    // Nearest neighbor resize, per output pixel
+#define COST_MOVE 2.0      // Geometric transform, a scattered copy
+#define COST_BOX 4.0       // Box blur, two running sums per pixel
+
+// Function to tell whether a stage commutes with the point stages
+static int commutes(const struct FilterStage* stage) {
+    return stage->type != STAGE_CONVOLVE && stage->type != STAGE_ADJUST &&
+           (stage->type != STAGE_RESIZE || stage->filter == RESAMPLE_NEAREST);
+}
+
+// Function to compute the size of the image after a stage
+static void stage_size(const struct FilterStage* stage, int* width, int* height) {
+    if(stage->type == STAGE_RESIZE){
+        *width = (int)(*width * stage->factor);
+        *height = (int)(*height * stage->factor);
+        if(*width == 0) *width = 1;
+        if(*height == 0) *height = 1;
+    }
+    else if(stage->type == STAGE_GEOMETRY && stage->orientation.transpose){
+        int swap = *width;
+        *width = *height;
+        *height = swap;
+    }
+}
+
+// Function to estimate the cost of one stage on an image of a given size
+static double stage_cost(const struct FilterStage* stage, int width, int height) {
+    double pixels = (double)width * height;
+    int new_width = width, new_height = height;
+    stage_size(stage, &new_width, &new_height);
+    double new_pixels = (double)new_width * new_height;
+
+    switch(stage->type){
+        case STAGE_GRAYSCALE:
+            return COST_LUMA * pixels;
+        case STAGE_COLORSHIFT:
+        case STAGE_LUT:
+            return COST_LOOKUP * pixels;
+        case STAGE_ADJUST:
+            // Counting the pixels, then the tables like a lookup stage
+            return (COST_LUMA + COST_LOOKUP) * pixels;
+        case STAGE_GEOMETRY:
+            return orientation_is_identity(&stage->orientation) ? 0.0 : COST_MOVE * pixels;
+        case STAGE_CONVOLVE:
+            // A symmetric kernel adds its taps in pairs, on both axes
+            if(stage->kernel.type == CONVOLVE_BOX) return COST_BOX * new_pixels;
+            return 2.0 * (stage->kernel.radius + 1) * new_pixels;
+        case STAGE_RESIZE: {
+            if(stage->filter == RESAMPLE_NEAREST) return COST_GATHER * new_pixels;
+            // The taps per axis of the filter; a downscale stretches it over
+            // the source area of every output pixel
+            double taps = stage->filter == RESAMPLE_LANCZOS ? 6.0 : stage->filter == RESAMPLE_BICUBIC ? 4.0 :
+                          stage->filter == RESAMPLE_BILINEAR ? 2.0 : 1.0;
+            if(stage->factor < 1.0f) taps /= stage->factor;
+            // A horizontal pass over the source rows, then a vertical pass
+            return taps * ((double)height * new_width + new_pixels);
+        }
+    }
+    return 0.0;
+}
+
+// Function to estimate the cost of a chain
+double planner_cost(const FilterChain* chain, int width, int height) {
+    double cost = 0.0;
+    for(int s = 0; s < chain->count; s++){
+        cost += stage_cost(&chain->stages[s], width, height);
+        stage_size(&chain->stages[s], &width, &height);
+    }
+    return cost / 1e6;
+}
+
+// Function to reorder a chain
+void planner_optimize(const FilterChain* chain, int width, int height, FilterChain* planned) {
+    FilterChain result;
+    filter_chain_init(&result);
+    int w = width, h = height;
+    int s = 0;
+    while(s < chain->count){
+        if(!commutes(&chain->stages[s])){
+            stage_size(&chain->stages[s], &w, &h);
+            result.stages[result.count++] = chain->stages[s++];
+            continue;
+        }
+
+        // A run of stages the point stages move freely in. Between its
+        // resizes lie slots of fixed size; the point stages all go to the
+        // first of the smallest, so they keep their order.
+        int end = s;
+        int slot = 0, best = 0;
+        double best_pixels = (double)w * h;
+        while(end < chain->count && commutes(&chain->stages[end])){
+            const struct FilterStage* stage = &chain->stages[end++];
+            stage_size(stage, &w, &h);
+            if(stage->type == STAGE_RESIZE){
+                slot++;
+                if((double)w * h < best_pixels){
+                    best_pixels = (double)w * h;
+                    best = slot;
+                }
+            }
+        }
+
+        // Point stages go right after the best resize, the other stages keep
+        // their order
+        slot = 0;
+        for(int pass = s; pass <= end; pass++){
+            if(slot == best){
+                for(int p = s; p < end; p++){
+                    if(filter_chain_is_point_stage(&chain->stages[p])) result.stages[result.count++] = chain->stages[p];
+                }
+                slot = -1;
+            }
+            if(pass == end) break;
+            const struct FilterStage* stage = &chain->stages[pass];
+            if(filter_chain_is_point_stage(stage)) continue;
+            result.stages[result.count++] = *stage;
+            if(stage->type == STAGE_RESIZE && slot >= 0) slot++;
+        }
+        s = end;
+    }
+
+    char text[256];
+    planner_describe(&result, text, sizeof(text));
+    stats_set_plan(text, planner_cost(chain, width, height), planner_cost(&result, width, height));
+    *planned = result;
+}
+
+// Function to append a word to a description
+static void append(char* text, size_t size, size_t* used, const char* word) {
+    int written = snprintf(text + *used, size - *used, "%s%s", *used > 0 ? ">" : "", word);
+    if(written > 0) *used += (size_t)written < size - *used ? (size_t)written : size - *used - 1;
+}
+
+// Function to describe a chain
+void planner_describe(const FilterChain* chain, char* text, size_t size) {
+    size_t used = 0;
+    if(size == 0) return;
+    text[0] = '\0';
+    for(int s = 0; s < chain->count; s++){
+        const struct FilterStage* stage = &chain->stages[s];
+        char word[64];
+        switch(stage->type){
+            case STAGE_GRAYSCALE:
+                snprintf(word, sizeof(word), "grayscale");
+                break;
+            case STAGE_COLORSHIFT:
+                snprintf(word, sizeof(word), "shift(%d,%d,%d)", stage->rShift, stage->gShift, stage->bShift);
+                break;
+            case STAGE_LUT:
+                snprintf(word, sizeof(word), "lut");
+                break;
+            case STAGE_RESIZE:
+                snprintf(word, sizeof(word), "%s*%g", resample_filter_name(stage->filter), stage->factor);
+                break;
+            case STAGE_GEOMETRY:
+                // In the order they are applied, see struct Orientation
+                snprintf(word, sizeof(word), "%s%s%s%s", stage->orientation.transpose ? "+transpose" : "",
+                         stage->orientation.flip_x ? "+flip_h" : "", stage->orientation.flip_y ? "+flip_v" : "",
+                         orientation_is_identity(&stage->orientation) ? "+identity" : "");
+                memmove(word, word + 1, strlen(word));
+                break;
+            case STAGE_ADJUST:
+                snprintf(word, sizeof(word), "auto_%s", histogram_adjust_name(stage->adjust));
+                break;
+            case STAGE_CONVOLVE:
+                snprintf(word, sizeof(word), "%s(r%d)", stage->kernel.type == CONVOLVE_BOX ? "box" :
+                         stage->kernel.type == CONVOLVE_SHARPEN ? "sharpen" : "gaussian", stage->kernel.radius);
+                break;
+        }
+        append(text, size, &used, word);
+    }
+}
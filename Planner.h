@@ -0,0 +1,55 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Planner.h
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stddef.h>
+#include "FilterChain.h"
+
+/* Estimates the work of applying a chain to an image of a given size, in
+ * millions of pixel operations: every stage costs the number of pixels it
+ * touches times a weight for the work per pixel, a table lookup counting 1.
+ *
+ * @param  chain: the chain.
+ * @param  width: width of the image.
+ * @param  height: height of the image.
+ * @return the estimated cost.
+*/
+double planner_cost(const FilterChain* chain, int width, int height);
+
+/* Reorders a chain so that its point stages touch as few pixels as
+ * possible. Point stages commute exactly with nearest neighbor resizes,
+ * which only pick pixels, and with geometric stages, which only move them,
+ * so within a run of such stages the point stages move together, in their
+ * order, to the place where the image is smallest: after a downscale, before
+ * an upscale. They never move across a filtered resize or a convolution,
+ * which blend pixels, nor across an adjustment, which reads them. The
+ * result of the planned chain is identical to that of the chain. The plan
+ * and both cost estimates are recorded for stats_print.
+ *
+ * @param  chain: the chain.
+ * @param  width: width of the image the chain is applied to.
+ * @param  height: height of the image the chain is applied to.
+ * @param  planned: receives the planned chain, may be chain itself.
+*/
+void planner_optimize(const FilterChain* chain, int width, int height, FilterChain* planned);
+
+/* Describes a chain in one word, its stages joined with '>', for example
+ * grayscale>nearest*0.1>gaussian(r6).
+ *
+ * @param  chain: the chain.
+ * @param  text: receives the description, truncated to size bytes.
+ * @param  size: size of text.
+*/
+void planner_describe(const FilterChain* chain, char* text, size_t size);
+
+#endif // PLANNER_H
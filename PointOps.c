@@ -0,0 +1,353 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// PointOps.c
+
+#include "PointOps.h"
+#include "PixelKernels.h"
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+// Number of pixels a point program processes per block, so that all of its
+// steps run while the block is in L1 cache
+#define POINT_BLOCK_PIXELS 2048
+
+// Integer luma weights, in thousandths
+#define LUMA_R 299
+#define LUMA_G 587
+#define LUMA_B 114
+
+// Table of luma corrections for exact multiples of 1000, indexed by (r << 8) | g
+static unsigned char luma_ties[256 * 256];
+static pthread_once_t luma_ties_once = PTHREAD_ONCE_INIT;
+
+// Helper function to clamp color values
+static unsigned char clamp(int value) {
+    if(value < 0) return 0;
+    if(value > 255) return 255;
+    return (unsigned char)value;
+}
+
+// Function to build the luma tie table.
+// When t = 299r + 587g + 114b is a multiple of 1000, rounding in the double
+// precision formula can land just below t / 1000. For a given r and g at
+// most one b in [0, 255] gives such a t, since 114b mod 1000 repeats only
+// every 500 values of b.
+static void build_luma_ties(void) {
+    for(int r = 0; r < 256; r++){
+        for(int g = 0; g < 256; g++){
+            int rest = (1000 - (LUMA_R * r + LUMA_G * g) % 1000) % 1000;
+            unsigned char correction = 0;
+            // 114b = rest (mod 1000) needs an even rest; 57 * 193 = 1 (mod 500)
+            if(rest % 2 == 0){
+                int b = (rest / 2 * 193) % 500;
+                if(b < 256){
+                    int t = LUMA_R * r + LUMA_G * g + LUMA_B * b;
+                    unsigned char exact = (unsigned char)(0.299 * r + 0.587 * g + 0.114 * b);
+                    correction = (unsigned char)(t / 1000 - exact);
+                }
+            }
+            luma_ties[(r << 8) | g] = correction;
+        }
+    }
+}
+
+// Function to get the luma tie table
+const unsigned char* point_luma_ties(void) {
+    pthread_once(&luma_ties_once, build_luma_ties);
+    return luma_ties;
+}
+
+// Function to compute the luma of a color
+unsigned char point_luma(int r, int g, int b) {
+    return pixel_luma_fixed(point_luma_ties(), r, g, b);
+}
+
+// Function to initialize a LUT to the identity
+void point_lut_identity(struct PointLUT* lut) {
+    for(int i = 0; i < 256; i++){
+        lut->red[i] = (unsigned char)i;
+        lut->green[i] = (unsigned char)i;
+        lut->blue[i] = (unsigned char)i;
+    }
+}
+
+// Function to compose two LUTs
+void point_lut_compose(struct PointLUT* lut, const struct PointLUT* next) {
+    for(int i = 0; i < 256; i++){
+        lut->red[i] = next->red[lut->red[i]];
+        lut->green[i] = next->green[lut->green[i]];
+        lut->blue[i] = next->blue[lut->blue[i]];
+    }
+}
+
+// Function to compose a color shift onto a LUT
+void point_lut_shift(struct PointLUT* lut, int rShift, int gShift, int bShift) {
+    for(int i = 0; i < 256; i++){
+        lut->red[i] = clamp(lut->red[i] + rShift);
+        lut->green[i] = clamp(lut->green[i] + gShift);
+        lut->blue[i] = clamp(lut->blue[i] + bShift);
+    }
+}
+
+// Function to compose a gamma curve onto a LUT
+void point_lut_gamma(struct PointLUT* lut, double gamma) {
+    unsigned char curve[256];
+    for(int i = 0; i < 256; i++){
+        curve[i] = clamp((int)(255.0 * pow(i / 255.0, 1.0 / gamma) + 0.5));
+    }
+    for(int i = 0; i < 256; i++){
+        lut->red[i] = curve[lut->red[i]];
+        lut->green[i] = curve[lut->green[i]];
+        lut->blue[i] = curve[lut->blue[i]];
+    }
+}
+
+// Function to compose a levels adjustment onto a LUT
+void point_lut_levels(struct PointLUT* lut, int black, int white) {
+    unsigned char curve[256];
+    int range = white > black ? white - black : 1;
+    for(int i = 0; i < 256; i++){
+        curve[i] = clamp(((i - black) * 255 + range / 2) / range);
+        if(i <= black) curve[i] = 0;
+    }
+    for(int i = 0; i < 256; i++){
+        lut->red[i] = curve[lut->red[i]];
+        lut->green[i] = curve[lut->green[i]];
+        lut->blue[i] = curve[lut->blue[i]];
+    }
+}
+
+// Function to compose an inversion onto a LUT
+void point_lut_invert(struct PointLUT* lut) {
+    for(int i = 0; i < 256; i++){
+        lut->red[i] = 255 - lut->red[i];
+        lut->green[i] = 255 - lut->green[i];
+        lut->blue[i] = 255 - lut->blue[i];
+    }
+}
+
+// Function to check whether a LUT is the identity
+int point_lut_is_identity(const struct PointLUT* lut) {
+    for(int i = 0; i < 256; i++){
+        if(lut->red[i] != i || lut->green[i] != i || lut->blue[i] != i) return 0;
+    }
+    return 1;
+}
+
+// Function to find the shift a single channel table applies, or return 0 if it is not a clamped shift
+static int channel_as_shift(const unsigned char* table, int* shift) {
+    int s = 0;
+    if(table[0] > 0) s = table[0];
+    else if(table[255] < 255) s = table[255] - 255;
+    for(int i = 0; i < 256; i++){
+        if(table[i] != clamp(i + s)) return 0;
+    }
+    *shift = s;
+    return 1;
+}
+
+// Function to check whether a LUT is a clamped per-channel shift
+int point_lut_as_shift(const struct PointLUT* lut, int* rShift, int* gShift, int* bShift) {
+    return channel_as_shift(lut->red, rShift) && channel_as_shift(lut->green, gShift) &&
+           channel_as_shift(lut->blue, bShift);
+}
+
+// Function to update the cached properties of a step after its LUT changed
+static void update_step(struct PointStep* step) {
+    step->identity = point_lut_is_identity(&step->lut);
+    step->is_shift = !step->identity && point_lut_as_shift(&step->lut, &step->shift[0], &step->shift[1], &step->shift[2]);
+}
+
+// Function to initialize an empty point program
+void point_program_init(struct PointProgram* prog) {
+    prog->count = 1;
+    prog->steps[0].luma = 0;
+    point_lut_identity(&prog->steps[0].lut);
+    update_step(&prog->steps[0]);
+}
+
+// Function to append a LUT to a point program
+void point_program_add_lut(struct PointProgram* prog, const struct PointLUT* lut) {
+    struct PointStep* step = &prog->steps[prog->count - 1];
+    point_lut_compose(&step->lut, lut);
+    update_step(step);
+}
+
+// Function to append a grayscale conversion to a point program
+int point_program_add_luma(struct PointProgram* prog) {
+    struct PointStep* last = &prog->steps[prog->count - 1];
+    // The first step can take the conversion if it does nothing yet
+    if(prog->count == 1 && !last->luma && last->identity){
+        last->luma = 1;
+        return 1;
+    }
+    if(prog->count >= POINT_PROGRAM_MAX_STEPS) return 0;
+    struct PointStep* step = &prog->steps[prog->count++];
+    step->luma = 1;
+    point_lut_identity(&step->lut);
+    update_step(step);
+    return 1;
+}
+
+// Function to check whether a point program does nothing
+int point_program_is_empty(const struct PointProgram* prog) {
+    return prog->count == 1 && !prog->steps[0].luma && prog->steps[0].identity;
+}
+
+// Function to apply a single LUT to a run of pixels
+static void apply_lut(const struct PointLUT* lut, struct Pixel* pixels, int count) {
+    for(int j = 0; j < count; j++){
+        struct Pixel* p = &pixels[j];
+        p->red = lut->red[p->red];
+        p->green = lut->green[p->green];
+        p->blue = lut->blue[p->blue];
+    }
+}
+
+// Function to apply luma followed by a LUT to a run of pixels
+static void apply_luma_lut(const unsigned char* ties, const struct PointStep* step, struct Pixel* pixels, int count) {
+    for(int j = 0; j < count; j++){
+        struct Pixel* p = &pixels[j];
+        unsigned char y = pixel_luma_fixed(ties, p->red, p->green, p->blue);
+        p->red = step->lut.red[y];
+        p->green = step->lut.green[y];
+        p->blue = step->lut.blue[y];
+    }
+}
+
+// Function to apply one step to a block of pixels
+static void apply_step(const struct PixelKernels* kernels, const unsigned char* ties,
+                       const struct PointStep* step, struct Pixel* pixels, int count) {
+    if(step->luma && step->identity){
+        kernels->luma(pixels, count, ties);
+    }
+    else if(step->luma && step->is_shift){
+        kernels->luma(pixels, count, ties);
+        kernels->shift(pixels, count, step->shift[0], step->shift[1], step->shift[2]);
+    }
+    else if(step->luma){
+        apply_luma_lut(ties, step, pixels, count);
+    }
+    else if(step->is_shift){
+        kernels->shift(pixels, count, step->shift[0], step->shift[1], step->shift[2]);
+    }
+    else if(!step->identity){
+        apply_lut(&step->lut, pixels, count);
+    }
+}
+
+// Function to apply a point program to a run of pixels
+void point_program_apply(const struct PointProgram* prog, struct Pixel* pixels, int count) {
+    const unsigned char* ties = point_luma_ties();
+    const struct PixelKernels* kernels = pixel_kernels();
+    for(int j = 0; j < count; j += POINT_BLOCK_PIXELS){
+        int block = count - j < POINT_BLOCK_PIXELS ? count - j : POINT_BLOCK_PIXELS;
+        for(int s = 0; s < prog->count; s++){
+            apply_step(kernels, ties, &prog->steps[s], pixels + j, block);
+        }
+    }
+}
+
+// Function to split a shift into the saturating add and subtract of a byte
+static void shift_byte(int shift, unsigned char* add, unsigned char* sub) {
+    int magnitude = shift < 0 ? -shift : shift;
+    if(magnitude > 255) magnitude = 255;
+    *add = shift > 0 ? (unsigned char)magnitude : 0;
+    *sub = shift < 0 ? (unsigned char)magnitude : 0;
+}
+
+// Function to apply one step to a block of BGRX pixels
+static void apply_step_bgrx(const struct PixelKernels* kernels, const unsigned char* ties,
+                            const struct PointStep* step, unsigned char* pixels, int count) {
+    const struct PointLUT* lut = &step->lut;
+    if(step->luma){
+        // Luma lands in all three bytes, the shift or LUT then maps it
+        kernels->luma_bgrx(pixels, count, ties);
+    }
+    if(step->is_shift){
+        // The fourth byte of every pixel is shifted by 0
+        unsigned char add[4], sub[4];
+        shift_byte(step->shift[2], &add[0], &sub[0]);
+        shift_byte(step->shift[1], &add[1], &sub[1]);
+        shift_byte(step->shift[0], &add[2], &sub[2]);
+        shift_byte(0, &add[3], &sub[3]);
+        kernels->shift_bytes(pixels, 4 * count, add, sub);
+    }
+    else if(!step->identity){
+        for(int j = 0; j < count; j++){
+            unsigned char* p = pixels + 4 * j;
+            p[0] = lut->blue[p[0]];
+            p[1] = lut->green[p[1]];
+            p[2] = lut->red[p[2]];
+        }
+    }
+}
+
+// Function to apply a point program to a run of BGRX pixels
+void point_program_apply_bgrx(const struct PointProgram* prog, unsigned char* pixels, int count) {
+    const unsigned char* ties = point_luma_ties();
+    const struct PixelKernels* kernels = pixel_kernels();
+    for(int j = 0; j < count; j += POINT_BLOCK_PIXELS){
+        int block = count - j < POINT_BLOCK_PIXELS ? count - j : POINT_BLOCK_PIXELS;
+        for(int s = 0; s < prog->count; s++){
+            apply_step_bgrx(kernels, ties, &prog->steps[s], pixels + 4 * j, block);
+        }
+    }
+}
+
+// Function to apply a clamped shift to one plane
+static void shift_plane(const struct PixelKernels* kernels, unsigned char* plane, int count, int shift) {
+    unsigned char add[4], sub[4];
+    shift_byte(shift, &add[0], &sub[0]);
+    for(int b = 1; b < 4; b++){
+        add[b] = add[0];
+        sub[b] = sub[0];
+    }
+    kernels->shift_bytes(plane, count, add, sub);
+}
+
+// Function to apply a LUT to one plane
+static void lut_plane(unsigned char* plane, int count, const unsigned char* table) {
+    for(int j = 0; j < count; j++) plane[j] = table[plane[j]];
+}
+
+// Function to apply one step to a block of planar pixels
+static void apply_step_planar(const struct PixelKernels* kernels, const unsigned char* ties,
+                              const struct PointStep* step, unsigned char* blue, unsigned char* green,
+                              unsigned char* red, int count) {
+    if(step->luma){
+        // Luma lands in all three planes, the shift or LUT then maps it
+        kernels->luma_planar(blue, green, red, count, ties);
+    }
+    if(step->is_shift){
+        shift_plane(kernels, blue, count, step->shift[2]);
+        shift_plane(kernels, green, count, step->shift[1]);
+        shift_plane(kernels, red, count, step->shift[0]);
+    }
+    else if(!step->identity){
+        lut_plane(blue, count, step->lut.blue);
+        lut_plane(green, count, step->lut.green);
+        lut_plane(red, count, step->lut.red);
+    }
+}
+
+// Function to apply a point program to a run of planar pixels
+void point_program_apply_planar(const struct PointProgram* prog, unsigned char* blue, unsigned char* green,
+                                unsigned char* red, int count) {
+    const unsigned char* ties = point_luma_ties();
+    const struct PixelKernels* kernels = pixel_kernels();
+    for(int j = 0; j < count; j += POINT_BLOCK_PIXELS){
+        int block = count - j < POINT_BLOCK_PIXELS ? count - j : POINT_BLOCK_PIXELS;
+        for(int s = 0; s < prog->count; s++){
+            apply_step_planar(kernels, ties, &prog->steps[s], blue + j, green + j, red + j, block);
+        }
+    }
+}
@@ -0,0 +1,172 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// PointOps.h
+
+#ifndef POINTOPS_H
+#define POINTOPS_H
+
+#include "Image.h"
+
+// Maximum number of steps in a point program
+#define POINT_PROGRAM_MAX_STEPS 16
+
+// Per-channel lookup tables mapping an input byte to an output byte
+struct PointLUT {
+    unsigned char red[256];
+    unsigned char green[256];
+    unsigned char blue[256];
+};
+
+// One step of a point program: an optional luma conversion followed by a LUT
+struct PointStep {
+    int luma;            // 1 to replace r, g and b by the luma before the lookup
+    int identity;        // 1 if lut is the identity and can be skipped
+    int is_shift;        // 1 if lut is a clamped shift, run with the shift kernel
+    int shift[3];        // Red, green and blue shift when is_shift is set
+    struct PointLUT lut;
+};
+
+// A sequence of point operations compiled into as few table lookups as possible
+struct PointProgram {
+    struct PointStep steps[POINT_PROGRAM_MAX_STEPS];
+    int count;
+};
+
+/* Initializes a LUT to the identity.
+ *
+ * @param  lut: the LUT.
+*/
+void point_lut_identity(struct PointLUT* lut);
+
+/* Composes a LUT with a following one, so that lut becomes next(lut(x)).
+ *
+ * @param  lut: the LUT that is applied first, replaced by the composition.
+ * @param  next: the LUT that is applied second.
+*/
+void point_lut_compose(struct PointLUT* lut, const struct PointLUT* next);
+
+/* Composes a clamped color shift onto a LUT.
+ *
+ * @param  lut: the LUT.
+ * @param  rShift: the shift value of color r shift
+ * @param  gShift: the shift value of color g shift
+ * @param  bShift: the shift value of color b shift
+*/
+void point_lut_shift(struct PointLUT* lut, int rShift, int gShift, int bShift);
+
+/* Composes a gamma curve out = 255 * (in / 255) ^ (1 / gamma) onto a LUT.
+ *
+ * @param  lut: the LUT.
+ * @param  gamma: the gamma value, greater than 0.
+*/
+void point_lut_gamma(struct PointLUT* lut, double gamma);
+
+/* Composes a levels adjustment onto a LUT, stretching [black, white] to [0, 255].
+ *
+ * @param  lut: the LUT.
+ * @param  black: input value mapped to 0.
+ * @param  white: input value mapped to 255, greater than black.
+*/
+void point_lut_levels(struct PointLUT* lut, int black, int white);
+
+/* Composes an inversion (255 - x) onto a LUT.
+ *
+ * @param  lut: the LUT.
+*/
+void point_lut_invert(struct PointLUT* lut);
+
+/* Returns 1 if the LUT is the identity, 0 otherwise.
+ *
+ * @param  lut: the LUT.
+*/
+int point_lut_is_identity(const struct PointLUT* lut);
+
+/* Checks whether a LUT is a clamped per-channel shift, as built by
+ * point_lut_shift, and returns the shift values if it is.
+ *
+ * @param  lut: the LUT.
+ * @param  rShift: receives the red shift.
+ * @param  gShift: receives the green shift.
+ * @param  bShift: receives the blue shift.
+ * @return 1 if the LUT is a shift, 0 otherwise.
+*/
+int point_lut_as_shift(const struct PointLUT* lut, int* rShift, int* gShift, int* bShift);
+
+/* Returns the grayscale value of a color, computed in fixed point. The
+ * result is identical to truncating 0.299 * r + 0.587 * g + 0.114 * b
+ * evaluated in double precision.
+ *
+ * @param  r: red value.
+ * @param  g: green value.
+ * @param  b: blue value.
+*/
+unsigned char point_luma(int r, int g, int b);
+
+/* Returns the correction subtracted from the fixed point luma t / 1000 when
+ * t = 299 * r + 587 * g + 114 * b is a multiple of 1000, as a table indexed
+ * by (r << 8) | g. Built once per run.
+*/
+const unsigned char* point_luma_ties(void);
+
+/* Initializes an empty point program.
+ *
+ * @param  prog: the program.
+*/
+void point_program_init(struct PointProgram* prog);
+
+/* Appends a LUT to a point program. It is folded into the last step.
+ *
+ * @param  prog: the program.
+ * @param  lut: the LUT.
+*/
+void point_program_add_lut(struct PointProgram* prog, const struct PointLUT* lut);
+
+/* Appends a grayscale conversion to a point program. Starts a new step.
+ *
+ * @param  prog: the program.
+ * @return 1 on success, 0 if the program is full.
+*/
+int point_program_add_luma(struct PointProgram* prog);
+
+/* Returns 1 if the program does nothing, 0 otherwise.
+ *
+ * @param  prog: the program.
+*/
+int point_program_is_empty(const struct PointProgram* prog);
+
+/* Applies a point program to a run of pixels.
+ *
+ * @param  prog: the program.
+ * @param  pixels: the pixels.
+ * @param  count: number of pixels.
+*/
+void point_program_apply(const struct PointProgram* prog, struct Pixel* pixels, int count);
+
+/* Applies a point program to a run of 4-byte BGRX pixels. The fourth bytes
+ * are left as they are.
+ *
+ * @param  prog: the program.
+ * @param  pixels: the pixels.
+ * @param  count: number of pixels.
+*/
+void point_program_apply_bgrx(const struct PointProgram* prog, unsigned char* pixels, int count);
+
+/* Applies a point program to a run of pixels stored as three planes.
+ *
+ * @param  prog: the program.
+ * @param  blue: the blue values.
+ * @param  green: the green values.
+ * @param  red: the red values.
+ * @param  count: number of pixels.
+*/
+void point_program_apply_planar(const struct PointProgram* prog, unsigned char* blue, unsigned char* green,
+                                unsigned char* red, int count);
+
+#endif // POINTOPS_H
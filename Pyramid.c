@@ -0,0 +1,80 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Pyramid.c
+
+#include "Pyramid.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+
+// Context for reducing bands of output rows
+struct ReduceBands {
+    Image* src;
+    Image* dst;
+    int planes;
+    int bytes; // Bytes per pixel of a plane
+};
+
+// Function to average 2x2 blocks of a row pair into an output row. Always
+// inlined with a constant pixel size, so the byte loop is unrolled.
+static inline void reduce_row(unsigned char* out, const unsigned char* top, const unsigned char* bottom,
+                              int width, int right, int bytes) {
+    for(int x = 0; x < width; x++){
+        const unsigned char* a = top + 2 * x * bytes;
+        const unsigned char* b = bottom + 2 * x * bytes;
+        for(int c = 0; c < bytes; c++){
+            out[x * bytes + c] = (unsigned char)((a[c] + a[c + right] + b[c] + b[c + right] + 2) >> 2);
+        }
+    }
+}
+
+// Function to reduce a band of output rows
+static void reduce_band(void* ctx, int begin, int end) {
+    struct ReduceBands* job = (struct ReduceBands*)ctx;
+    Image* src = job->src;
+    Image* dst = job->dst;
+    // A side of 1 pixel averages the pixel with itself
+    int right = src->width > 1 ? job->bytes : 0;
+    int below = src->height > 1 ? 1 : 0;
+    for(int i = begin; i < end; i++){
+        for(int p = 0; p < job->planes; p++){
+            unsigned char* out = image_get_plane_row(dst, p, i);
+            const unsigned char* top = image_get_plane_row(src, p, 2 * i);
+            const unsigned char* bottom = image_get_plane_row(src, p, 2 * i + below);
+            switch(job->bytes){
+                case 1: reduce_row(out, top, bottom, dst->width, right, 1); break;
+                case 3: reduce_row(out, top, bottom, dst->width, right, 3); break;
+                default: reduce_row(out, top, bottom, dst->width, right, 4); break;
+            }
+        }
+    }
+}
+
+// Function to halve an image
+Image* pyramid_reduce(Image* img) {
+    if(image_is_indexed(img)){
+        fprintf(stderr, "Indexed images must be expanded before they are reduced.\n");
+        return NULL;
+    }
+    int width = img->width / 2;
+    int height = img->height / 2;
+    if(width == 0) width = 1;
+    if(height == 0) height = 1;
+
+    enum ImageLayout layout = image_get_layout(img);
+    Image* dst = image_create_layout(width, height, layout, IMAGE_ALLOC_DEFAULT);
+    if(dst == NULL){
+        // Error message already printed
+        return NULL;
+    }
+    struct ReduceBands job = {img, dst, layout == IMAGE_LAYOUT_PLANAR ? 3 : 1,
+                              layout == IMAGE_LAYOUT_PLANAR ? 1 : layout == IMAGE_LAYOUT_BGRX ? 4 : 3};
+    threadpool_run_bands(threadpool_get_default(), height, reduce_band, &job);
+    return dst;
+}
@@ -0,0 +1,32 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Pyramid.h
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "Image.h"
+
+// Largest number of levels below the full image, down to 1/65536
+#define PYRAMID_MAX_LEVELS 16
+
+/* Halves an image with a 2x2 box filter: every output pixel is the rounded
+ * average of a 2x2 block of source pixels. The result has the size of a
+ * nearest neighbor resize by 0.5, width / 2 by height / 2 but at least 1,
+ * so a last odd row or column is dropped and a side of 1 pixel is kept.
+ * Output rows run in parallel bands. The image keeps its layout; the fourth
+ * bytes of a BGRX image are averaged like the channels.
+ *
+ * @param  img: the true color image, left unchanged.
+ * @return A new image, NULL on failure.
+*/
+Image* pyramid_reduce(Image* img);
+
+#endif // PYRAMID_H
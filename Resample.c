@@ -0,0 +1,299 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Resample.c
+
+#include "Resample.h"
+#include "ThreadPool.h"
+#include "PixelKernels.h"
+#include "BufferPool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+// Fixed point weights have this many fractional bits
+#define WEIGHT_BITS PIXEL_WEIGHT_BITS
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Names of the filters, indexed by enum ResampleFilter
+static const char* filter_names[] = {"nearest", "bilinear", "bicubic", "lanczos", "box"};
+
+// Function to look up a filter by name
+int resample_filter_from_name(const char* name, enum ResampleFilter* filter) {
+    for(int i = 0; i < (int)(sizeof(filter_names) / sizeof(filter_names[0])); i++){
+        if(strcmp(name, filter_names[i]) == 0){
+            *filter = (enum ResampleFilter)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to get the name of a filter
+const char* resample_filter_name(enum ResampleFilter filter) {
+    return filter_names[filter];
+}
+
+// Function to get the support radius of a filter
+static double filter_support(enum ResampleFilter filter) {
+    switch(filter){
+        case RESAMPLE_BILINEAR: return 1.0;
+        case RESAMPLE_BICUBIC: return 2.0;
+        case RESAMPLE_LANCZOS: return 3.0;
+        default: return 0.5;
+    }
+}
+
+// Helper function for the normalized sinc
+static double sinc(double x) {
+    if(x == 0.0) return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+// Function to evaluate a filter at a distance x from the center
+static double filter_eval(enum ResampleFilter filter, double x) {
+    double ax = fabs(x);
+    switch(filter){
+        case RESAMPLE_BILINEAR:
+            return ax < 1.0 ? 1.0 - ax : 0.0;
+        case RESAMPLE_BICUBIC:
+            // Catmull-Rom, a = -0.5
+            if(ax < 1.0) return (1.5 * ax - 2.5) * ax * ax + 1.0;
+            if(ax < 2.0) return ((-0.5 * ax + 2.5) * ax - 4.0) * ax + 2.0;
+            return 0.0;
+        case RESAMPLE_LANCZOS:
+            return ax < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+        default:
+            return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+    }
+}
+
+// Function to release a weight table
+static void free_weights(struct ResampleWeights* table) {
+    buffer_pool_free(table->start, table->length * sizeof(int));
+    buffer_pool_free(table->count, table->length * sizeof(int));
+    buffer_pool_free(table->weights, (size_t)table->length * table->taps * sizeof(short));
+}
+
+// Function to build the weight table of one axis
+static int build_weights(struct ResampleWeights* table, int in_length, int out_length, enum ResampleFilter filter) {
+    double scale = (double)out_length / in_length;
+    double stretch = scale < 1.0 ? 1.0 / scale : 1.0;
+    double support = filter_support(filter) * stretch;
+
+    table->length = out_length;
+    // A multiple of 4 taps, so the kernels can weigh taps in groups of up to 4
+    table->taps = ((int)ceil(2.0 * support) + 5) & ~3;
+    table->start = (int*)buffer_pool_alloc(out_length * sizeof(int));
+    table->count = (int*)buffer_pool_alloc(out_length * sizeof(int));
+    table->weights = (short*)buffer_pool_alloc((size_t)out_length * table->taps * sizeof(short));
+    double* w = (double*)buffer_pool_alloc(table->taps * sizeof(double));
+    if(table->start == NULL || table->count == NULL || table->weights == NULL || w == NULL){
+        perror("Failed to allocate memory for resampling weights");
+        free_weights(table);
+        buffer_pool_free(w, table->taps * sizeof(double));
+        return 0;
+    }
+    memset(table->weights, 0, (size_t)out_length * table->taps * sizeof(short));
+
+    for(int i = 0; i < out_length; i++){
+        // Pixel centers sit at k + 0.5 in source coordinates
+        double center = (i + 0.5) / scale;
+        int lo = (int)floor(center - support);
+        int hi = (int)ceil(center + support);
+        int first = lo < 0 ? 0 : lo;
+        int last = hi - 1 >= in_length ? in_length - 1 : hi - 1;
+        int count = last - first + 1;
+
+        // Taps outside the image are folded onto the edge pixels
+        double sum = 0.0;
+        for(int t = 0; t < count; t++) w[t] = 0.0;
+        for(int k = lo; k < hi; k++){
+            double weight = filter_eval(filter, (k + 0.5 - center) / stretch);
+            int clamped = k < first ? first : (k > last ? last : k);
+            w[clamped - first] += weight;
+            sum += weight;
+        }
+        if(sum == 0.0){
+            // Nothing covered, fall back to the nearest source pixel
+            int nearest = (int)center;
+            if(nearest > last) nearest = last;
+            if(nearest < first) nearest = first;
+            w[nearest - first] = 1.0;
+            sum = 1.0;
+        }
+
+        // Quantize, then give the rounding error to the largest weight
+        short* q = &table->weights[(size_t)i * table->taps];
+        int total = 0, largest = 0;
+        for(int t = 0; t < count; t++){
+            q[t] = (short)lround(w[t] / sum * WEIGHT_ONE);
+            total += q[t];
+            if(q[t] > q[largest]) largest = t;
+        }
+        q[largest] += WEIGHT_ONE - total;
+        table->start[i] = first;
+        table->count[i] = count;
+    }
+    buffer_pool_free(w, table->taps * sizeof(double));
+    return 1;
+}
+
+// Context for the two resampling passes
+struct ResampleBands {
+    Image* src;                      // Source rows first_row ..
+    Image* tmp;                      // Horizontally filtered rows tmp_row ..
+    Image* dst;                      // Output rows begin ..
+    int first_row;
+    int tmp_row;
+    int begin;
+    const struct ResampleWeights* x;
+    const struct ResampleWeights* y;
+    const struct PointProgram* pre;
+    const struct PointProgram* post;
+    int failed;                      // Set if a band could not allocate its scratch memory
+};
+
+// Function to filter a band of intermediate rows horizontally
+static void horizontal_band(void* ctx, int begin, int end) {
+    struct ResampleBands* job = (struct ResampleBands*)ctx;
+    const struct ResampleWeights* x = job->x;
+    const struct PixelKernels* kernels = pixel_kernels();
+    int src_width = job->src->width;
+    struct Pixel* scratch = NULL;
+    if(job->pre != NULL){
+        scratch = (struct Pixel*)buffer_pool_alloc(src_width * sizeof(struct Pixel));
+        if(scratch == NULL){
+            perror("Failed to allocate memory for resampling row");
+            job->failed = 1;
+            return;
+        }
+    }
+
+    for(int i = begin; i < end; i++){
+        const struct Pixel* src = image_get_row(job->src, job->tmp_row + i - job->first_row);
+        if(scratch != NULL){
+            memcpy(scratch, src, src_width * sizeof(struct Pixel));
+            point_program_apply(job->pre, scratch, src_width);
+            src = scratch;
+        }
+        kernels->resample_row(src, src_width, image_get_row(job->tmp, i), x->length,
+                              x->start, x->count, x->weights, x->taps);
+    }
+    buffer_pool_free(scratch, src_width * sizeof(struct Pixel));
+}
+
+// Function to combine intermediate rows vertically into a band of output rows
+static void vertical_band(void* ctx, int begin, int end) {
+    struct ResampleBands* job = (struct ResampleBands*)ctx;
+    const struct ResampleWeights* y = job->y;
+    const struct PixelKernels* kernels = pixel_kernels();
+    int bytes = job->dst->width * (int)sizeof(struct Pixel);
+    const unsigned char** rows = (const unsigned char**)buffer_pool_alloc(y->taps * sizeof(const unsigned char*));
+    if(rows == NULL){
+        perror("Failed to allocate memory for resampling rows");
+        job->failed = 1;
+        return;
+    }
+
+    for(int i = begin; i < end; i++){
+        int out_i = job->begin + i;
+        for(int t = 0; t < y->count[out_i]; t++){
+            rows[t] = (const unsigned char*)image_get_row(job->tmp, y->start[out_i] + t - job->tmp_row);
+        }
+        unsigned char* out = (unsigned char*)image_get_row(job->dst, i);
+        kernels->blend_rows(out, rows, &y->weights[(size_t)out_i * y->taps], y->count[out_i], bytes);
+        if(job->post != NULL){
+            point_program_apply(job->post, (struct Pixel*)out, job->dst->width);
+        }
+    }
+    buffer_pool_free(rows, y->taps * sizeof(const unsigned char*));
+}
+
+// Function to build the weight tables of a plan
+int resample_plan_init(struct ResamplePlan* plan, int width, int height, int new_width, int new_height,
+                       enum ResampleFilter filter) {
+    plan->source_width = width;
+    plan->source_height = height;
+    if(!build_weights(&plan->x, width, new_width, filter)) return 0;
+    if(!build_weights(&plan->y, height, new_height, filter)){
+        free_weights(&plan->x);
+        return 0;
+    }
+    return 1;
+}
+
+// Function to release the weight tables of a plan
+void resample_plan_free(struct ResamplePlan* plan) {
+    free_weights(&plan->x);
+    free_weights(&plan->y);
+}
+
+// Function to get the source rows read by a range of output rows
+void resample_plan_source_rows(const struct ResamplePlan* plan, int begin, int end, int* first, int* last) {
+    // Windows only move forward, so the ends of the range bound it
+    *first = plan->y.start[begin];
+    *last = plan->y.start[end - 1] + plan->y.count[end - 1] - 1;
+}
+
+// Function to resample a range of output rows
+int resample_rows(const struct ResamplePlan* plan, Image* src, int first_row, Image* dst, int begin, int end,
+                  const struct PointProgram* pre, const struct PointProgram* post) {
+    if(pre != NULL && point_program_is_empty(pre)) pre = NULL;
+    if(post != NULL && point_program_is_empty(post)) post = NULL;
+
+    // Only source rows some output row reads are filtered horizontally
+    int tmp_row, last_row;
+    resample_plan_source_rows(plan, begin, end, &tmp_row, &last_row);
+    Image* tmp = image_create_ex(plan->x.length, last_row - tmp_row + 1, dst->flags);
+    if(tmp == NULL){
+        return 0;
+    }
+
+    struct ResampleBands job = {src, tmp, dst, first_row, tmp_row, begin, &plan->x, &plan->y, pre, post, 0};
+    threadpool_run_bands(threadpool_get_default(), tmp->height, horizontal_band, &job);
+    if(!job.failed){
+        threadpool_run_bands(threadpool_get_default(), end - begin, vertical_band, &job);
+    }
+
+    image_destroy(&tmp);
+    return !job.failed;
+}
+
+// Function to resample an image
+int resample_image(Image* img, int new_width, int new_height, enum ResampleFilter filter,
+                   const struct PointProgram* pre, const struct PointProgram* post) {
+    // The kernels filter packed BGR rows, other layouts are converted around them
+    enum ImageLayout layout = image_get_layout(img);
+    if(!image_convert_layout(img, IMAGE_LAYOUT_BGR)) return 0;
+
+    struct ResamplePlan plan;
+    if(!resample_plan_init(&plan, img->width, img->height, new_width, new_height, filter)){
+        image_convert_layout(img, layout);
+        return 0;
+    }
+
+    Image* dst = image_create_ex(new_width, new_height, img->flags);
+    int ok = dst != NULL && resample_rows(&plan, img, 0, dst, 0, new_height, pre, post);
+    resample_plan_free(&plan);
+    if(!ok){
+        // The source is untouched, give it back in the layout it came in
+        image_destroy(&dst);
+        image_convert_layout(img, layout);
+        return 0;
+    }
+    image_take_pixels(img, &dst);
+    return image_convert_layout(img, layout);
+}
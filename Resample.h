@@ -0,0 +1,127 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Resample.h
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "Image.h"
+#include "PointOps.h"
+
+// Resampling filters
+enum ResampleFilter {
+    RESAMPLE_NEAREST,  // Nearest neighbor, see Resize.h
+    RESAMPLE_BILINEAR, // Triangle filter, support 1
+    RESAMPLE_BICUBIC,  // Catmull-Rom cubic, support 2
+    RESAMPLE_LANCZOS,  // Lanczos with 3 lobes, support 3
+    RESAMPLE_BOX       // Box filter, averages the covered area when downscaling
+};
+
+// Fixed point weights of one axis. Output index i reads source indices
+// start[i] .. start[i] + count[i] - 1 with weights[i * taps ...]. taps is
+// a multiple of 4 and the weights past count[i] are zero, see PixelKernels.h.
+struct ResampleWeights {
+    int* start;
+    int* count;
+    short* weights;
+    int taps;
+    int length;
+};
+
+// Weight tables of both axes for one resampling
+struct ResamplePlan {
+    struct ResampleWeights x;
+    struct ResampleWeights y;
+    int source_width;
+    int source_height;
+};
+
+/* Looks up a filter by its name (nearest, bilinear, bicubic, lanczos, box).
+ *
+ * @param  name: the name.
+ * @param  filter: receives the filter.
+ * @return 1 if the name is known, 0 otherwise.
+*/
+int resample_filter_from_name(const char* name, enum ResampleFilter* filter);
+
+/* Returns the name of a filter.
+ *
+ * @param  filter: the filter.
+*/
+const char* resample_filter_name(enum ResampleFilter filter);
+
+/* Resamples an image to a new size with a separable filter. Fixed point
+ * weight tables are built once per axis, then a horizontal pass filters
+ * every needed source row into an intermediate image and a vertical pass
+ * combines intermediate rows into output rows. Both passes run in parallel
+ * row bands. When downscaling, the filter is stretched to cover the whole
+ * source area of every output pixel. The kernels work on packed BGR rows,
+ * so an image of another layout is converted to BGR and back, also when
+ * resampling fails.
+ *
+ * @param  img: the image, replaced by the result.
+ * @param  new_width: width of the result.
+ * @param  new_height: height of the result.
+ * @param  filter: the filter, not RESAMPLE_NEAREST.
+ * @param  pre: point program applied to source pixels before filtering, may be NULL.
+ * @param  post: point program applied to output pixels after filtering, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int resample_image(Image* img, int new_width, int new_height, enum ResampleFilter filter,
+                   const struct PointProgram* pre, const struct PointProgram* post);
+
+/* Builds the weight tables for resampling between two sizes.
+ *
+ * @param  plan: the plan.
+ * @param  width: source width.
+ * @param  height: source height.
+ * @param  new_width: width of the result.
+ * @param  new_height: height of the result.
+ * @param  filter: the filter, not RESAMPLE_NEAREST.
+ * @return 1 on success, 0 on failure.
+*/
+int resample_plan_init(struct ResamplePlan* plan, int width, int height, int new_width, int new_height,
+                       enum ResampleFilter filter);
+
+/* Releases the weight tables of a plan.
+ *
+ * @param  plan: the plan.
+*/
+void resample_plan_free(struct ResamplePlan* plan);
+
+/* Returns the range of source rows read by a range of output rows.
+ *
+ * @param  plan: the plan.
+ * @param  begin: the first output row.
+ * @param  end: one past the last output row.
+ * @param  first: receives the first source row.
+ * @param  last: receives the last source row.
+*/
+void resample_plan_source_rows(const struct ResamplePlan* plan, int begin, int end, int* first, int* last);
+
+/* Resamples a range of output rows into an existing image. The source image
+ * only has to hold the source rows the range reads, see
+ * resample_plan_source_rows, which lets large images be resampled strip by
+ * strip.
+ *
+ * @param  plan: the plan.
+ * @param  src: the source rows, row 0 holds source row first_row.
+ * @param  first_row: the source row held in row 0 of src.
+ * @param  dst: receives output rows begin .. end - 1 in its rows 0 .. end - begin - 1.
+ * @param  begin: the first output row.
+ * @param  end: one past the last output row.
+ * @param  pre: point program applied to source pixels before filtering, may be NULL.
+ * @param  post: point program applied to output pixels after filtering, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int resample_rows(const struct ResamplePlan* plan, Image* src, int first_row, Image* dst, int begin, int end,
+                  const struct PointProgram* pre, const struct PointProgram* post);
+
+#endif // RESAMPLE_H
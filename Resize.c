@@ -0,0 +1,354 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Resize.c
+
+#include "Resize.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+// Function to initialize an axis to the identity
+void resize_axis_init(struct ResizeAxis* axis, int source_length) {
+    axis->map = NULL;
+    axis->length = source_length;
+    axis->source_length = source_length;
+    axis->kind = RESIZE_IDENTITY;
+    axis->step = 1;
+}
+
+// Function to classify the table of an axis
+static void classify_axis(struct ResizeAxis* axis) {
+    const int* map = axis->map;
+    int n = axis->length;
+
+    // Exact integer upscaling repeats every source index step times
+    if(n % axis->source_length == 0){
+        int step = n / axis->source_length;
+        int i = 0;
+        while(i < n && map[i] == i / step) i++;
+        if(i == n){
+            axis->kind = step == 1 ? RESIZE_IDENTITY : RESIZE_REPLICATE;
+            axis->step = step;
+            return;
+        }
+    }
+    // Exact integer downscaling keeps every step-th source index
+    if(n > 1 && map[0] == 0 && map[1] > 1){
+        int step = map[1];
+        int i = 0;
+        while(i < n && map[i] == i * step) i++;
+        if(i == n){
+            axis->kind = RESIZE_DECIMATE;
+            axis->step = step;
+            return;
+        }
+    }
+    axis->kind = RESIZE_GENERIC;
+    axis->step = 1;
+}
+
+// Function to compose a scaling onto an axis
+int resize_axis_scale(struct ResizeAxis* axis, float factor) {
+    if(factor <= 0){
+        fprintf(stderr, "Scaling factor must be greater than 0.\n");
+        return 0;
+    }
+    int length = axis->length;
+    int new_length = (int)(length * factor);
+    if(new_length == 0) new_length = 1;
+
+    int* map = (int*)buffer_pool_alloc(new_length * sizeof(int));
+    if(map == NULL){
+        perror("Failed to allocate memory for resize index table");
+        return 0;
+    }
+    for(int i = 0; i < new_length; i++){
+        int orig = (int)(i / factor);
+        if(orig >= length) orig = length - 1;
+        map[i] = axis->map ? axis->map[orig] : orig;
+    }
+    buffer_pool_free(axis->map, length * sizeof(int));
+    axis->map = map;
+    axis->length = new_length;
+    classify_axis(axis);
+    return 1;
+}
+
+// Function to release the table of an axis
+void resize_axis_free(struct ResizeAxis* axis) {
+    buffer_pool_free(axis->map, axis->length * sizeof(int));
+    axis->map = NULL;
+}
+
+// Row kernel: gather through an index table
+static void gather_generic(struct Pixel* dst, const struct Pixel* src, const int* map, int n) {
+    for(int j = 0; j < n; j++) dst[j] = src[map[j]];
+}
+
+// Row kernel: keep every step-th pixel, with constant steps for 2 and 4
+static void gather_decimate(struct Pixel* dst, const struct Pixel* src, int step, int n) {
+    switch(step){
+        case 2:
+            for(int j = 0; j < n; j++) dst[j] = src[2 * j];
+            break;
+        case 4:
+            for(int j = 0; j < n; j++) dst[j] = src[4 * j];
+            break;
+        default:
+            for(int j = 0; j < n; j++) dst[j] = src[j * step];
+            break;
+    }
+}
+
+// Row kernel: write every source pixel step times, unrolled for 2, 3 and 4
+static void expand_replicate(struct Pixel* dst, const struct Pixel* src, int step, int n) {
+    switch(step){
+        case 2:
+            for(int j = 0; j < n; j++){
+                dst[0] = src[j];
+                dst[1] = src[j];
+                dst += 2;
+            }
+            break;
+        case 3:
+            for(int j = 0; j < n; j++){
+                dst[0] = src[j];
+                dst[1] = src[j];
+                dst[2] = src[j];
+                dst += 3;
+            }
+            break;
+        case 4:
+            for(int j = 0; j < n; j++){
+                dst[0] = src[j];
+                dst[1] = src[j];
+                dst[2] = src[j];
+                dst[3] = src[j];
+                dst += 4;
+            }
+            break;
+        default:
+            for(int j = 0; j < n; j++){
+                for(int k = 0; k < step; k++) *dst++ = src[j];
+            }
+            break;
+    }
+}
+
+// Context for resizing bands of output rows
+struct ResizeBands {
+    Image* src;
+    Image* dst;
+    int first_row;                   // Source row held in row 0 of src
+    int begin;                       // Output row written to row 0 of dst
+    const struct ResizeAxis* x;
+    const struct ResizeAxis* y;
+    const struct PointProgram* prog; // NULL if there is nothing to apply
+    const int* columns;              // Distinct source columns (RESIZE_GENERIC)
+    const int* expand;               // Index into columns of every output column (RESIZE_GENERIC)
+    int distinct;                    // Number of distinct source columns
+};
+
+// Function to gather the distinct source pixels of a row
+static void gather_distinct(const struct ResizeBands* job, struct Pixel* out, const struct Pixel* src) {
+    switch(job->x->kind){
+        case RESIZE_IDENTITY:
+        case RESIZE_REPLICATE:
+            memcpy(out, src, job->distinct * sizeof(struct Pixel));
+            break;
+        case RESIZE_DECIMATE:
+            gather_decimate(out, src, job->x->step, job->distinct);
+            break;
+        default:
+            gather_generic(out, src, job->columns, job->distinct);
+            break;
+    }
+}
+
+// Function to spread the distinct pixels of a row over the output row
+static void expand_distinct(const struct ResizeBands* job, struct Pixel* dst, const struct Pixel* distinct) {
+    if(job->x->kind == RESIZE_REPLICATE){
+        expand_replicate(dst, distinct, job->x->step, job->distinct);
+    }
+    else{
+        gather_generic(dst, distinct, job->expand, job->dst->width);
+    }
+}
+
+// Function to resize a band of output rows. A repeated source row is copied
+// from the previous output row of the same band, so bands never read rows
+// written by another thread. Each distinct source pixel is filtered once.
+static void resize_band(void* ctx, int begin, int end) {
+    struct ResizeBands* job = (struct ResizeBands*)ctx;
+    int width = job->dst->width;
+    size_t row_bytes = (size_t)width * sizeof(struct Pixel);
+    int direct = job->distinct == width;
+
+    // Scratch row for the distinct pixels when they are fewer than the output
+    // pixels; without it the output is gathered directly and filtered per column
+    struct Pixel* scratch = NULL;
+    if(!direct){
+        scratch = (struct Pixel*)buffer_pool_alloc(job->distinct * sizeof(struct Pixel));
+    }
+
+    for(int i = begin; i < end; i++){
+        int out_i = job->begin + i;
+        struct Pixel* dst = image_get_row(job->dst, i);
+        int orig_i = job->y->map ? job->y->map[out_i] : out_i;
+        if(i > begin && job->y->map && orig_i == job->y->map[out_i - 1]){
+            memcpy(dst, image_get_row(job->dst, i - 1), row_bytes);
+            continue;
+        }
+        const struct Pixel* src = image_get_row(job->src, orig_i - job->first_row);
+
+        if(direct){
+            gather_distinct(job, dst, src);
+            if(job->prog) point_program_apply(job->prog, dst, width);
+        }
+        else if(job->prog == NULL && job->x->kind == RESIZE_REPLICATE){
+            expand_replicate(dst, src, job->x->step, job->distinct);
+        }
+        else if(job->prog == NULL){
+            gather_generic(dst, src, job->x->map, width);
+        }
+        else if(scratch != NULL){
+            gather_distinct(job, scratch, src);
+            point_program_apply(job->prog, scratch, job->distinct);
+            expand_distinct(job, dst, scratch);
+        }
+        else{
+            gather_generic(dst, src, job->x->map, width);
+            point_program_apply(job->prog, dst, width);
+        }
+    }
+    buffer_pool_free(scratch, job->distinct * sizeof(struct Pixel));
+}
+
+// Function to gather one row of one plane whose pixels are 1 or 4 bytes
+static void gather_plane_row(unsigned char* dst, const unsigned char* src, const int* map, int width, int bytes) {
+    if(map == NULL){
+        memcpy(dst, src, (size_t)width * bytes);
+    }
+    else if(bytes == 4){
+        uint32_t* d = (uint32_t*)dst;
+        const uint32_t* s = (const uint32_t*)src;
+        for(int j = 0; j < width; j++) d[j] = s[map[j]];
+    }
+    else{
+        for(int j = 0; j < width; j++) dst[j] = src[map[j]];
+    }
+}
+
+// Function to resize a band of output rows of an indexed, BGRX or planar
+// image. Each plane is gathered like indices, one element per pixel, the
+// point program runs on the finished row, and repeated rows are copied.
+static void resize_plane_band(void* ctx, int begin, int end) {
+    struct ResizeBands* job = (struct ResizeBands*)ctx;
+    Image* dst = job->dst;
+    int width = dst->width;
+    enum ImageLayout layout = image_get_layout(dst);
+    int planes = layout == IMAGE_LAYOUT_PLANAR ? 3 : 1;
+    int bytes = layout == IMAGE_LAYOUT_BGRX ? 4 : 1;
+    const int* map = job->x->map;
+    for(int i = begin; i < end; i++){
+        int out_i = job->begin + i;
+        int orig_i = job->y->map ? job->y->map[out_i] : out_i;
+        int repeated = i > begin && job->y->map && orig_i == job->y->map[out_i - 1];
+        for(int p = 0; p < planes; p++){
+            unsigned char* row = image_get_plane_row(dst, p, i);
+            if(repeated){
+                memcpy(row, image_get_plane_row(dst, p, i - 1), (size_t)width * bytes);
+            }
+            else{
+                gather_plane_row(row, image_get_plane_row(job->src, p, orig_i - job->first_row), map, width, bytes);
+            }
+        }
+        if(repeated || job->prog == NULL || image_is_indexed(dst)) continue;
+        if(layout == IMAGE_LAYOUT_BGRX){
+            point_program_apply_bgrx(job->prog, image_get_plane_row(dst, 0, i), width);
+        }
+        else{
+            point_program_apply_planar(job->prog, image_get_plane_row(dst, 0, i), image_get_plane_row(dst, 1, i),
+                                       image_get_plane_row(dst, 2, i), width);
+        }
+    }
+}
+
+// Function to resize a range of output rows with nearest neighbor index tables
+int resize_nearest_rows(Image* src, int first_row, Image* dst, int begin, int end,
+                        const struct ResizeAxis* x, const struct ResizeAxis* y,
+                        const struct PointProgram* prog) {
+    if(prog != NULL && point_program_is_empty(prog)) prog = NULL;
+
+    struct ResizeBands job = {src, dst, first_row, begin, x, y, prog, NULL, NULL, x->length};
+    if(image_is_indexed(src) || image_get_layout(src) != IMAGE_LAYOUT_BGR){
+        threadpool_run_bands(threadpool_get_default(), end - begin, resize_plane_band, &job);
+        return 1;
+    }
+    struct Arena scratch;
+    arena_init(&scratch, 2 * x->length * sizeof(int) + 2 * BUFFER_POOL_ALIGN);
+    if(x->kind == RESIZE_REPLICATE){
+        job.distinct = x->source_length;
+    }
+    else if(x->kind == RESIZE_GENERIC){
+        // Distinct source columns, and for each output column its distinct column
+        int* columns = (int*)arena_alloc(&scratch, x->length * sizeof(int));
+        int* expand = (int*)arena_alloc(&scratch, x->length * sizeof(int));
+        if(columns == NULL || expand == NULL){
+            arena_release(&scratch);
+            return 0;
+        }
+        int distinct = 0;
+        for(int j = 0; j < x->length; j++){
+            if(j == 0 || x->map[j] != x->map[j - 1]){
+                columns[distinct++] = x->map[j];
+            }
+            expand[j] = distinct - 1;
+        }
+        job.columns = columns;
+        job.expand = expand;
+        job.distinct = distinct;
+    }
+
+    threadpool_run_bands(threadpool_get_default(), end - begin, resize_band, &job);
+
+    arena_release(&scratch);
+    return 1;
+}
+
+// Function to resize an image with nearest neighbor index tables
+int resize_nearest(Image* img, const struct ResizeAxis* x, const struct ResizeAxis* y,
+                   const struct PointProgram* prog) {
+    Image* resized;
+    if(image_is_indexed(img)){
+        // Indices are only moved, the colors change in the palette
+        resized = image_create_indexed(x->length, y->length, img->colors);
+        if(resized == NULL){
+            return 0;
+        }
+        memcpy(resized->palette, img->palette, IMAGE_MAX_COLORS * sizeof(struct Pixel));
+        if(prog != NULL) image_apply_program(resized, prog);
+    }
+    else{
+        resized = image_create_layout(x->length, y->length, image_get_layout(img), img->flags);
+        if(resized == NULL){
+            return 0;
+        }
+    }
+    if(!resize_nearest_rows(img, 0, resized, 0, y->length, x, y, prog)){
+        image_destroy(&resized);
+        return 0;
+    }
+    image_take_pixels(img, &resized);
+    return 1;
+}
@@ -0,0 +1,95 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Resize.h
+
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include "Image.h"
+#include "PointOps.h"
+
+// Shape of a nearest neighbor index table, used to pick a specialized kernel
+enum ResizeKind {
+    RESIZE_IDENTITY,  // map[i] = i
+    RESIZE_REPLICATE, // map[i] = i / step, exact integer upscaling
+    RESIZE_DECIMATE,  // map[i] = i * step, exact integer downscaling
+    RESIZE_GENERIC    // Any other table
+};
+
+// Nearest neighbor source index table for one axis
+struct ResizeAxis {
+    int* map;            // Source index of every output index, NULL for the identity
+    int length;          // Output length
+    int source_length;   // Source length
+    enum ResizeKind kind;
+    int step;            // Step of RESIZE_REPLICATE and RESIZE_DECIMATE
+};
+
+/* Initializes an axis to the identity over a source length.
+ *
+ * @param  axis: the axis.
+ * @param  source_length: number of source pixels along the axis.
+*/
+void resize_axis_init(struct ResizeAxis* axis, int source_length);
+
+/* Composes one more nearest neighbor scaling onto an axis. The indices are
+ * computed exactly as image_apply_resize always has, (int)(i / factor),
+ * once per output index, and the table is then classified.
+ *
+ * @param  axis: the axis.
+ * @param  factor: the scaling factor, greater than 0.
+ * @return 1 on success, 0 on failure.
+*/
+int resize_axis_scale(struct ResizeAxis* axis, float factor);
+
+/* Releases the table of an axis.
+ *
+ * @param  axis: the axis.
+*/
+void resize_axis_free(struct ResizeAxis* axis);
+
+/* Resizes an image with nearest neighbor index tables and applies a point
+ * program to every distinct source pixel on the way, in parallel row bands.
+ * Repeated output rows are copied with memcpy, and exact 2x/3x/4x upscaling
+ * and 1/2 or 1/4 decimation use specialized row kernels. An indexed image
+ * has its indices gathered and the point program applied to its palette; a
+ * BGRX or planar image has its planes gathered and keeps its layout.
+ *
+ * @param  img: the image, replaced by the result.
+ * @param  x: the column table, its source length must be the image width.
+ * @param  y: the row table, its source length must be the image height.
+ * @param  prog: point program to apply, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int resize_nearest(Image* img, const struct ResizeAxis* x, const struct ResizeAxis* y,
+                   const struct PointProgram* prog);
+
+/* Resizes a range of output rows with nearest neighbor index tables into
+ * an existing image, like resize_nearest. The source image only has to hold
+ * the source rows the range reads, which lets large images be resized strip
+ * by strip. Both images must have the same layout. When src is indexed,
+ * dst must be indexed too and only the indices are gathered; prog is left
+ * for the caller to apply to the palette.
+ *
+ * @param  src: the source rows, row 0 holds source row first_row.
+ * @param  first_row: the source row held in row 0 of src.
+ * @param  dst: receives output rows begin .. end - 1 in its rows 0 .. end - begin - 1.
+ * @param  begin: the first output row.
+ * @param  end: one past the last output row.
+ * @param  x: the column table.
+ * @param  y: the row table.
+ * @param  prog: point program to apply, may be NULL.
+ * @return 1 on success, 0 on failure.
+*/
+int resize_nearest_rows(Image* src, int first_row, Image* dst, int begin, int end,
+                        const struct ResizeAxis* x, const struct ResizeAxis* y,
+                        const struct PointProgram* prog);
+
+#endif // RESIZE_H
@@ -0,0 +1,581 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Server.c
+
+#define _GNU_SOURCE
+
+#include "Server.h"
+#include "Resample.h"
+#include "Stats.h"
+#include "BufferPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Connections accepted but not served yet, beyond which new ones are turned away
+#define SERVER_QUEUE_CAPACITY 256
+#define SERVER_BACKLOG 64
+
+// Longest request line and most words in one
+#define SERVER_LINE_MAX 4096
+#define SERVER_MAX_WORDS 32
+
+// Largest BMP file a DATA request may send
+#define SERVER_MAX_DATA_BYTES (1024u * 1024 * 1024)
+
+// Number of recent requests the latency percentiles are computed over
+#define SERVER_LATENCY_WINDOW 1024
+
+// How often the accept loop checks for a shutdown, in milliseconds
+#define SERVER_POLL_MS 200
+
+// Connections that send nothing for this long are closed, in milliseconds.
+// An idle connection between requests gives its handler up sooner, after
+// SERVER_POLL_MS, when other connections are waiting for one.
+#define SERVER_IDLE_MS 30000
+
+// Set by the signal handler
+static volatile sig_atomic_t stop_requested = 0;
+
+// Shared state of a server
+struct Server {
+    int listen_fd;
+    const struct PipelineOptions* options;
+    pthread_mutex_t lock;
+    pthread_cond_t queue_cond;   // Signaled when a connection is queued or the server stops
+    int queue[SERVER_QUEUE_CAPACITY];
+    int queue_head;
+    int queue_count;
+    int* active_fds;             // Connection of every handler, -1 when idle
+    int active;
+    int stop;
+    unsigned long requests;
+    unsigned long failed;
+    double latencies[SERVER_LATENCY_WINDOW]; // Milliseconds, a ring of the most recent requests
+    int latency_count;
+    int latency_next;
+};
+
+// A handler thread and the pixel buffer it keeps between requests
+struct Handler {
+    struct Server* server;
+    int index;
+    pthread_t thread;
+    Image* buffer;
+};
+
+// A client connection with its read buffer
+struct Connection {
+    struct Server* server;
+    int fd;
+    char buffer[SERVER_LINE_MAX];
+    size_t begin;
+    size_t end;
+};
+
+// Function to note a shutdown signal
+static void handle_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// Function to send a whole buffer, without raising SIGPIPE if the client left
+static int send_all(int fd, const void* data, size_t length) {
+    const char* p = (const char*)data;
+    while(length > 0){
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return 0;
+        }
+        p += n;
+        length -= n;
+    }
+    return 1;
+}
+
+// Function to send a one line answer
+static int send_line(int fd, const char* line) {
+    return send_all(fd, line, strlen(line)) && send_all(fd, "\n", 1);
+}
+
+// Function to wait until a connection has bytes to read; returns 0 once it
+// has been idle too long, see SERVER_IDLE_MS. may_yield is set between
+// requests, when the handler may be given to a waiting connection.
+static int wait_readable(struct Connection* conn, int may_yield) {
+    struct Server* server = conn->server;
+    for(int waited = 0; ; waited += SERVER_POLL_MS){
+        struct pollfd pfd = {conn->fd, POLLIN, 0};
+        int n = poll(&pfd, 1, SERVER_POLL_MS);
+        if(n > 0) return 1;
+        if(n < 0 && errno != EINTR) return 0;
+
+        pthread_mutex_lock(&server->lock);
+        int waiting = server->queue_count > 0 || server->stop;
+        pthread_mutex_unlock(&server->lock);
+        if(waited + SERVER_POLL_MS >= SERVER_IDLE_MS || (waiting && may_yield)) return 0;
+    }
+}
+
+// Function to receive more bytes into the buffer of a connection; returns
+// 0 at the end of the stream, on an error or once the connection is idle
+static int fill_buffer(struct Connection* conn) {
+    if(conn->begin > 0){
+        memmove(conn->buffer, conn->buffer + conn->begin, conn->end - conn->begin);
+        conn->end -= conn->begin;
+        conn->begin = 0;
+    }
+    if(!wait_readable(conn, conn->end == 0)) return 0;
+    for(;;){
+        ssize_t n = recv(conn->fd, conn->buffer + conn->end, sizeof(conn->buffer) - conn->end, 0);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return 0;
+        conn->end += n;
+        return 1;
+    }
+}
+
+// Function to read the next request line, without its line ending; returns
+// NULL at the end of the stream, on an error, once the connection is idle
+// or if the line is too long
+static char* read_line(struct Connection* conn) {
+    size_t scanned = conn->begin;
+    for(;;){
+        char* newline = (char*)memchr(conn->buffer + scanned, '\n', conn->end - scanned);
+        if(newline != NULL){
+            char* line = conn->buffer + conn->begin;
+            *newline = '\0';
+            if(newline > line && newline[-1] == '\r') newline[-1] = '\0';
+            conn->begin = newline + 1 - conn->buffer;
+            return line;
+        }
+        scanned = conn->end - conn->begin; // Offset after fill_buffer moves the line to the front
+        if(conn->begin == 0 && conn->end == sizeof(conn->buffer)) return NULL;
+        if(!fill_buffer(conn)) return NULL;
+    }
+}
+
+// Function to read exactly length bytes that follow a request line
+static int read_bytes(struct Connection* conn, unsigned char* data, size_t length) {
+    size_t buffered = conn->end - conn->begin;
+    if(buffered > length) buffered = length;
+    memcpy(data, conn->buffer + conn->begin, buffered);
+    conn->begin += buffered;
+    size_t done = buffered;
+    while(done < length){
+        if(!wait_readable(conn, 0)) return 0;
+        ssize_t n = recv(conn->fd, data + done, length - done, 0);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return 0;
+        done += n;
+    }
+    return 1;
+}
+
+// Function to split a line into words in place
+static int split_words(char* line, char** words) {
+    int count = 0;
+    char* save = NULL;
+    for(char* word = strtok_r(line, " \t", &save); word != NULL; word = strtok_r(NULL, " \t", &save)){
+        if(count == SERVER_MAX_WORDS) return -1;
+        words[count++] = word;
+    }
+    return count;
+}
+
+// Function to parse a whole word as an integer
+static int parse_int(const char* word, int* value) {
+    char* end;
+    long v = strtol(word, &end, 10);
+    if(*word == '\0' || *end != '\0') return 0;
+    *value = (int)v;
+    return 1;
+}
+
+// Function to parse the value of a -R or -F option
+static int parse_geometry(char opt, const char* value, enum GeometryOp* op) {
+    if(opt == 'F' && (strcmp(value, "h") == 0 || strcmp(value, "v") == 0)){
+        *op = value[0] == 'h' ? GEOMETRY_FLIP_HORIZONTAL : GEOMETRY_FLIP_VERTICAL;
+        return 1;
+    }
+    if(opt != 'R') return 0;
+    if(strcmp(value, "90") == 0) *op = GEOMETRY_ROTATE_90;
+    else if(strcmp(value, "180") == 0) *op = GEOMETRY_ROTATE_180;
+    else if(strcmp(value, "270") == 0) *op = GEOMETRY_ROTATE_270;
+    else return 0;
+    return 1;
+}
+
+// Function to build the filter chain of request options, in the order the
+// command line applies them
+static int parse_request_options(char** words, int count, FilterChain* chain) {
+    int grayscale = 0, shift = 0, scale = 0;
+    int rShift = 0, gShift = 0, bShift = 0;
+    float factor = 1.0f;
+    enum ResampleFilter filter = RESAMPLE_NEAREST;
+    enum GeometryOp geometry[GEOMETRY_MAX_OPS];
+    int geometry_count = 0;
+
+    for(int i = 0; i < count; i++){
+        const char* opt = words[i];
+        const char* value = i + 1 < count ? words[i + 1] : NULL;
+        if(strcmp(opt, "-w") == 0){
+            grayscale = 1;
+            continue;
+        }
+        if(strcmp(opt, "-T") == 0){
+            if(geometry_count == GEOMETRY_MAX_OPS) return 0;
+            geometry[geometry_count++] = GEOMETRY_TRANSPOSE;
+            continue;
+        }
+        if(value == NULL) return 0;
+        i++;
+        if(strcmp(opt, "-r") == 0){
+            if(!parse_int(value, &rShift)) return 0;
+            shift = 1;
+        }
+        else if(strcmp(opt, "-g") == 0){
+            if(!parse_int(value, &gShift)) return 0;
+            shift = 1;
+        }
+        else if(strcmp(opt, "-b") == 0){
+            if(!parse_int(value, &bShift)) return 0;
+            shift = 1;
+        }
+        else if(strcmp(opt, "-s") == 0){
+            char* end;
+            factor = strtof(value, &end);
+            if(*end != '\0' || !(factor > 0)) return 0;
+            scale = 1;
+        }
+        else if(strcmp(opt, "-f") == 0){
+            if(!resample_filter_from_name(value, &filter)) return 0;
+        }
+        else if(strcmp(opt, "-R") == 0 || strcmp(opt, "-F") == 0){
+            if(geometry_count == GEOMETRY_MAX_OPS || !parse_geometry(opt[1], value, &geometry[geometry_count])){
+                return 0;
+            }
+            geometry_count++;
+        }
+        else{
+            return 0;
+        }
+    }
+
+    filter_chain_init(chain);
+    if(grayscale) filter_chain_add_grayscale(chain);
+    if(shift) filter_chain_add_colorshift(chain, rShift, gShift, bShift);
+    if(scale) filter_chain_add_resample(chain, factor, filter);
+    for(int k = 0; k < geometry_count; k++) filter_chain_add_geometry(chain, geometry[k]);
+    return 1;
+}
+
+// Helper function to sort latencies
+static int compare_latencies(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to format the server counters and latency percentiles
+static void format_stats(struct Server* server, char* line, size_t size) {
+    double sorted[SERVER_LATENCY_WINDOW];
+    pthread_mutex_lock(&server->lock);
+    int queue = server->queue_count;
+    int active = server->active;
+    unsigned long requests = server->requests;
+    unsigned long failed = server->failed;
+    int count = server->latency_count;
+    memcpy(sorted, server->latencies, count * sizeof(double));
+    pthread_mutex_unlock(&server->lock);
+
+    qsort(sorted, count, sizeof(double), compare_latencies);
+    double percentiles[3] = {0.50, 0.90, 0.99};
+    double values[3] = {0.0, 0.0, 0.0};
+    for(int p = 0; p < 3 && count > 0; p++){
+        int rank = (int)(percentiles[p] * count + 0.999999) - 1;
+        values[p] = sorted[rank < 0 ? 0 : rank];
+    }
+    snprintf(line, size, "OK queue=%d active=%d requests=%lu failed=%lu p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f",
+             queue, active, requests, failed, values[0], values[1], values[2], count > 0 ? sorted[count - 1] : 0.0);
+}
+
+// Function to serve one request; returns 1 if it succeeded, 0 if it failed
+// and -1 if the connection cannot go on. timed is cleared for requests kept
+// out of the latencies.
+static int serve_request(struct Handler* handler, struct Connection* conn, char* line, int* timed) {
+    struct Server* server = handler->server;
+    char* words[SERVER_MAX_WORDS];
+    int count = split_words(line, words);
+    if(count <= 0){
+        return send_line(conn->fd, "ERR malformed request") ? 0 : -1;
+    }
+
+    if(strcmp(words[0], "STATS") == 0){
+        // Answered at once, they would skew the latencies they report
+        *timed = 0;
+        char answer[256];
+        format_stats(server, answer, sizeof(answer));
+        return send_line(conn->fd, answer) ? 1 : -1;
+    }
+
+    FilterChain chain;
+    if(strcmp(words[0], "FILE") == 0){
+        // The daemon's own standard input and output are not the client's
+        if(count < 3 || strcmp(words[1], BMP_STDIO_NAME) == 0 || strcmp(words[2], BMP_STDIO_NAME) == 0 ||
+           !parse_request_options(words + 3, count - 3, &chain)){
+            return send_line(conn->fd, "ERR malformed request") ? 0 : -1;
+        }
+        if(!pipeline_process_file(words[1], words[2], &chain, server->options, &handler->buffer)){
+            return send_line(conn->fd, "ERR processing failed") ? 0 : -1;
+        }
+        char answer[SERVER_LINE_MAX + 8];
+        snprintf(answer, sizeof(answer), "OK %s", words[2]);
+        return send_line(conn->fd, answer) ? 1 : -1;
+    }
+
+    if(strcmp(words[0], "DATA") == 0){
+        char* end;
+        unsigned long long length = count >= 2 ? strtoull(words[1], &end, 10) : 0;
+        if(count < 2 || *end != '\0' || length == 0 || length > SERVER_MAX_DATA_BYTES){
+            // The payload cannot be skipped without a valid length
+            send_line(conn->fd, "ERR malformed request");
+            return -1;
+        }
+        unsigned char* data = (unsigned char*)buffer_pool_alloc(length);
+        if(data == NULL){
+            perror("Failed to allocate memory for request data");
+            send_line(conn->fd, "ERR out of memory");
+            return -1;
+        }
+        if(!read_bytes(conn, data, length)){
+            buffer_pool_free(data, length);
+            return -1;
+        }
+
+        int result;
+        if(!parse_request_options(words + 2, count - 2, &chain)){
+            result = send_line(conn->fd, "ERR malformed request") ? 0 : -1;
+        }
+        else{
+            size_t out_length = 0;
+            unsigned char* output = pipeline_process_buffer(data, length, &chain, &out_length);
+            if(output == NULL){
+                result = send_line(conn->fd, "ERR processing failed") ? 0 : -1;
+            }
+            else{
+                char answer[64];
+                snprintf(answer, sizeof(answer), "OK %zu", out_length);
+                result = send_line(conn->fd, answer) && send_all(conn->fd, output, out_length) ? 1 : -1;
+                bmp_buffer_free(output, out_length);
+            }
+        }
+        buffer_pool_free(data, length);
+        return result;
+    }
+
+    return send_line(conn->fd, "ERR unknown request") ? 0 : -1;
+}
+
+// Function to serve the requests of a connection until the client leaves
+static void serve_connection(struct Handler* handler, int fd) {
+    struct Server* server = handler->server;
+    struct Connection conn;
+    conn.server = server;
+    conn.fd = fd;
+    conn.begin = 0;
+    conn.end = 0;
+
+    char* line;
+    while((line = read_line(&conn)) != NULL){
+        unsigned long long start = stats_now();
+        int timed = 1;
+        int result = serve_request(handler, &conn, line, &timed);
+        double ms = (stats_now() - start) / 1e6;
+
+        pthread_mutex_lock(&server->lock);
+        server->requests++;
+        if(result <= 0) server->failed++;
+        if(timed){
+            server->latencies[server->latency_next] = ms;
+            server->latency_next = (server->latency_next + 1) % SERVER_LATENCY_WINDOW;
+            if(server->latency_count < SERVER_LATENCY_WINDOW) server->latency_count++;
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        if(result < 0) break;
+    }
+}
+
+// Handler thread main loop: serve queued connections one at a time
+static void* handler_main(void* arg) {
+    struct Handler* handler = (struct Handler*)arg;
+    struct Server* server = handler->server;
+    pthread_mutex_lock(&server->lock);
+    for(;;){
+        while(!server->stop && server->queue_count == 0){
+            pthread_cond_wait(&server->queue_cond, &server->lock);
+        }
+        if(server->stop) break;
+        int fd = server->queue[server->queue_head];
+        server->queue_head = (server->queue_head + 1) % SERVER_QUEUE_CAPACITY;
+        server->queue_count--;
+        server->active_fds[handler->index] = fd;
+        server->active++;
+        pthread_mutex_unlock(&server->lock);
+
+        serve_connection(handler, fd);
+
+        pthread_mutex_lock(&server->lock);
+        server->active_fds[handler->index] = -1;
+        server->active--;
+        close(fd);
+    }
+    pthread_mutex_unlock(&server->lock);
+    image_destroy(&handler->buffer);
+    return NULL;
+}
+
+// Function to bind a listening socket, replacing a stale socket file
+static int open_socket(const char* socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(socket_path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "Socket path is too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        perror("Error creating socket");
+        return -1;
+    }
+    int bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    if(!bound && errno == EADDRINUSE){
+        // Only a socket nobody listens on any more is replaced
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int refused = probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) != 0 && errno == ECONNREFUSED;
+        if(probe >= 0) close(probe);
+        if(refused && unlink(socket_path) == 0){
+            bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        }
+        else{
+            errno = EADDRINUSE;
+        }
+    }
+    if(!bound || listen(fd, SERVER_BACKLOG) != 0){
+        perror("Error listening on socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to serve requests until a shutdown signal
+int server_run(const char* socket_path, int handlers, const struct PipelineOptions* options) {
+    if(handlers < 1) handlers = 1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct Server* server = (struct Server*)calloc(1, sizeof(struct Server));
+    struct Handler* threads = (struct Handler*)calloc(handlers, sizeof(struct Handler));
+    int* active_fds = (int*)malloc(handlers * sizeof(int));
+    if(server == NULL || threads == NULL || active_fds == NULL){
+        perror("Failed to allocate memory for server");
+        free(server);
+        free(threads);
+        free(active_fds);
+        return 0;
+    }
+    server->listen_fd = open_socket(socket_path);
+    if(server->listen_fd < 0){
+        free(server);
+        free(threads);
+        free(active_fds);
+        return 0;
+    }
+    server->options = options;
+    server->active_fds = active_fds;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->queue_cond, NULL);
+
+    int started = 0;
+    for(int i = 0; i < handlers; i++){
+        active_fds[i] = -1;
+        threads[i].server = server;
+        threads[i].index = i;
+        if(pthread_create(&threads[i].thread, NULL, handler_main, &threads[i]) != 0){
+            fprintf(stderr, "Failed to start handler thread, using %d handlers.\n", started);
+            break;
+        }
+        started++;
+    }
+    printf("Listening on %s with %d handler(s).\n", socket_path, started);
+    fflush(stdout);
+
+    // Accept connections and queue them for the handlers
+    while(!stop_requested && started > 0){
+        struct pollfd pfd = {server->listen_fd, POLLIN, 0};
+        if(poll(&pfd, 1, SERVER_POLL_MS) <= 0) continue;
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if(fd < 0) continue;
+
+        pthread_mutex_lock(&server->lock);
+        int queued = server->queue_count < SERVER_QUEUE_CAPACITY;
+        if(queued){
+            server->queue[(server->queue_head + server->queue_count) % SERVER_QUEUE_CAPACITY] = fd;
+            server->queue_count++;
+            pthread_cond_signal(&server->queue_cond);
+        }
+        pthread_mutex_unlock(&server->lock);
+        if(!queued){
+            send_line(fd, "ERR server busy");
+            close(fd);
+        }
+    }
+
+    // Stop the handlers, waking those waiting on an idle client
+    pthread_mutex_lock(&server->lock);
+    server->stop = 1;
+    for(int i = 0; i < started; i++){
+        if(active_fds[i] >= 0) shutdown(active_fds[i], SHUT_RDWR);
+    }
+    pthread_cond_broadcast(&server->queue_cond);
+    pthread_mutex_unlock(&server->lock);
+    for(int i = 0; i < started; i++){
+        pthread_join(threads[i].thread, NULL);
+    }
+    for(int k = 0; k < server->queue_count; k++){
+        close(server->queue[(server->queue_head + k) % SERVER_QUEUE_CAPACITY]);
+    }
+
+    close(server->listen_fd);
+    unlink(socket_path);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->queue_cond);
+    free(active_fds);
+    free(threads);
+    free(server);
+    return started > 0;
+}
@@ -0,0 +1,51 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Server.h
+//
+// Daemon mode: filter requests served over a Unix domain socket. A client
+// may send any number of requests on one connection, each a line of space
+// separated words, answered before the next request is read:
+//
+//   FILE <input> <output> [options]    Filter a file into another file.
+//                                      Answer: OK <output>
+//   DATA <length> [options]            Filter <length> bytes of BMP file that
+//                                      follow the line. Answer: OK <length>,
+//                                      then the filtered BMP file.
+//   STATS                              Answer: OK queue=<connections waiting>
+//                                      active=<connections served> requests=<n>
+//                                      failed=<n> p50_ms=.. p90_ms=.. p99_ms=..
+//                                      max_ms=.., latencies of recent requests
+//                                      other than STATS.
+//
+// The options are those of the command line: -w, -r <value>, -g <value>,
+// -b <value>, -s <factor>, -f <filter>, -R <degrees>, -F <h|v> and -T. A
+// failed request is answered with ERR <reason>. Paths cannot contain
+// spaces.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "Pipeline.h"
+
+/* Serves requests until SIGINT or SIGTERM. Connections are served
+ * concurrently by a fixed set of handler threads, each keeping its pixel
+ * buffer warm between requests, and the filters share the default thread
+ * pool. A connection idle for 30 seconds is closed, and one idle between
+ * requests is closed at once when others wait for a handler. A stale socket
+ * left by a previous server is replaced.
+ *
+ * @param  socket_path: path of the socket to listen on.
+ * @param  handlers: number of connections served at the same time.
+ * @param  options: options for processing FILE requests.
+ * @return 1 after a clean shutdown, 0 if the socket could not be set up.
+*/
+int server_run(const char* socket_path, int handlers, const struct PipelineOptions* options);
+
+#endif // SERVER_H
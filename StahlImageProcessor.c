@@ -9,84 +9,392 @@
 
 // StahlImageProcessor.c
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include "BMPHandler.h"
-#include "Image.h"
+#include <getopt.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "Pipeline.h"
+#include "ThreadPool.h"
+#include "Resample.h"
+#include "Stats.h"
+#include "Server.h"
+#include "BufferPool.h"
+#include "Pyramid.h"
+#include "Stream.h"
+
+// Values getopt_long returns for the long options, past every short option
+#define OPTION_STATS 256
+#define OPTION_SERVE 257
+#define OPTION_POOL 258
+#define OPTION_LAYOUT 259
+#define OPTION_BLUR 260
+#define OPTION_BOX 261
+#define OPTION_SHARPEN 262
+#define OPTION_BORDER 263
+#define OPTION_PYRAMID 264
+#define OPTION_AUTO 265
+#define OPTION_PIPELINED 266
+
+// Largest number of --auto adjustments
+#define MAX_ADJUSTMENTS HISTOGRAM_ADJUST_COUNT
+
+// Command line options
+struct Options {
+    int first_input;         // Index in argv of the first input
+    char* list_filename;     // File listing more inputs, one per line
+    char* output_filename;
+    char* output_dir;
+
+    // Filter options
+    enum HistogramAdjust adjust[MAX_ADJUSTMENTS]; // Automatic adjustments, in command line order
+    int adjust_count;
+    int apply_grayscale;
+    int rShift, gShift, bShift;
+    int shift_red, shift_green, shift_blue;
+    float scale_factor;
+    int apply_scale;
+    enum ResampleFilter scale_filter;
+    double blur_sigma;       // 0 for no Gaussian blur
+    int box_radius;          // 0 for no box blur
+    double sharpen_amount;   // 0 for no sharpening
+    enum ConvolveBorder border;
+    enum GeometryOp geometry[GEOMETRY_MAX_OPS]; // Rotations and flips, in command line order
+    int geometry_count;
+
+    // Execution options
+    int use_hugepages;
+    int use_direct_io;
+    int threads;
+    size_t memory_budget;
+    int pipelined;           // Read and write streamed strips on threads of their own
+    int print_stats;
+    enum StatsFormat stats_format;
+    char* socket_path;       // Serve requests on this socket instead of processing inputs
+    long pool_megabytes;     // Retention limit of the buffer pool, -1 for the default
+    int layout;              // Pixel layout of whole images, PIPELINE_LAYOUT_AUTO by default
+    int pyramid_levels;      // Halved levels written next to every output, 0 for none
+};
+
+// Growing list of input file names
+struct InputList {
+    char** names;
+    int count;
+    int capacity;
+};
 
 // Function to display usage
 void print_usage(char* program_name) {
-    fprintf(stderr, "Usage: %s input.bmp [options]\n", program_name);
+    fprintf(stderr, "Usage: %s input.bmp... [options]\n", program_name);
+    fprintf(stderr, "Inputs may be BMP files or directories of BMP files. A single input of -\n");
+    fprintf(stderr, "reads standard input and writes standard output unless -o is given.\n");
     fprintf(stderr, "Options:\n");
-    fprintf(stderr, "  -o output.bmp           Specify output file name.\n");
+    fprintf(stderr, "  -o output.bmp           Specify output file name (single input only), - for\n");
+    fprintf(stderr, "                          standard output.\n");
+    fprintf(stderr, "  -O <directory>          Write outputs into <directory>, keeping their names.\n");
+    fprintf(stderr, "  -L <list>               Also process the files listed in <list>, one per line.\n");
+    fprintf(stderr, "  --auto=<adjustment>     Adjust the image from its histogram before the other\n");
+    fprintf(stderr, "                          filters: levels (stretch every channel), equalize or\n");
+    fprintf(stderr, "                          balance (gray world white balance). May be repeated.\n");
     fprintf(stderr, "  -w                      Apply grayscale filter.\n");
     fprintf(stderr, "  -r <value>              Shift red channel by <value>.\n");
     fprintf(stderr, "  -g <value>              Shift green channel by <value>.\n");
     fprintf(stderr, "  -b <value>              Shift blue channel by <value>.\n");
     fprintf(stderr, "  -s <factor>             Scale image by <factor>.\n");
+    fprintf(stderr, "  -f <filter>             Scaling filter: nearest (default), bilinear, bicubic,\n");
+    fprintf(stderr, "                          lanczos or box.\n");
+    fprintf(stderr, "  --blur=<sigma>          Gaussian blur with a standard deviation of <sigma>\n");
+    fprintf(stderr, "                          pixels, at most 16.\n");
+    fprintf(stderr, "  --box=<radius>          Box blur over 2 * <radius> + 1 pixels, at most 1000.\n");
+    fprintf(stderr, "  --sharpen=<amount>      Unsharp mask of strength <amount>, at most 16.\n");
+    fprintf(stderr, "  --border=<border>       Pixels past the edges for blurs and sharpening:\n");
+    fprintf(stderr, "                          clamp (default), mirror, wrap or zero.\n");
+    fprintf(stderr, "                          Blurs and sharpening run after scaling, in this order.\n");
+    fprintf(stderr, "  -R <degrees>            Rotate clockwise by 90, 180 or 270 degrees.\n");
+    fprintf(stderr, "  -F <h|v>                Flip horizontally (h) or vertically (v).\n");
+    fprintf(stderr, "  -T                      Transpose, swapping rows and columns.\n");
+    fprintf(stderr, "                          Rotations and flips run after the other filters,\n");
+    fprintf(stderr, "                          in the order given.\n");
+    fprintf(stderr, "  --pyramid[=<levels>]    Also write the filtered image halved <levels> times\n");
+    fprintf(stderr, "                          (default: 4) with 2x2 averaging, each level from the\n");
+    fprintf(stderr, "                          one before, as <output>_2.bmp, <output>_4.bmp, ...\n");
+    fprintf(stderr, "  -H                      Back the pixel buffer with huge pages.\n");
+    fprintf(stderr, "  -D                      Write the output file with direct I/O.\n");
+    fprintf(stderr, "  -j <threads>            Number of threads (default: number of CPUs).\n");
+    fprintf(stderr, "  -M <megabytes>          Stream the image in strips, using at most <megabytes>\n");
+    fprintf(stderr, "                          of pixel buffers.\n");
+    fprintf(stderr, "  --pipelined             With -M, read the next strips and write the finished\n");
+    fprintf(stderr, "                          ones on threads of their own while filtering.\n");
+    fprintf(stderr, "  --stats[=text|json]     Print stage timings, bytes moved, allocations, peak\n");
+    fprintf(stderr, "                          memory and the filter plan on one line on stderr.\n");
+    fprintf(stderr, "  --serve=<socket>        Run as a daemon serving filter requests on a Unix\n");
+    fprintf(stderr, "                          socket, see Server.h; no inputs are given.\n");
+    fprintf(stderr, "  --pool=<megabytes>      Keep at most <megabytes> of released buffers for\n");
+    fprintf(stderr, "                          reuse (default: 512), 0 to free them right away.\n");
+    fprintf(stderr, "  --layout=<layout>       Pixel layout images are filtered in: bgr, bgrx or\n");
+    fprintf(stderr, "                          planar (default: bgrx for 32-bit inputs, else bgr).\n");
 }
 
 // Function to parse command line arguments
-int parse_arguments(int argc, char *argv[], char **input_filename, char **output_filename,
-                    int *apply_grayscale, int *shift_red, int *rShift, int *shift_green, int *gShift,
-                    int *shift_blue, int *bShift, int *apply_scale, float *scale_factor) {
+int parse_arguments(int argc, char *argv[], struct Options *options) {
     if(argc < 2){
         print_usage(argv[0]);
         return -1;
     }
 
+    memset(options, 0, sizeof(*options));
+    options->scale_factor = 1.0;
+    options->scale_filter = RESAMPLE_NEAREST;
+    options->pool_megabytes = -1;
+    options->layout = PIPELINE_LAYOUT_AUTO;
+
+    static const struct option long_options[] = {
+        {"stats", optional_argument, NULL, OPTION_STATS},
+        {"serve", required_argument, NULL, OPTION_SERVE},
+        {"pool", required_argument, NULL, OPTION_POOL},
+        {"layout", required_argument, NULL, OPTION_LAYOUT},
+        {"blur", required_argument, NULL, OPTION_BLUR},
+        {"box", required_argument, NULL, OPTION_BOX},
+        {"sharpen", required_argument, NULL, OPTION_SHARPEN},
+        {"border", required_argument, NULL, OPTION_BORDER},
+        {"pyramid", optional_argument, NULL, OPTION_PYRAMID},
+        {"auto", required_argument, NULL, OPTION_AUTO},
+        {"pipelined", no_argument, NULL, OPTION_PIPELINED},
+        {NULL, 0, NULL, 0}
+    };
+
     int opt;
     // Reset getopt
     opterr = 0;
-    while((opt = getopt(argc, argv, "o:wr:g:b:s:")) != -1){
+    while((opt = getopt_long(argc, argv, "o:O:L:wr:g:b:s:f:R:F:THDj:M:", long_options, NULL)) != -1){
         char *endptr;
         switch(opt){
             case 'o':
-                *output_filename = optarg;
+                options->output_filename = optarg;
+                break;
+            case 'O':
+                options->output_dir = optarg;
+                break;
+            case 'L':
+                options->list_filename = optarg;
                 break;
             case 'w':
-                *apply_grayscale = 1;
+                options->apply_grayscale = 1;
                 break;
             case 'r':
-                *rShift = strtol(optarg, &endptr, 10);
+                options->rShift = strtol(optarg, &endptr, 10);
                 if(*endptr != '\0'){
                     fprintf(stderr, "Invalid value for -r: %s\n", optarg);
                     return -1;
                 }
-                *shift_red = 1;
+                options->shift_red = 1;
                 break;
             case 'g':
-                *gShift = strtol(optarg, &endptr, 10);
+                options->gShift = strtol(optarg, &endptr, 10);
                 if(*endptr != '\0'){
                     fprintf(stderr, "Invalid value for -g: %s\n", optarg);
                     return -1;
                 }
-                *shift_green = 1;
+                options->shift_green = 1;
                 break;
             case 'b':
-                *bShift = strtol(optarg, &endptr, 10);
+                options->bShift = strtol(optarg, &endptr, 10);
                 if(*endptr != '\0'){
                     fprintf(stderr, "Invalid value for -b: %s\n", optarg);
                     return -1;
                 }
-                *shift_blue = 1;
+                options->shift_blue = 1;
                 break;
             case 's':
-                *scale_factor = strtof(optarg, &endptr);
+                options->scale_factor = strtof(optarg, &endptr);
                 if(*endptr != '\0'){
                     fprintf(stderr, "Invalid value for -s: %s\n", optarg);
                     return -1;
                 }
-                if(*scale_factor <= 0){
+                if(options->scale_factor <= 0){
                     fprintf(stderr, "Scaling factor must be greater than 0.\n");
                     return -1;
                 }
-                *apply_scale = 1;
+                options->apply_scale = 1;
+                break;
+            case 'f':
+                if(!resample_filter_from_name(optarg, &options->scale_filter)){
+                    fprintf(stderr, "Invalid value for -f: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'R':
+            case 'F':
+            case 'T': {
+                enum GeometryOp op;
+                if(opt == 'T'){
+                    op = GEOMETRY_TRANSPOSE;
+                }
+                else if(opt == 'F' && (strcmp(optarg, "h") == 0 || strcmp(optarg, "v") == 0)){
+                    op = optarg[0] == 'h' ? GEOMETRY_FLIP_HORIZONTAL : GEOMETRY_FLIP_VERTICAL;
+                }
+                else if(opt == 'R' && strcmp(optarg, "90") == 0){
+                    op = GEOMETRY_ROTATE_90;
+                }
+                else if(opt == 'R' && strcmp(optarg, "180") == 0){
+                    op = GEOMETRY_ROTATE_180;
+                }
+                else if(opt == 'R' && strcmp(optarg, "270") == 0){
+                    op = GEOMETRY_ROTATE_270;
+                }
+                else{
+                    fprintf(stderr, "Invalid value for -%c: %s\n", opt, optarg);
+                    return -1;
+                }
+                if(options->geometry_count == GEOMETRY_MAX_OPS){
+                    fprintf(stderr, "Too many rotations and flips (at most %d).\n", GEOMETRY_MAX_OPS);
+                    return -1;
+                }
+                options->geometry[options->geometry_count++] = op;
+                break;
+            }
+            case 'H':
+                options->use_hugepages = 1;
+                break;
+            case 'D':
+                options->use_direct_io = 1;
+                break;
+            case 'j':
+                options->threads = strtol(optarg, &endptr, 10);
+                if(*endptr != '\0' || options->threads < 0){
+                    fprintf(stderr, "Invalid value for -j: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'M': {
+                long megabytes = strtol(optarg, &endptr, 10);
+                if(*endptr != '\0' || megabytes <= 0){
+                    fprintf(stderr, "Invalid value for -M: %s\n", optarg);
+                    return -1;
+                }
+                options->memory_budget = (size_t)megabytes * 1024 * 1024;
+                break;
+            }
+            case OPTION_STATS:
+                options->print_stats = 1;
+                if(optarg == NULL || strcmp(optarg, "text") == 0){
+                    options->stats_format = STATS_TEXT;
+                }
+                else if(strcmp(optarg, "json") == 0){
+                    options->stats_format = STATS_JSON;
+                }
+                else{
+                    fprintf(stderr, "Invalid value for --stats: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_SERVE:
+                options->socket_path = optarg;
+                break;
+            case OPTION_POOL:
+                options->pool_megabytes = strtol(optarg, &endptr, 10);
+                if(*endptr != '\0' || options->pool_megabytes < 0){
+                    fprintf(stderr, "Invalid value for --pool: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_LAYOUT: {
+                enum ImageLayout layout;
+                if(!image_layout_from_name(optarg, &layout)){
+                    fprintf(stderr, "Invalid value for --layout: %s\n", optarg);
+                    return -1;
+                }
+                options->layout = layout;
+                break;
+            }
+            case OPTION_BLUR: {
+                struct ConvolveKernel kernel;
+                options->blur_sigma = strtod(optarg, &endptr);
+                if(*endptr != '\0'){
+                    fprintf(stderr, "Invalid value for --blur: %s\n", optarg);
+                    return -1;
+                }
+                if(!convolve_kernel_gaussian(&kernel, options->blur_sigma, CONVOLVE_BORDER_CLAMP)){
+                    return -1;
+                }
+                break;
+            }
+            case OPTION_BOX: {
+                struct ConvolveKernel kernel;
+                options->box_radius = strtol(optarg, &endptr, 10);
+                if(*endptr != '\0'){
+                    fprintf(stderr, "Invalid value for --box: %s\n", optarg);
+                    return -1;
+                }
+                if(!convolve_kernel_box(&kernel, options->box_radius, CONVOLVE_BORDER_CLAMP)){
+                    return -1;
+                }
+                break;
+            }
+            case OPTION_SHARPEN: {
+                struct ConvolveKernel kernel;
+                options->sharpen_amount = strtod(optarg, &endptr);
+                if(*endptr != '\0'){
+                    fprintf(stderr, "Invalid value for --sharpen: %s\n", optarg);
+                    return -1;
+                }
+                if(!convolve_kernel_sharpen(&kernel, options->sharpen_amount, CONVOLVE_BORDER_CLAMP)){
+                    return -1;
+                }
+                break;
+            }
+            case OPTION_BORDER:
+                if(!convolve_border_from_name(optarg, &options->border)){
+                    fprintf(stderr, "Invalid value for --border: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_AUTO: {
+                enum HistogramAdjust adjust;
+                if(!histogram_adjust_from_name(optarg, &adjust)){
+                    fprintf(stderr, "Invalid value for --auto: %s\n", optarg);
+                    return -1;
+                }
+                if(options->adjust_count == MAX_ADJUSTMENTS){
+                    fprintf(stderr, "Too many automatic adjustments (at most %d).\n", MAX_ADJUSTMENTS);
+                    return -1;
+                }
+                options->adjust[options->adjust_count++] = adjust;
+                break;
+            }
+            case OPTION_PYRAMID:
+                options->pyramid_levels = 4;
+                if(optarg != NULL){
+                    options->pyramid_levels = strtol(optarg, &endptr, 10);
+                    if(*endptr != '\0' || options->pyramid_levels < 1 || options->pyramid_levels > PYRAMID_MAX_LEVELS){
+                        fprintf(stderr, "Invalid value for --pyramid: %s (1 to %d)\n", optarg, PYRAMID_MAX_LEVELS);
+                        return -1;
+                    }
+                }
+                break;
+            case OPTION_PIPELINED:
+                options->pipelined = 1;
                 break;
             case '?':
-                if(optopt == 'o' || optopt == 'r' || optopt == 'g' || optopt == 'b' || optopt == 's'){
+                if(optopt >= OPTION_STATS){
+                    // Only long options with a required argument get here
+                    for(int k = 0; long_options[k].name != NULL; k++){
+                        if(long_options[k].val == optopt){
+                            fprintf(stderr, "Option --%s requires an argument.\n", long_options[k].name);
+                        }
+                    }
+                }
+                else if(optopt == 0){
+                    fprintf(stderr, "Unknown option %s.\n", argv[optind - 1]);
+                }
+                else if(strchr("oOLrgbsfRFjM", optopt) != NULL){
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 }
                 else{
@@ -100,11 +408,9 @@ int parse_arguments(int argc, char *argv[], char **input_filename, char **output
         }
     }
 
-    // The first non-option argument is the input file
-    if(optind < argc){
-        *input_filename = argv[optind];
-    }
-    else{
+    // The non-option arguments are the inputs
+    options->first_input = optind;
+    if(optind >= argc && options->list_filename == NULL && options->socket_path == NULL){
         fprintf(stderr, "Input file not specified.\n");
         print_usage(argv[0]);
         return -1;
@@ -113,6 +419,122 @@ int parse_arguments(int argc, char *argv[], char **input_filename, char **output
     return 0;
 }
 
+// Function to add a copy of a file name to an input list
+int add_input(struct InputList* list, const char* name) {
+    if(list->count == list->capacity){
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        char** names = (char**)realloc(list->names, capacity * sizeof(char*));
+        if(names == NULL){
+            perror("Failed to allocate memory for input list");
+            return 0;
+        }
+        list->names = names;
+        list->capacity = capacity;
+    }
+    list->names[list->count] = strdup(name);
+    if(list->names[list->count] == NULL){
+        perror("Failed to allocate memory for input list");
+        return 0;
+    }
+    list->count++;
+    return 1;
+}
+
+// Function to release an input list
+void free_inputs(struct InputList* list) {
+    for(int i = 0; i < list->count; i++){
+        free(list->names[i]);
+    }
+    free(list->names);
+    list->names = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+// Helper function to sort file names
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Function to add the BMP files of a directory to an input list, sorted by name
+int add_directory(struct InputList* list, const char* dirname) {
+    DIR* dir = opendir(dirname);
+    if(dir == NULL){
+        perror("Error opening input directory");
+        return 0;
+    }
+    int first = list->count;
+    int ok = 1;
+    struct dirent* entry;
+    while(ok && (entry = readdir(dir)) != NULL){
+        size_t len = strlen(entry->d_name);
+        if(len <= 4 || strcasecmp(entry->d_name + len - 4, ".bmp") != 0) continue;
+
+        char* path = (char*)malloc(strlen(dirname) + 1 + len + 1);
+        if(path == NULL){
+            perror("Failed to allocate memory for file name");
+            ok = 0;
+            break;
+        }
+        sprintf(path, "%s/%s", dirname, entry->d_name);
+        struct stat st;
+        if(stat(path, &st) == 0 && S_ISREG(st.st_mode)){
+            ok = add_input(list, path);
+        }
+        free(path);
+    }
+    closedir(dir);
+    qsort(list->names + first, list->count - first, sizeof(char*), compare_names);
+    return ok;
+}
+
+// Function to add the files named in a list file to an input list
+int add_list_file(struct InputList* list, const char* list_filename) {
+    FILE* file = fopen(list_filename, "r");
+    if(file == NULL){
+        perror("Error opening input list");
+        return 0;
+    }
+    int ok = 1;
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    while(ok && (len = getline(&line, &size, file)) != -1){
+        // Strip the line ending, skip blank lines and comments
+        while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')){
+            line[--len] = '\0';
+        }
+        if(len == 0 || line[0] == '#') continue;
+        ok = add_input(list, line);
+    }
+    free(line);
+    fclose(file);
+    return ok;
+}
+
+// Function to tell whether a path names a directory
+int is_directory(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Function to collect all inputs: positional files, directories and a list file
+int collect_inputs(int argc, char *argv[], const struct Options* options, struct InputList* list) {
+    memset(list, 0, sizeof(*list));
+    for(int i = options->first_input; i < argc; i++){
+        int ok = is_directory(argv[i]) ? add_directory(list, argv[i]) : add_input(list, argv[i]);
+        if(!ok){
+            free_inputs(list);
+            return 0;
+        }
+    }
+    if(options->list_filename != NULL && !add_list_file(list, options->list_filename)){
+        free_inputs(list);
+        return 0;
+    }
+    return 1;
+}
+
 // Function to generate default output filename
 char* generate_output_filename(char* input_filename) {
     char* output_filename = NULL;
@@ -153,187 +575,296 @@ char* generate_output_filename(char* input_filename) {
     return output_filename;
 }
 
-// Function to free pixel array
-void free_pixel_array(struct Pixel** pArr, int height) {
-    for(int i = 0; i < height; i++){
-        free(pArr[i]);
+// Function to generate the output filename of an input inside an output directory
+char* generate_output_path(const char* output_dir, const char* input_filename) {
+    const char* slash = strrchr(input_filename, '/');
+    const char* name = slash ? slash + 1 : input_filename;
+    char* output_filename = (char*)malloc(strlen(output_dir) + 1 + strlen(name) + 1);
+    if(output_filename == NULL){
+        perror("Failed to allocate memory for output filename");
+        return NULL;
     }
-    free(pArr);
+    sprintf(output_filename, "%s/%s", output_dir, name);
+    return output_filename;
 }
 
-// Main function
-int main(int argc, char *argv[]) {
-    char* input_filename = NULL;
-    char* output_filename = NULL;
-    int output_filename_allocated = 0;
+// Function to build the filter chain in the order the filters are applied
+void build_filter_chain(const struct Options* options, FilterChain* chain) {
+    filter_chain_init(chain);
 
-    // Filter options
-    int apply_grayscale = 0;
-    int rShift = 0, gShift = 0, bShift = 0;
-    int shift_red = 0, shift_green = 0, shift_blue = 0;
-    float scale_factor = 1.0;
-    int apply_scale = 0;
+    // First, as when the input was normalized by a separate tool
+    for(int k = 0; k < options->adjust_count; k++){
+        filter_chain_add_adjust(chain, options->adjust[k]);
+    }
 
-    // Parse command-line arguments
-    if(parse_arguments(argc, argv, &input_filename, &output_filename,
-                       &apply_grayscale, &shift_red, &rShift, &shift_green, &gShift,
-                       &shift_blue, &bShift, &apply_scale, &scale_factor) != 0) {
-        return EXIT_FAILURE;
+    if(options->apply_grayscale){
+        filter_chain_add_grayscale(chain);
     }
 
-    // If output filename not specified, create default name
-    if(output_filename == NULL){
-        output_filename = generate_output_filename(input_filename);
-        if(output_filename == NULL){
-            // Error message already printed
-            return EXIT_FAILURE;
-        }
-        output_filename_allocated = 1;
+    if(options->shift_red || options->shift_green || options->shift_blue){
+        filter_chain_add_colorshift(chain, options->shift_red ? options->rShift : 0,
+                                    options->shift_green ? options->gShift : 0,
+                                    options->shift_blue ? options->bShift : 0);
     }
 
-    // Open input file
-    FILE* input_file = fopen(input_filename, "rb");
-    if(input_file == NULL){
-        perror("Error opening input file");
-        if(output_filename_allocated){
-            free(output_filename);
-        }
-        return EXIT_FAILURE;
+    if(options->apply_scale){
+        filter_chain_add_resample(chain, options->scale_factor, options->scale_filter);
     }
 
-    // Read BMP Header
-    struct BMP_Header bmp_header;
-    readBMPHeader(input_file, &bmp_header);
+    // Neighborhood filters, as when the output was blurred or sharpened by a
+    // separate tool
+    struct ConvolveKernel kernel;
+    if(options->blur_sigma > 0 && convolve_kernel_gaussian(&kernel, options->blur_sigma, options->border)){
+        filter_chain_add_convolve(chain, &kernel);
+    }
+    if(options->box_radius > 0 && convolve_kernel_box(&kernel, options->box_radius, options->border)){
+        filter_chain_add_convolve(chain, &kernel);
+    }
+    if(options->sharpen_amount > 0 && convolve_kernel_sharpen(&kernel, options->sharpen_amount, options->border)){
+        filter_chain_add_convolve(chain, &kernel);
+    }
 
-    // Validate BMP file
-    if(bmp_header.bfType != 0x4D42){
-        fprintf(stderr, "Input file is not a valid BMP file.\n");
-        fclose(input_file);
-        if(output_filename_allocated){
-            free(output_filename);
-        }
-        return EXIT_FAILURE;
+    // Last, as when the output was turned by a separate tool
+    for(int k = 0; k < options->geometry_count; k++){
+        filter_chain_add_geometry(chain, options->geometry[k]);
     }
+}
 
-    // Read DIB Header
-    struct DIB_Header dib_header;
-    readDIBHeader(input_file, &dib_header);
+// Function to get the pipeline options of the command line options
+void pipeline_options(const struct Options* options, struct PipelineOptions* pipeline) {
+    pipeline->alloc_flags = options->use_hugepages ? IMAGE_ALLOC_HUGEPAGES : IMAGE_ALLOC_DEFAULT;
+    pipeline->write_flags = options->use_direct_io ? BMP_WRITE_DIRECT : BMP_WRITE_DEFAULT;
+    pipeline->memory_budget = options->memory_budget;
+    pipeline->stream_flags = options->pipelined ? STREAM_PIPELINED : 0;
+    pipeline->layout = options->layout;
+    pipeline->pyramid_levels = options->pyramid_levels;
+}
 
-    // Validate BMP format (24-bit uncompressed)
-    if(dib_header.biBitCount != 24 || dib_header.biCompression != 0){
-        fprintf(stderr, "Unsupported BMP format. Only 24-bit uncompressed BMP files are supported.\n");
-        fclose(input_file);
-        if(output_filename_allocated){
-            free(output_filename);
-        }
-        return EXIT_FAILURE;
+// Function to share the memory budget between files processed concurrently
+void split_memory_budget(struct PipelineOptions* pipeline, size_t budget, int threads) {
+    pipeline->memory_budget = budget / threads;
+    if(budget > 0 && pipeline->memory_budget == 0){
+        pipeline->memory_budget = 1;
     }
+}
 
-    int width = dib_header.biWidth;
-    int height = dib_header.biHeight;
+// Function to serve requests on a socket with a warm thread pool
+int serve(const struct Options* options) {
+    ThreadPool* pool = threadpool_create(options->threads);
+    threadpool_set_default(pool);
+    struct PipelineOptions pipeline;
+    pipeline_options(options, &pipeline);
+    split_memory_budget(&pipeline, options->memory_budget, threadpool_get_threads(pool));
+    int served = server_run(options->socket_path, threadpool_get_threads(pool), &pipeline);
+    threadpool_destroy(&pool);
+    return served;
+}
 
-    // Allocate memory for pixels
-    struct Pixel** pArr = (struct Pixel**)malloc(height * sizeof(struct Pixel*));
-    if(pArr == NULL){
-        perror("Failed to allocate memory for pixel array");
-        fclose(input_file);
-        if(output_filename_allocated){
-            free(output_filename);
+// Shared state of a batch run
+struct Batch {
+    const struct InputList* inputs;
+    const struct Options* options;
+    FilterChain* chain;
+    struct PipelineOptions pipeline; // With the memory budget of each file being streamed
+    Image** buffers;         // Images not in use, recycled between files
+    int free_buffers;
+    pthread_mutex_t lock;
+    int failed;
+    size_t bytes;            // Total size of the inputs processed
+};
+
+// Function to process files of a batch, one pool item per file
+void batch_files(void* ctx, int begin, int end) {
+    struct Batch* batch = (struct Batch*)ctx;
+    for(int i = begin; i < end; i++){
+        const char* input_filename = batch->inputs->names[i];
+        char* output_filename = batch->options->output_dir != NULL ?
+            generate_output_path(batch->options->output_dir, input_filename) :
+            generate_output_filename((char*)input_filename);
+
+        // Take a recycled image
+        Image* buffer = NULL;
+        pthread_mutex_lock(&batch->lock);
+        if(batch->free_buffers > 0){
+            buffer = batch->buffers[--batch->free_buffers];
         }
-        return EXIT_FAILURE;
-    }
+        pthread_mutex_unlock(&batch->lock);
 
-    int allocation_failed = 0;
-    for(int i = 0; i < height; i++){
-        pArr[i] = (struct Pixel*)malloc(width * sizeof(struct Pixel));
-        if(pArr[i] == NULL){
-            perror("Failed to allocate memory for pixel row");
-            allocation_failed = 1;
-            // Free previously allocated rows
-            for(int j = 0; j < i; j++) free(pArr[j]);
-            break;
+        struct stat st;
+        int ok = output_filename != NULL &&
+                 pipeline_process_file(input_filename, output_filename, batch->chain, &batch->pipeline, &buffer);
+        if(!ok){
+            fprintf(stderr, "Failed to process %s.\n", input_filename);
         }
-    }
 
-    if(allocation_failed){
-        free(pArr);
-        fclose(input_file);
-        if(output_filename_allocated){
-            free(output_filename);
+        // Give the image back for the next file
+        pthread_mutex_lock(&batch->lock);
+        if(buffer != NULL){
+            batch->buffers[batch->free_buffers++] = buffer;
         }
-        return EXIT_FAILURE;
+        if(!ok){
+            batch->failed++;
+        }
+        else if(stat(input_filename, &st) == 0){
+            batch->bytes += st.st_size;
+        }
+        pthread_mutex_unlock(&batch->lock);
+        free(output_filename);
     }
+}
 
-    // Read pixel data
-    readPixelsBMP(input_file, pArr, width, height);
-    fclose(input_file);
-
-    // Create Image object
-    Image* img = image_create(pArr, width, height);
-    if(img == NULL){
-        // Error message already printed
-        free_pixel_array(pArr, height);
-        if(output_filename_allocated){
-            free(output_filename);
-        }
-        return EXIT_FAILURE;
+// Function to process a batch of files on the pool and print a summary
+int process_batch(const struct InputList* inputs, FilterChain* chain, const struct Options* options, ThreadPool* pool) {
+    if(options->output_dir != NULL && mkdir(options->output_dir, 0755) != 0 && errno != EEXIST){
+        perror("Error creating output directory");
+        return 0;
     }
 
-    // Apply filters
-    if(apply_grayscale){
-        image_apply_bw(img);
+    struct Batch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.inputs = inputs;
+    batch.options = options;
+    batch.chain = chain;
+    batch.buffers = (Image**)calloc(threadpool_get_threads(pool), sizeof(Image*));
+    if(batch.buffers == NULL){
+        perror("Failed to allocate memory for image buffers");
+        return 0;
+    }
+    // Files are processed concurrently, so each gets a share of the budget
+    pipeline_options(options, &batch.pipeline);
+    split_memory_budget(&batch.pipeline, options->memory_budget, threadpool_get_threads(pool));
+    pthread_mutex_init(&batch.lock, NULL);
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    threadpool_run_items(pool, inputs->count, batch_files, &batch);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    for(int i = 0; i < batch.free_buffers; i++){
+        image_destroy(&batch.buffers[i]);
     }
+    free(batch.buffers);
+    pthread_mutex_destroy(&batch.lock);
+
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    if(seconds <= 0) seconds = 1e-9;
+    int done = inputs->count - batch.failed;
+    printf("Processed %d of %d files in %.3f s on %d thread(s): %.1f files/s, %.1f MB/s.\n",
+           done, inputs->count, seconds, threadpool_get_threads(pool),
+           done / seconds, batch.bytes / seconds / (1024.0 * 1024.0));
+    return batch.failed == 0;
+}
+
+// Main function
+int main(int argc, char *argv[]) {
+    unsigned long long start = stats_now();
 
-    if(shift_red || shift_green || shift_blue){
-        image_apply_colorshift(img, shift_red ? rShift : 0, shift_green ? gShift : 0, shift_blue ? bShift : 0);
+    // Parse command-line arguments
+    struct Options options;
+    if(parse_arguments(argc, argv, &options) != 0) {
+        return EXIT_FAILURE;
+    }
+    if(options.pool_megabytes >= 0){
+        buffer_pool_set_limits((size_t)options.pool_megabytes * 1024 * 1024, BUFFER_POOL_DEFAULT_PER_CLASS);
     }
 
-    if(apply_scale){
-        if(!image_apply_resize(img, scale_factor)){
-            // Resize failed
-            image_destroy(&img);
-            if(output_filename_allocated){
-                free(output_filename);
-            }
-            return EXIT_FAILURE;
+    // In daemon mode inputs and filters come with the requests
+    if(options.socket_path != NULL){
+        int served = serve(&options);
+        if(options.print_stats){
+            stats_print(stderr, options.stats_format, start);
         }
+        return served ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    // Update headers if resized
-    if(apply_scale){
-        // Update BMP and DIB headers
-        makeBMPHeader(&bmp_header, img->width, img->height);
-        makeDIBHeader(&dib_header, img->width, img->height);
+    struct InputList inputs;
+    if(!collect_inputs(argc, argv, &options, &inputs)){
+        // Error message already printed
+        return EXIT_FAILURE;
+    }
+    if(inputs.count == 0){
+        fprintf(stderr, "No input files found.\n");
+        free_inputs(&inputs);
+        return EXIT_FAILURE;
     }
 
-    // Open output file
-    FILE* output_file = fopen(output_filename, "wb");
-    if(output_file == NULL){
-        perror("Error opening output file");
-        image_destroy(&img);
-        if(output_filename_allocated){
-            free(output_filename);
+    // Anything but a single input file and no output directory makes a batch
+    int batch = argc - options.first_input != 1 || is_directory(argv[options.first_input]) ||
+                options.list_filename != NULL || options.output_dir != NULL;
+    if(batch && options.output_filename != NULL){
+        fprintf(stderr, "Option -o cannot be used with several inputs, use -O instead.\n");
+        free_inputs(&inputs);
+        return EXIT_FAILURE;
+    }
+    for(int i = 0; batch && i < inputs.count; i++){
+        if(strcmp(inputs.names[i], BMP_STDIO_NAME) == 0){
+            fprintf(stderr, "Standard input cannot be part of a batch.\n");
+            free_inputs(&inputs);
+            return EXIT_FAILURE;
         }
+    }
+    if(options.pyramid_levels > 0 && options.memory_budget > 0){
+        fprintf(stderr, "Option --pyramid cannot be used with -M.\n");
+        free_inputs(&inputs);
+        return EXIT_FAILURE;
+    }
+    if(options.pipelined && options.memory_budget == 0){
+        fprintf(stderr, "Option --pipelined needs -M.\n");
+        free_inputs(&inputs);
+        return EXIT_FAILURE;
+    }
+    if(options.pyramid_levels > 0 && !batch &&
+       strcmp(options.output_filename != NULL ? options.output_filename : inputs.names[0], BMP_STDIO_NAME) == 0){
+        fprintf(stderr, "Pyramid levels cannot be written to standard output.\n");
+        free_inputs(&inputs);
         return EXIT_FAILURE;
     }
 
-    // Write BMP Header
-    writeBMPHeader(output_file, &bmp_header);
+    FilterChain chain;
+    build_filter_chain(&options, &chain);
 
-    // Write DIB Header
-    writeDIBHeader(output_file, &dib_header);
+    ThreadPool* pool = threadpool_create(options.threads);
+    threadpool_set_default(pool);
+    int processed;
+    if(options.use_direct_io && options.memory_budget > 0){
+        fprintf(stderr, "Direct I/O is not used when streaming.\n");
+    }
+    if(batch){
+        processed = process_batch(&inputs, &chain, &options, pool);
+    }
+    else{
+        // If output filename not specified, create default name; standard
+        // input goes to standard output
+        char* output_filename = options.output_filename;
+        if(output_filename == NULL){
+            output_filename = strcmp(inputs.names[0], BMP_STDIO_NAME) == 0 ? BMP_STDIO_NAME :
+                              generate_output_filename(inputs.names[0]);
+        }
 
-    // Write pixel data
-    writePixelsBMP(output_file, img->pArr, img->width, img->height);
-    fclose(output_file);
+        // Process the whole image at once, or strip by strip within the memory budget
+        struct PipelineOptions pipeline;
+        pipeline_options(&options, &pipeline);
+        Image* img = NULL;
+        processed = output_filename != NULL &&
+                    pipeline_process_file(inputs.names[0], output_filename, &chain, &pipeline, &img);
+        image_destroy(&img);
 
-    printf("Output file name was %s.\n", output_filename);
+        // Standard output only carries the image
+        if(processed && strcmp(output_filename, BMP_STDIO_NAME) != 0){
+            printf("Output file name was %s.\n", output_filename);
+        }
+        if(output_filename != options.output_filename && strcmp(output_filename, BMP_STDIO_NAME) != 0){
+            free(output_filename);
+        }
+    }
+    threadpool_destroy(&pool);
 
     // Free resources
-    image_destroy(&img);
-    if(output_filename_allocated){
-        free(output_filename);
+    free_inputs(&inputs);
+
+    if(options.print_stats){
+        stats_print(stderr, options.stats_format, start);
     }
 
-    return EXIT_SUCCESS;
+    return processed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
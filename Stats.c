@@ -0,0 +1,108 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Stats.c
+
+#define _GNU_SOURCE
+
+#include "Stats.h"
+#include "BufferPool.h"
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+// Names of the stages, indexed by enum StatsStage
+static const char* stage_names[STATS_STAGE_COUNT] = {"headers", "alloc", "read", "filter", "resize", "write"};
+
+// Counters, updated with relaxed atomic adds from any thread
+static unsigned long long stage_nanos[STATS_STAGE_COUNT];
+static unsigned long long bytes_read;
+static unsigned long long bytes_written;
+static unsigned long long allocations;
+static unsigned long long allocated_bytes;
+
+// Last filter plan recorded, with its estimated costs
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+static char plan_text[256];
+static double plan_chain_cost;
+static double plan_cost;
+
+// Function to read the monotonic clock
+unsigned long long stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Function to add the time since start to a stage
+void stats_add_time(enum StatsStage stage, unsigned long long start) {
+    __atomic_fetch_add(&stage_nanos[stage], stats_now() - start, __ATOMIC_RELAXED);
+}
+
+// Function to count bytes read
+void stats_add_read(size_t bytes) {
+    __atomic_fetch_add(&bytes_read, bytes, __ATOMIC_RELAXED);
+}
+
+// Function to count bytes written
+void stats_add_written(size_t bytes) {
+    __atomic_fetch_add(&bytes_written, bytes, __ATOMIC_RELAXED);
+}
+
+// Function to count an allocation
+void stats_add_allocation(size_t bytes) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocated_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+// Function to record the last filter plan
+void stats_set_plan(const char* plan, double chain_cost, double cost) {
+    pthread_mutex_lock(&plan_lock);
+    snprintf(plan_text, sizeof(plan_text), "%s", plan);
+    plan_chain_cost = chain_cost;
+    plan_cost = cost;
+    pthread_mutex_unlock(&plan_lock);
+}
+
+// Function to print all counters on one line
+void stats_print(FILE* out, enum StatsFormat format, unsigned long long start) {
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage;
+    long peak_rss_kb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+    double total_ms = (stats_now() - start) / 1e6;
+
+    const char* separator = format == STATS_JSON ? ", " : " ";
+    const char* quote = format == STATS_JSON ? "\"" : "";
+    const char* assign = format == STATS_JSON ? "\": " : "=";
+
+    fprintf(out, format == STATS_JSON ? "{\"total_ms\": %.3f" : "stats: total_ms=%.3f", total_ms);
+    for(int s = 0; s < STATS_STAGE_COUNT; s++){
+        unsigned long long nanos = __atomic_load_n(&stage_nanos[s], __ATOMIC_RELAXED);
+        fprintf(out, "%s%s%s_ms%s%.3f", separator, quote, stage_names[s], assign, nanos / 1e6);
+    }
+    fprintf(out, "%s%sbytes_read%s%llu", separator, quote, assign, __atomic_load_n(&bytes_read, __ATOMIC_RELAXED));
+    fprintf(out, "%s%sbytes_written%s%llu", separator, quote, assign, __atomic_load_n(&bytes_written, __ATOMIC_RELAXED));
+    fprintf(out, "%s%sallocations%s%llu", separator, quote, assign, __atomic_load_n(&allocations, __ATOMIC_RELAXED));
+    fprintf(out, "%s%sallocated_bytes%s%llu", separator, quote, assign, __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED));
+    struct BufferPoolStats pool;
+    buffer_pool_get_stats(&pool);
+    fprintf(out, "%s%spool_hits%s%llu", separator, quote, assign, pool.hits);
+    fprintf(out, "%s%spool_misses%s%llu", separator, quote, assign, pool.misses);
+    fprintf(out, "%s%speak_rss_kb%s%ld", separator, quote, assign, peak_rss_kb);
+    pthread_mutex_lock(&plan_lock);
+    if(plan_text[0] != '\0'){
+        // Estimated costs in millions of pixel operations, see planner_cost
+        fprintf(out, "%s%splan%s%s%s%s", separator, quote, assign, quote, plan_text, quote);
+        fprintf(out, "%s%schain_cost%s%.3f", separator, quote, assign, plan_chain_cost);
+        fprintf(out, "%s%splan_cost%s%.3f", separator, quote, assign, plan_cost);
+    }
+    pthread_mutex_unlock(&plan_lock);
+    fprintf(out, format == STATS_JSON ? "}\n" : "\n");
+}
@@ -0,0 +1,89 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Stats.h
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Phases of processing a file that are timed separately
+enum StatsStage {
+    STATS_HEADERS, // Opening the input and parsing its headers
+    STATS_ALLOC,   // Allocating the image an input is loaded into
+    STATS_READ,    // Reading or copying input pixels
+    STATS_FILTER,  // Point filters that run on their own
+    STATS_RESIZE,  // Resizes and geometric transforms, with the point filters fused into them and their new buffer
+    STATS_WRITE,   // Writing the output
+    STATS_STAGE_COUNT
+};
+
+// Output formats of stats_print
+enum StatsFormat {
+    STATS_TEXT,
+    STATS_JSON
+};
+
+/* Returns the time of a monotonic clock in nanoseconds. The counters are
+ * always kept, as they only cost a clock read per phase and a relaxed atomic
+ * add per counted event, so stats can be printed for any run.
+*/
+unsigned long long stats_now(void);
+
+/* Adds the time elapsed since start to a stage. Stages are summed over
+ * files and threads, so in batch mode they can add up to more than the
+ * total time.
+ *
+ * @param  stage: the stage.
+ * @param  start: the start time, from stats_now.
+*/
+void stats_add_time(enum StatsStage stage, unsigned long long start);
+
+/* Counts bytes read from input files.
+ *
+ * @param  bytes: number of bytes.
+*/
+void stats_add_read(size_t bytes);
+
+/* Counts bytes written to output files.
+ *
+ * @param  bytes: number of bytes.
+*/
+void stats_add_written(size_t bytes);
+
+/* Counts an allocation of a pixel or file buffer. Buffers reused from the
+ * buffer pool are not counted, only the pool's misses.
+ *
+ * @param  bytes: size of the allocation.
+*/
+void stats_add_allocation(size_t bytes);
+
+/* Records the plan a filter chain was applied with, see planner_optimize.
+ * Only the last plan recorded is kept, so in batch mode it is the plan of
+ * the last file started.
+ *
+ * @param  plan: description of the planned chain, see planner_describe.
+ * @param  chain_cost: estimated cost of the chain as given, see planner_cost.
+ * @param  plan_cost: estimated cost of the planned chain.
+*/
+void stats_set_plan(const char* plan, double chain_cost, double plan_cost);
+
+/* Prints the stage times, byte and allocation counts, the hits and misses
+ * of the buffer pool, the peak resident set size and the last filter plan
+ * recorded as a single line.
+ *
+ * @param  out: the stream to print to.
+ * @param  format: STATS_TEXT for key=value pairs, STATS_JSON for a JSON object.
+ * @param  start: start time of the run, from stats_now.
+*/
+void stats_print(FILE* out, enum StatsFormat format, unsigned long long start);
+
+#endif // STATS_H
@@ -0,0 +1,608 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Stream.c
+
+#include "Stream.h"
+#include "BMPHandler.h"
+#include "ThreadPool.h"
+#include "Stats.h"
+#include "BufferPool.h"
+#include "Planner.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+// Buffers of each kind a pipelined run cycles through: one being filled
+// while the other is used
+#define STREAM_QUEUE_DEPTH 2
+
+// One strip of the output, rows begin .. end - 1, and the source rows
+// first .. last it reads. The reader skips skip rows, then reads the count
+// new rows first .. first + count - 1, the last of them first.
+struct StripStep {
+    int begin;
+    int end;
+    int first;
+    int last;
+    int skip;
+    int count;
+};
+
+// State of a streamed run
+struct StreamJob {
+    struct FilterChainPlan plan;
+    struct ResamplePlan resample;  // Weight tables of a filtered resize
+    int source_width;
+    int source_height;
+    int pipelined;                 // Read and write on threads of their own, see STREAM_PIPELINED
+    struct StripStep* steps;       // The strips in the order they are written
+    int strips;
+};
+
+// Rows read for a strip, or a filtered strip, passed between the threads of
+// a pipelined run
+struct StripBuffer {
+    Image* img;
+    int step; // Index of the strip in StreamJob.steps
+};
+
+// Bounded queue of buffers, guarded by its lock
+struct StripQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    struct StripBuffer* items[STREAM_QUEUE_DEPTH];
+    int head;
+    int count;
+    int closed; // Set on failure, every pop then returns NULL
+};
+
+// State shared by the reader, processor and writer of a pipelined run. The
+// read and write buffers go round from the free queue of their kind to the
+// full one and back, so no thread gets more than two strips ahead.
+struct StreamPipeline {
+    const struct StreamJob* job;
+    struct BMP_Reader* reader;
+    struct BMP_Writer* writer;
+    struct Pixel** read_rows;  // Row pointers of the reader thread
+    struct Pixel** write_rows; // Row pointers of the writer thread
+    struct StripQueue read_free;
+    struct StripQueue read_full;
+    struct StripQueue write_free;
+    struct StripQueue write_full;
+    int failed;
+};
+
+// Context for running the point program in place on bands of rows
+struct StreamBands {
+    Image* img;
+    const struct PointProgram* prog;
+};
+
+// Function to run the point program in place on a band of rows
+static void point_band(void* ctx, int begin, int end) {
+    struct StreamBands* job = (struct StreamBands*)ctx;
+    for(int i = begin; i < end; i++){
+        point_program_apply(job->prog, image_get_row(job->img, i), job->img->width);
+    }
+}
+
+// Function to get the range of source rows read by a range of output rows
+static void source_rows(const struct StreamJob* job, int begin, int end, int* first, int* last) {
+    if(job->plan.convolved){
+        convolve_source_rows(&job->plan.kernel, job->source_height, begin, end, first, last);
+    }
+    else if(job->plan.filter != RESAMPLE_NEAREST){
+        resample_plan_source_rows(&job->resample, begin, end, first, last);
+    }
+    else if(job->plan.y.map != NULL){
+        *first = job->plan.y.map[begin];
+        *last = job->plan.y.map[end - 1];
+    }
+    else{
+        *first = begin;
+        *last = end - 1;
+    }
+}
+
+// Function to get the size of the buffer for one row of an image
+static size_t row_buffer_size(int width) {
+    return ((size_t)width * sizeof(struct Pixel) + IMAGE_ROW_ALIGN - 1) & ~(size_t)(IMAGE_ROW_ALIGN - 1);
+}
+
+// Function to plan the strips of a run, in the order the output is written:
+// the source rows every strip needs and the rows the reader skips and reads
+// for it. Returns the number of strips; steps may be NULL to only get the
+// tallest window and the most rows read for one strip.
+static int strip_steps(const struct StreamJob* job, int strip_rows, struct StripStep* steps,
+                       int* window_rows, int* max_count) {
+    int next_source = job->source_height - 1; // Next row the reader delivers, rows come bottom-up
+    int count = 0;
+    *window_rows = 0;
+    *max_count = 0;
+    for(int end = job->plan.height; end > 0; end -= strip_rows, count++){
+        struct StripStep step;
+        step.begin = end > strip_rows ? end - strip_rows : 0;
+        step.end = end;
+        source_rows(job, step.begin, end, &step.first, &step.last);
+
+        // Rows no strip reads are skipped, rows already in the window are kept
+        step.skip = next_source > step.last ? next_source - step.last : 0;
+        next_source -= step.skip;
+        step.count = next_source - step.first + 1 > 0 ? next_source - step.first + 1 : 0;
+        if(step.count > 0) next_source = step.first - 1;
+
+        if(step.last - step.first + 1 > *window_rows) *window_rows = step.last - step.first + 1;
+        if(step.count > *max_count) *max_count = step.count;
+        if(steps != NULL) steps[count] = step;
+    }
+    return count;
+}
+
+// Function to compute the memory used with strips of a given height, and the
+// number of rows the source window needs
+static size_t strip_memory(const struct StreamJob* job, int strip_rows, int* window_rows) {
+    int max_count;
+    strip_steps(job, strip_rows, NULL, window_rows, &max_count);
+    int window = *window_rows;
+
+    size_t bytes = window * row_buffer_size(job->source_width);
+    if(job->pipelined){
+        // Rows read ahead and strips waiting to be written, two of each
+        bytes += 2 * (max_count * row_buffer_size(job->source_width) + strip_rows * row_buffer_size(job->plan.width));
+    }
+    else if(job->plan.resized || job->plan.convolved){
+        bytes += strip_rows * row_buffer_size(job->plan.width);
+    }
+    if(job->plan.filter != RESAMPLE_NEAREST){
+        // Horizontally filtered copy of the window
+        bytes += window * row_buffer_size(job->plan.width);
+    }
+    return bytes;
+}
+
+// Function to find the tallest strip that fits in the budget, 0 if none does
+static int choose_strip_rows(const struct StreamJob* job, size_t budget, int* window_rows) {
+    int lo = 0, hi = job->plan.height;
+    while(lo < hi){
+        int mid = lo + (hi - lo + 1) / 2;
+        int window;
+        if(strip_memory(job, mid, &window) <= budget) lo = mid;
+        else hi = mid - 1;
+    }
+    if(lo > 0) strip_memory(job, lo, window_rows);
+    return lo;
+}
+
+// Function to move the rows a strip shares with the previous one to their
+// new place in the window, which then holds rows first .. last
+static void move_window(Image* window, const struct StripStep* step, int* window_first, int* window_count) {
+    int keep_first = step->first > *window_first ? step->first : *window_first;
+    int keep_last = *window_first + *window_count - 1;
+    if(keep_last > step->last) keep_last = step->last;
+    if(keep_first <= keep_last && step->first != *window_first){
+        memmove(image_get_row(window, keep_first - step->first), image_get_row(window, keep_first - *window_first),
+                (keep_last - keep_first + 1) * window->stride);
+    }
+    *window_first = step->first;
+    *window_count = step->last - step->first + 1;
+}
+
+// Function to filter a strip once its new rows are in the window. The
+// result is in strip, or in the window itself for a chain of point stages
+// only, unless in_place is 0.
+static int filter_strip(const struct StreamJob* job, Image* window, const struct StripStep* step, Image* strip,
+                        int in_place, Image** out) {
+    const struct FilterChainPlan* plan = &job->plan;
+    unsigned long long start;
+    if(plan->convolved && step->count > 0 && !point_program_is_empty(&plan->pre)){
+        // Halo rows stay in the window for the next strip, so only the
+        // rows just read get the point stages before the convolution
+        start = stats_now();
+        struct StreamBands bands = {window, &plan->pre};
+        threadpool_run_bands(threadpool_get_default(), step->count, point_band, &bands);
+        stats_add_time(STATS_FILTER, start);
+    }
+
+    *out = strip;
+    start = stats_now();
+    if(plan->convolved){
+        if(!convolve_rows(&plan->kernel, window, step->first, job->source_height, strip, step->begin, step->end,
+                          &plan->post)){
+            return 0;
+        }
+        stats_add_time(STATS_FILTER, start);
+    }
+    else if(!plan->resized){
+        int rows = step->last - step->first + 1;
+        if(in_place){
+            *out = window;
+        }
+        else{
+            memcpy(image_get_row(strip, 0), image_get_row(window, 0), rows * window->stride);
+        }
+        if(!point_program_is_empty(&plan->pre)){
+            struct StreamBands bands = {*out, &plan->pre};
+            threadpool_run_bands(threadpool_get_default(), rows, point_band, &bands);
+        }
+        stats_add_time(STATS_FILTER, start);
+    }
+    else if(plan->filter != RESAMPLE_NEAREST){
+        if(!resample_rows(&job->resample, window, step->first, strip, step->begin, step->end, &plan->pre, &plan->post)){
+            return 0;
+        }
+        stats_add_time(STATS_RESIZE, start);
+    }
+    else{
+        if(!resize_nearest_rows(window, step->first, strip, step->begin, step->end, &plan->x, &plan->y, &plan->pre)){
+            return 0;
+        }
+        stats_add_time(STATS_RESIZE, start);
+    }
+    return 1;
+}
+
+// Function to write a strip, bottom row first
+static int write_strip(struct BMP_Writer* writer, Image* out, const struct StripStep* step, struct Pixel** rows) {
+    unsigned long long start = stats_now();
+    int count = step->end - step->begin;
+    for(int k = 0; k < count; k++){
+        rows[k] = image_get_row(out, count - 1 - k);
+    }
+    int ok = writeRowsBMP(writer, rows, count);
+    stats_add_time(STATS_WRITE, start);
+    return ok;
+}
+
+// Function to produce the output strip by strip
+static int stream_strips(struct StreamJob* job, struct BMP_Reader* reader, struct BMP_Writer* writer,
+                         Image* window, Image* strip, struct Pixel** rows) {
+    int window_first = job->source_height; // The window holds rows window_first .. window_first + window_count - 1
+    int window_count = 0;
+    for(int s = 0; s < job->strips; s++){
+        const struct StripStep* step = &job->steps[s];
+        move_window(window, step, &window_first, &window_count);
+
+        // Rows no strip reads are skipped, the others read into the window
+        unsigned long long start = stats_now();
+        if(step->skip > 0 && !skipRowsBMP(reader, step->skip)) return 0;
+        for(int k = 0; k < step->count; k++){
+            rows[k] = image_get_row(window, step->count - 1 - k);
+        }
+        if(step->count > 0 && !readRowsBMP(reader, rows, step->count)) return 0;
+        stats_add_time(STATS_READ, start);
+
+        Image* out;
+        if(!filter_strip(job, window, step, strip, 1, &out) || !write_strip(writer, out, step, rows)) return 0;
+    }
+    return 1;
+}
+
+// Function to initialize a queue
+static void strip_queue_init(struct StripQueue* queue) {
+    memset(queue, 0, sizeof(*queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+}
+
+// Function to release a queue
+static void strip_queue_destroy(struct StripQueue* queue) {
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+// Function to append a buffer to a queue; it never holds more than the
+// buffers of one kind, so there is always room
+static void strip_queue_push(struct StripQueue* queue, struct StripBuffer* buffer) {
+    pthread_mutex_lock(&queue->lock);
+    queue->items[(queue->head + queue->count) % STREAM_QUEUE_DEPTH] = buffer;
+    queue->count++;
+    pthread_cond_signal(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Function to take the oldest buffer of a queue, waiting for one. Returns
+// NULL once the queue is closed.
+static struct StripBuffer* strip_queue_pop(struct StripQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while(!queue->closed && queue->count == 0){
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    struct StripBuffer* buffer = NULL;
+    if(!queue->closed){
+        buffer = queue->items[queue->head];
+        queue->head = (queue->head + 1) % STREAM_QUEUE_DEPTH;
+        queue->count--;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return buffer;
+}
+
+// Function to close a queue, waking every thread waiting on it
+static void strip_queue_close(struct StripQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Function to stop a pipelined run after a failure in any of its threads
+static void pipeline_fail(struct StreamPipeline* pipe) {
+    __atomic_store_n(&pipe->failed, 1, __ATOMIC_RELAXED);
+    strip_queue_close(&pipe->read_free);
+    strip_queue_close(&pipe->read_full);
+    strip_queue_close(&pipe->write_free);
+    strip_queue_close(&pipe->write_full);
+}
+
+// Reader thread of a pipelined run: reads the new rows of every strip
+// ahead into a free read buffer, file order first
+static void* reader_main(void* arg) {
+    struct StreamPipeline* pipe = (struct StreamPipeline*)arg;
+    const struct StreamJob* job = pipe->job;
+    for(int s = 0; s < job->strips; s++){
+        struct StripBuffer* buffer = strip_queue_pop(&pipe->read_free);
+        if(buffer == NULL) return NULL;
+        const struct StripStep* step = &job->steps[s];
+        unsigned long long start = stats_now();
+        int ok = step->skip == 0 || skipRowsBMP(pipe->reader, step->skip);
+        for(int k = 0; k < step->count; k++){
+            pipe->read_rows[k] = image_get_row(buffer->img, k);
+        }
+        ok = ok && (step->count == 0 || readRowsBMP(pipe->reader, pipe->read_rows, step->count));
+        stats_add_time(STATS_READ, start);
+        if(!ok){
+            pipeline_fail(pipe);
+            return NULL;
+        }
+        buffer->step = s;
+        strip_queue_push(&pipe->read_full, buffer);
+    }
+    return NULL;
+}
+
+// Writer thread of a pipelined run: writes every filtered strip in order
+static void* writer_main(void* arg) {
+    struct StreamPipeline* pipe = (struct StreamPipeline*)arg;
+    const struct StreamJob* job = pipe->job;
+    for(int s = 0; s < job->strips; s++){
+        struct StripBuffer* buffer = strip_queue_pop(&pipe->write_full);
+        if(buffer == NULL) return NULL;
+        if(!write_strip(pipe->writer, buffer->img, &job->steps[buffer->step], pipe->write_rows)){
+            pipeline_fail(pipe);
+            return NULL;
+        }
+        strip_queue_push(&pipe->write_free, buffer);
+    }
+    return NULL;
+}
+
+// Function to produce the output strip by strip with the reading and the
+// writing on threads of their own
+static int stream_strips_pipelined(struct StreamJob* job, struct BMP_Reader* reader, struct BMP_Writer* writer,
+                                   Image* window, struct StripBuffer* read_buffers, struct StripBuffer* write_buffers,
+                                   struct Pixel** read_rows, struct Pixel** write_rows) {
+    struct StreamPipeline pipe;
+    pipe.job = job;
+    pipe.reader = reader;
+    pipe.writer = writer;
+    pipe.read_rows = read_rows;
+    pipe.write_rows = write_rows;
+    pipe.failed = 0;
+    strip_queue_init(&pipe.read_free);
+    strip_queue_init(&pipe.read_full);
+    strip_queue_init(&pipe.write_free);
+    strip_queue_init(&pipe.write_full);
+    for(int k = 0; k < STREAM_QUEUE_DEPTH; k++){
+        strip_queue_push(&pipe.read_free, &read_buffers[k]);
+        strip_queue_push(&pipe.write_free, &write_buffers[k]);
+    }
+
+    pthread_t reader_thread, writer_thread;
+    int readers = pthread_create(&reader_thread, NULL, reader_main, &pipe) == 0;
+    int writers = readers && pthread_create(&writer_thread, NULL, writer_main, &pipe) == 0;
+    if(!writers){
+        fprintf(stderr, "Failed to start the reader and writer threads.\n");
+        pipeline_fail(&pipe);
+    }
+
+    // Filter every strip between the two, on this thread and the pool
+    int window_first = job->source_height;
+    int window_count = 0;
+    for(int s = 0; writers && s < job->strips; s++){
+        struct StripBuffer* input = strip_queue_pop(&pipe.read_full);
+        if(input == NULL) break;
+        const struct StripStep* step = &job->steps[s];
+        move_window(window, step, &window_first, &window_count);
+        for(int k = 0; k < step->count; k++){
+            memcpy(image_get_row(window, step->count - 1 - k), image_get_row(input->img, k), window->stride);
+        }
+        strip_queue_push(&pipe.read_free, input);
+
+        struct StripBuffer* output = strip_queue_pop(&pipe.write_free);
+        if(output == NULL) break;
+        Image* out;
+        if(!filter_strip(job, window, step, output->img, 0, &out)){
+            pipeline_fail(&pipe);
+            break;
+        }
+        output->step = s;
+        strip_queue_push(&pipe.write_full, output);
+    }
+
+    if(readers) pthread_join(reader_thread, NULL);
+    if(writers) pthread_join(writer_thread, NULL);
+    strip_queue_destroy(&pipe.read_free);
+    strip_queue_destroy(&pipe.read_full);
+    strip_queue_destroy(&pipe.write_free);
+    strip_queue_destroy(&pipe.write_full);
+    return writers && !pipe.failed;
+}
+
+// Rows read at a time by the histogram pass
+#define HISTOGRAM_ROWS 16
+
+// Function to compute the histogram of a BMP file in one pass over its rows
+static int stream_histogram(const char* input_filename, struct Histogram* hist) {
+    if(strcmp(input_filename, BMP_STDIO_NAME) == 0){
+        fprintf(stderr, "Automatic adjustments read the input twice when streaming, which standard input cannot be.\n");
+        return 0;
+    }
+    struct BMP_Reader reader;
+    unsigned long long start = stats_now();
+    if(!openBMPReader(input_filename, &reader)){
+        return 0;
+    }
+    Image* rows = image_create(reader.width, HISTOGRAM_ROWS);
+    int ok = rows != NULL;
+    struct Pixel* row_pointers[HISTOGRAM_ROWS];
+    histogram_init(hist);
+    for(int done = 0; ok && done < reader.height; done += HISTOGRAM_ROWS){
+        int count = reader.height - done < HISTOGRAM_ROWS ? reader.height - done : HISTOGRAM_ROWS;
+        for(int k = 0; k < count; k++) row_pointers[k] = image_get_row(rows, k);
+        ok = readRowsBMP(&reader, row_pointers, count);
+        if(ok) histogram_add_rows(hist, rows, 0, count);
+    }
+    image_destroy(&rows);
+    closeBMPReader(&reader);
+    stats_add_time(STATS_READ, start);
+    return ok;
+}
+
+// Function to apply a filter chain to a BMP file strip by strip
+int stream_filter_chain(const char* input_filename, const char* output_filename,
+                        const FilterChain* chain, size_t budget, int alloc_flags, int stream_flags) {
+    struct BMP_Reader reader;
+    unsigned long long start = stats_now();
+    if(!openBMPReader(input_filename, &reader)){
+        return 0;
+    }
+    stats_add_time(STATS_HEADERS, start);
+
+    // Point stages fold into the plan wherever they are, the planner only
+    // records the order for the stats. A leading adjustment costs one more
+    // pass over the file for its histogram, then becomes a lookup table.
+    FilterChain planned;
+    planner_optimize(chain, reader.width, reader.height, &planned);
+    if(filter_chain_leading_adjust(&planned) >= 0){
+        struct Histogram hist;
+        if(!stream_histogram(input_filename, &hist)){
+            closeBMPReader(&reader);
+            return 0;
+        }
+        filter_chain_resolve_adjust(&planned, &hist, &planned);
+    }
+
+    struct StreamJob job;
+    job.source_width = reader.width;
+    job.source_height = reader.height;
+    job.pipelined = (stream_flags & STREAM_PIPELINED) != 0;
+    job.steps = NULL;
+    job.strips = 0;
+    if(!filter_chain_plan(&planned, reader.width, reader.height, &job.plan)){
+        closeBMPReader(&reader);
+        return 0;
+    }
+    if(job.plan.filter != RESAMPLE_NEAREST &&
+       !resample_plan_init(&job.resample, reader.width, reader.height, job.plan.width, job.plan.height, job.plan.filter)){
+        filter_chain_plan_free(&job.plan);
+        closeBMPReader(&reader);
+        return 0;
+    }
+
+    int window_rows = 0;
+    int strip_rows = choose_strip_rows(&job, budget, &window_rows);
+    int ok = strip_rows > 0;
+    if(!ok){
+        fprintf(stderr, "Memory budget is too small, at least %zu bytes are needed.\n",
+                strip_memory(&job, 1, &window_rows));
+    }
+
+    // Strip schedule, source window, output strips and row pointers for
+    // reading and writing; a pipelined run has two read buffers and two
+    // output strips, and row pointers for each thread
+    int max_count = 0;
+    size_t steps_size = 0;
+    Image* window = NULL;
+    Image* strip = NULL;
+    struct StripBuffer read_buffers[STREAM_QUEUE_DEPTH] = {{NULL, 0}};
+    struct StripBuffer write_buffers[STREAM_QUEUE_DEPTH] = {{NULL, 0}};
+    struct Pixel** rows = NULL;
+    int row_count = 0; // Row pointers of each thread
+    size_t rows_size = 0;
+    if(ok){
+        start = stats_now();
+        job.strips = strip_steps(&job, strip_rows, NULL, &window_rows, &max_count);
+        steps_size = job.strips * sizeof(struct StripStep);
+        job.steps = (struct StripStep*)buffer_pool_alloc(steps_size);
+        if(job.steps != NULL) strip_steps(&job, strip_rows, job.steps, &window_rows, &max_count);
+        window = image_create_ex(reader.width, window_rows, alloc_flags);
+        ok = job.steps != NULL && window != NULL;
+        if(job.pipelined){
+            for(int k = 0; k < STREAM_QUEUE_DEPTH; k++){
+                read_buffers[k].img = image_create_ex(reader.width, max_count > 0 ? max_count : 1, alloc_flags);
+                write_buffers[k].img = image_create_ex(job.plan.width, strip_rows, alloc_flags);
+                ok = ok && read_buffers[k].img != NULL && write_buffers[k].img != NULL;
+            }
+        }
+        else if(job.plan.resized || job.plan.convolved){
+            strip = image_create_ex(job.plan.width, strip_rows, alloc_flags);
+            ok = ok && strip != NULL;
+        }
+        row_count = window_rows > strip_rows ? window_rows : strip_rows;
+        rows_size = (job.pipelined ? 2 : 1) * row_count * sizeof(struct Pixel*);
+        rows = (struct Pixel**)buffer_pool_alloc(rows_size);
+        if(job.steps == NULL || rows == NULL){
+            perror("Failed to allocate memory for the strips");
+        }
+        ok = ok && rows != NULL;
+        stats_add_time(STATS_ALLOC, start);
+    }
+
+    if(ok){
+        // Headers of the output, which is always preallocated as it is written piecewise
+        struct BMP_Header bmp_header = reader.bmp_header;
+        struct DIB_Header dib_header = reader.dib_header;
+        normalizeHeadersBMP(&bmp_header, &dib_header);
+        if(job.plan.resized){
+            makeBMPHeader(&bmp_header, job.plan.width, job.plan.height);
+            makeDIBHeader(&dib_header, job.plan.width, job.plan.height);
+        }
+        struct BMP_Writer writer;
+        start = stats_now();
+        ok = openBMPWriter(output_filename, &bmp_header, &dib_header, &writer, BMP_WRITE_FALLOCATE);
+        stats_add_time(STATS_WRITE, start);
+        if(ok){
+            if(job.pipelined){
+                ok = stream_strips_pipelined(&job, &reader, &writer, window, read_buffers, write_buffers, rows,
+                                             rows + row_count);
+            }
+            else{
+                ok = stream_strips(&job, &reader, &writer, window, strip, rows);
+            }
+            start = stats_now();
+            ok = closeBMPWriter(&writer) && ok;
+            stats_add_time(STATS_WRITE, start);
+        }
+    }
+
+    buffer_pool_free(rows, rows_size);
+    for(int k = 0; k < STREAM_QUEUE_DEPTH; k++){
+        image_destroy(&read_buffers[k].img);
+        image_destroy(&write_buffers[k].img);
+    }
+    image_destroy(&strip);
+    image_destroy(&window);
+    buffer_pool_free(job.steps, steps_size);
+    if(job.plan.filter != RESAMPLE_NEAREST) resample_plan_free(&job.resample);
+    filter_chain_plan_free(&job.plan);
+    closeBMPReader(&reader);
+    return ok;
+}
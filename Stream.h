@@ -0,0 +1,50 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// Stream.h
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include "FilterChain.h"
+
+// Flags of stream_filter_chain
+#define STREAM_PIPELINED 1 // Read and write on threads of their own while filtering
+
+/* Applies a filter chain to a BMP file strip by strip, so that images larger
+ * than memory can be processed. Output rows are produced in file order, a
+ * strip at a time, from a window holding just the source rows the strip
+ * reads; rows shared by two strips stay in the window and the input is only
+ * ever read forward. The strip height is the largest one whose window,
+ * intermediate and output rows fit in the memory budget. A leading
+ * adjustment takes one more pass over the file for its histogram, see
+ * filter_chain_leading_adjust.
+ *
+ * With STREAM_PIPELINED, a reader thread reads the rows of the next strips
+ * and a writer thread writes the finished ones while the calling thread and
+ * the pool filter the strip in between. Two read buffers and two output
+ * strips go round through bounded queues, so a thread that gets two strips
+ * ahead waits for the others; the run then takes about as long as the
+ * slowest of reading, filtering and writing instead of their sum. The extra
+ * buffers count against the budget, so strips are shorter.
+ *
+ * @param  input_filename: name of the BMP file to read.
+ * @param  output_filename: name of the BMP file to write.
+ * @param  chain: the chain, with at most one filtered resize, or one
+ *                convolution and no resize.
+ * @param  budget: memory budget in bytes for the pixel buffers.
+ * @param  alloc_flags: allocation flags for the pixel buffers, see image_create_ex.
+ * @param  stream_flags: 0 or STREAM_PIPELINED.
+ * @return 1 on success, 0 on failure.
+*/
+int stream_filter_chain(const char* input_filename, const char* output_filename,
+                        const FilterChain* chain, size_t budget, int alloc_flags, int stream_flags);
+
+#endif // STREAM_H
@@ -0,0 +1,222 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// ThreadPool.c
+
+#define _GNU_SOURCE
+
+#include "ThreadPool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Band layout: at most this many bands, each at least this many rows
+#define THREADPOOL_MAX_BANDS 256
+#define THREADPOOL_MIN_BAND_ROWS 8
+
+// Thread pool structure
+struct ThreadPool {
+    pthread_t* workers;
+    int threads;                // Workers plus the calling thread
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   // Signaled when a job is posted or the pool stops
+    pthread_cond_t done_cond;   // Signaled when the last worker finishes a job
+    pthread_mutex_t submit;     // Held by the thread running a job
+    unsigned long generation;   // Incremented for every job
+    int stop;
+    int active;                 // Workers still busy with the current job
+
+    // Current job
+    ThreadPoolBandFn fn;
+    void* ctx;
+    int rows;
+    int band_rows;
+    int bands;
+    int next_band;
+};
+
+// Pool used by the image filters
+static ThreadPool* default_pool = NULL;
+
+// Set while the current thread runs a band, so nested calls run serially
+static __thread int inside_band = 0;
+
+// Function to detect the number of usable CPUs
+int threadpool_detect_threads(void) {
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) == 0){
+        int count = CPU_COUNT(&set);
+        if(count > 0) return count;
+    }
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+// Function to compute the band height for a number of rows
+static int band_rows_for(int rows) {
+    int band = (rows + THREADPOOL_MAX_BANDS - 1) / THREADPOOL_MAX_BANDS;
+    return band < THREADPOOL_MIN_BAND_ROWS ? THREADPOOL_MIN_BAND_ROWS : band;
+}
+
+// Function to take bands of the current job until none are left
+static void run_job(ThreadPool* pool) {
+    inside_band = 1;
+    for(;;){
+        int band = __atomic_fetch_add(&pool->next_band, 1, __ATOMIC_RELAXED);
+        if(band >= pool->bands) break;
+        int begin = band * pool->band_rows;
+        int end = begin + pool->band_rows;
+        if(end > pool->rows) end = pool->rows;
+        pool->fn(pool->ctx, begin, end);
+    }
+    inside_band = 0;
+}
+
+// Worker thread main loop
+static void* worker_main(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for(;;){
+        while(!pool->stop && pool->generation == seen){
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if(pool->stop) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_job(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->active == 0){
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Function to create a pool
+ThreadPool* threadpool_create(int threads) {
+    if(threads <= 0) threads = threadpool_detect_threads();
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if(pool == NULL){
+        perror("Failed to allocate memory for thread pool");
+        return NULL;
+    }
+    pool->workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    if(pool->workers == NULL){
+        perror("Failed to allocate memory for worker threads");
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->submit, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    // The calling thread is the first thread of the pool
+    pool->threads = 1;
+    for(int i = 0; i < threads - 1; i++){
+        if(pthread_create(&pool->workers[i], NULL, worker_main, pool) != 0){
+            fprintf(stderr, "Failed to start worker thread, using %d threads.\n", pool->threads);
+            break;
+        }
+        pool->threads++;
+    }
+    return pool;
+}
+
+// Function to destroy a pool
+void threadpool_destroy(ThreadPool** pool) {
+    if(pool && *pool){
+        ThreadPool* p = *pool;
+        pthread_mutex_lock(&p->lock);
+        p->stop = 1;
+        pthread_cond_broadcast(&p->work_cond);
+        pthread_mutex_unlock(&p->lock);
+        for(int i = 0; i < p->threads - 1; i++){
+            pthread_join(p->workers[i], NULL);
+        }
+        if(default_pool == p) default_pool = NULL;
+        pthread_mutex_destroy(&p->lock);
+        pthread_mutex_destroy(&p->submit);
+        pthread_cond_destroy(&p->work_cond);
+        pthread_cond_destroy(&p->done_cond);
+        free(p->workers);
+        free(p);
+        *pool = NULL;
+    }
+}
+
+// Function to get the number of threads of a pool
+int threadpool_get_threads(ThreadPool* pool) {
+    return pool ? pool->threads : 1;
+}
+
+// Function to run a function on all bands of a given height
+static void run_split(ThreadPool* pool, int rows, int band_rows, ThreadPoolBandFn fn, void* ctx) {
+    if(rows <= 0) return;
+    int bands = (rows + band_rows - 1) / band_rows;
+
+    // Serial fallback, with the same band boundaries
+    if(pool == NULL || pool->threads == 1 || bands == 1 || inside_band ||
+       pthread_mutex_trylock(&pool->submit) != 0){
+        for(int begin = 0; begin < rows; begin += band_rows){
+            int end = begin + band_rows < rows ? begin + band_rows : rows;
+            fn(ctx, begin, end);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->rows = rows;
+    pool->band_rows = band_rows;
+    pool->bands = bands;
+    pool->next_band = 0;
+    pool->active = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_job(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->active > 0){
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->submit);
+}
+
+// Function to run a function on all bands of rows
+void threadpool_run_bands(ThreadPool* pool, int rows, ThreadPoolBandFn fn, void* ctx) {
+    if(rows <= 0) return;
+    run_split(pool, rows, band_rows_for(rows), fn, ctx);
+}
+
+// Function to run a function on every item of a list, one item at a time
+void threadpool_run_items(ThreadPool* pool, int count, ThreadPoolBandFn fn, void* ctx) {
+    run_split(pool, count, 1, fn, ctx);
+}
+
+// Function to set the pool used by the image filters
+void threadpool_set_default(ThreadPool* pool) {
+    default_pool = pool;
+}
+
+// Function to get the pool used by the image filters
+ThreadPool* threadpool_get_default(void) {
+    return default_pool;
+}
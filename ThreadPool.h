@@ -0,0 +1,79 @@
+/**
+* A program that applies three different Filters to an image
+*
+* Completion time: 8 hr
+*
+* @author Vivien Stahl, Ruben Acuna
+* @version 10/30/2024
+*/
+
+// ThreadPool.h
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Thread pool ADT
+typedef struct ThreadPool ThreadPool;
+
+// Function run on a band of rows [begin, end)
+typedef void (*ThreadPoolBandFn)(void* ctx, int begin, int end);
+
+/* Returns the number of CPUs this process may run on.
+*/
+int threadpool_detect_threads(void);
+
+/* Creates a pool of worker threads. The thread calling threadpool_run_bands
+ * takes part in the work, so threads - 1 workers are started.
+ *
+ * @param  threads: number of threads, or 0 to use threadpool_detect_threads.
+ * @return A pointer to a new pool, NULL on failure.
+*/
+ThreadPool* threadpool_create(int threads);
+
+/* Stops the workers and destroys a pool.
+ *
+ * @param  pool: the pool to destroy.
+*/
+void threadpool_destroy(ThreadPool** pool);
+
+/* Returns the number of threads of a pool, 1 for a NULL pool.
+ *
+ * @param  pool: the pool.
+*/
+int threadpool_get_threads(ThreadPool* pool);
+
+/* Splits rows [0, rows) into bands and runs fn on every band, in parallel
+ * on the pool, and returns when all bands are done. Band boundaries depend
+ * only on the number of rows, never on the number of threads. Runs all bands
+ * on the calling thread if pool is NULL, if it is called from inside a band,
+ * or if the pool is busy with another caller.
+ *
+ * @param  pool: the pool, may be NULL.
+ * @param  rows: number of rows.
+ * @param  fn: the function to run on each band.
+ * @param  ctx: passed to fn.
+*/
+void threadpool_run_bands(ThreadPool* pool, int rows, ThreadPoolBandFn fn, void* ctx);
+
+/* Runs fn on every item [i, i + 1) of [0, count) on the pool, handing out
+ * one item at a time, for independent jobs of uneven cost such as whole
+ * files. Image filters called from fn run serially on their thread.
+ *
+ * @param  pool: the pool, may be NULL.
+ * @param  count: number of items.
+ * @param  fn: the function to run on each item.
+ * @param  ctx: passed to fn.
+*/
+void threadpool_run_items(ThreadPool* pool, int count, ThreadPoolBandFn fn, void* ctx);
+
+/* Sets the pool used by the image filters. Pass NULL to run them serially.
+ *
+ * @param  pool: the pool.
+*/
+void threadpool_set_default(ThreadPool* pool);
+
+/* Returns the pool used by the image filters, NULL if none was set.
+*/
+ThreadPool* threadpool_get_default(void);
+
+#endif // THREADPOOL_H